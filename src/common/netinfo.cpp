@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "common.h"
+#include "netinfo.h"
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+#define NLBUFSIZE (32 * 1024)
+
+static NetInfo cache;
+static long long cache_stamp = 0;
+static int cache_valid = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static long long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static NetIf *add_if(NetInfo *ni) {
+	if ((ni->ifcnt & 15) == 0) {
+		NetIf *ptr = (NetIf *) realloc(ni->ifs, (ni->ifcnt + 16) * sizeof(NetIf));
+		if (!ptr)
+			errExit("realloc");
+		ni->ifs = ptr;
+	}
+	NetIf *nif = &ni->ifs[ni->ifcnt++];
+	memset(nif, 0, sizeof(NetIf));
+	return nif;
+}
+
+static NetRoute *add_route(NetInfo *ni) {
+	if ((ni->routecnt & 7) == 0) {
+		NetRoute *ptr = (NetRoute *) realloc(ni->routes, (ni->routecnt + 8) * sizeof(NetRoute));
+		if (!ptr)
+			errExit("realloc");
+		ni->routes = ptr;
+	}
+	NetRoute *r = &ni->routes[ni->routecnt++];
+	memset(r, 0, sizeof(NetRoute));
+	return r;
+}
+
+static NetIf *find_if(NetInfo *ni, int index) {
+	for (int i = 0; i < ni->ifcnt; i++) {
+		if (ni->ifs[i].index == index)
+			return &ni->ifs[i];
+	}
+	return NULL;
+}
+
+static int is_dir(const char *path) {
+	struct stat s;
+	return stat(path, &s) == 0 && S_ISDIR(s.st_mode);
+}
+
+//*************************************************************
+// netlink messages
+//*************************************************************
+static void parse_link(NetInfo *ni, struct nlmsghdr *h) {
+	struct ifinfomsg *ifi = (struct ifinfomsg *) NLMSG_DATA(h);
+	NetIf *nif = add_if(ni);
+	nif->index = ifi->ifi_index;
+	nif->flags = ifi->ifi_flags;
+
+	int len = IFLA_PAYLOAD(h);
+	for (struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFLA_IFNAME)
+			snprintf(nif->name, sizeof(nif->name), "%s", (char *) RTA_DATA(rta));
+		else if (rta->rta_type == IFLA_WIRELESS)
+			nif->wireless = 1;
+		else if (rta->rta_type == IFLA_LINKINFO) {
+			int len2 = RTA_PAYLOAD(rta);
+			for (struct rtattr *info = (struct rtattr *) RTA_DATA(rta); RTA_OK(info, len2);
+			     info = RTA_NEXT(info, len2)) {
+				if (info->rta_type == IFLA_INFO_KIND &&
+				    strcmp((char *) RTA_DATA(info), "bridge") == 0)
+					nif->bridge = 1;
+			}
+		}
+	}
+
+	// the dump carries IFLA_WIRELESS only for wireless extension events, sysfs is reliable
+	if (!nif->wireless && *nif->name) {
+		char *path;
+		if (asprintf(&path, "/sys/class/net/%s/wireless", nif->name) == -1)
+			errExit("asprintf");
+		nif->wireless = is_dir(path);
+		free(path);
+		if (!nif->wireless) {
+			if (asprintf(&path, "/sys/class/net/%s/phy80211", nif->name) == -1)
+				errExit("asprintf");
+			nif->wireless = is_dir(path);
+			free(path);
+		}
+	}
+}
+
+static void parse_addr(NetInfo *ni, struct nlmsghdr *h) {
+	struct ifaddrmsg *ifa = (struct ifaddrmsg *) NLMSG_DATA(h);
+	NetIf *nif = find_if(ni, ifa->ifa_index);
+	if (!nif)
+		return;
+
+	void *local = NULL;
+	void *address = NULL;
+	int len = IFA_PAYLOAD(h);
+	for (struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == IFA_LOCAL)
+			local = RTA_DATA(rta);
+		else if (rta->rta_type == IFA_ADDRESS)
+			address = RTA_DATA(rta);
+	}
+	// on point-to-point links IFA_ADDRESS is the peer
+	void *addr = (local)? local: address;
+	if (!addr)
+		return;
+
+	if (ifa->ifa_family == AF_INET) {
+		uint32_t ip;
+		memcpy(&ip, addr, sizeof(ip));
+		ip = ntohl(ip);
+		uint32_t mask = (ifa->ifa_prefixlen)? 0xffffffffu << (32 - ifa->ifa_prefixlen): 0;
+		if (nif->ip == 0) {
+			nif->ip = ip;
+			nif->mask = mask;
+		}
+		// secondary addresses, a gateway can be on any of them
+		if (nif->addr4cnt < NETIF_ADDR4) {
+			nif->addr4[nif->addr4cnt].ip = ip;
+			nif->addr4[nif->addr4cnt].mask = mask;
+			nif->addr4cnt++;
+		}
+	}
+	else if (ifa->ifa_family == AF_INET6 && !nif->has_ip6 && ifa->ifa_scope == RT_SCOPE_UNIVERSE) {
+		memcpy(&nif->ip6, addr, sizeof(nif->ip6));
+		nif->prefix6 = ifa->ifa_prefixlen;
+		nif->has_ip6 = 1;
+	}
+}
+
+static void route_gateway(NetRoute *r, int family, struct rtattr *rta) {
+	if (family == AF_INET && RTA_PAYLOAD(rta) >= sizeof(uint32_t)) {
+		uint32_t gw;
+		memcpy(&gw, RTA_DATA(rta), sizeof(gw));
+		r->gw = ntohl(gw);
+	}
+	else if (family == AF_INET6 && RTA_PAYLOAD(rta) >= sizeof(r->gw6))
+		memcpy(&r->gw6, RTA_DATA(rta), sizeof(r->gw6));
+}
+
+// default routes only; a multipath route is stored as one route for each next hop
+static void parse_route(NetInfo *ni, struct nlmsghdr *h) {
+	struct rtmsg *rtm = (struct rtmsg *) NLMSG_DATA(h);
+	if (rtm->rtm_dst_len != 0 || rtm->rtm_type != RTN_UNICAST || rtm->rtm_table != RT_TABLE_MAIN)
+		return;
+	if (rtm->rtm_family != AF_INET && rtm->rtm_family != AF_INET6)
+		return;
+
+	NetRoute route;
+	memset(&route, 0, sizeof(route));
+	route.family = rtm->rtm_family;
+	struct rtattr *multipath = NULL;
+	int len = RTM_PAYLOAD(h);
+	for (struct rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		if (rta->rta_type == RTA_OIF)
+			memcpy(&route.ifindex, RTA_DATA(rta), sizeof(int));
+		else if (rta->rta_type == RTA_GATEWAY)
+			route_gateway(&route, rtm->rtm_family, rta);
+		else if (rta->rta_type == RTA_PRIORITY)
+			memcpy(&route.metric, RTA_DATA(rta), sizeof(uint32_t));
+		else if (rta->rta_type == RTA_MULTIPATH)
+			multipath = rta;
+	}
+
+	if (!multipath) {
+		*add_route(ni) = route;
+		return;
+	}
+
+	struct rtnexthop *nh = (struct rtnexthop *) RTA_DATA(multipath);
+	int remaining = RTA_PAYLOAD(multipath);
+	while (remaining >= (int) sizeof(*nh) && nh->rtnh_len >= sizeof(*nh) && nh->rtnh_len <= remaining) {
+		NetRoute *r = add_route(ni);
+		*r = route;
+		r->ifindex = nh->rtnh_ifindex;
+		int len2 = nh->rtnh_len - sizeof(*nh);
+		for (struct rtattr *rta = RTNH_DATA(nh); RTA_OK(rta, len2); rta = RTA_NEXT(rta, len2)) {
+			if (rta->rta_type == RTA_GATEWAY)
+				route_gateway(r, rtm->rtm_family, rta);
+		}
+		remaining -= RTNH_ALIGN(nh->rtnh_len);
+		nh = RTNH_NEXT(nh);
+	}
+}
+
+// send a dump request and parse the replies; returns -1 if failed
+static int dump(int sock, int type, unsigned seq, NetInfo *ni) {
+	struct {
+		struct nlmsghdr h;
+		struct rtgenmsg g;
+	} req;
+	memset(&req, 0, sizeof(req));
+	req.h.nlmsg_len = NLMSG_LENGTH(sizeof(req.g));
+	req.h.nlmsg_type = type;
+	req.h.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.h.nlmsg_seq = seq;
+	req.g.rtgen_family = AF_UNSPEC;
+	if (send(sock, &req, req.h.nlmsg_len, 0) == -1)
+		return -1;
+
+	char *buf = (char *) malloc(NLBUFSIZE);
+	if (!buf)
+		errExit("malloc");
+	int rv = -1;
+	while (1) {
+		ssize_t len = recv(sock, buf, NLBUFSIZE, 0);
+		if (len == -1 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+
+		for (struct nlmsghdr *h = (struct nlmsghdr *) buf; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len)) {
+			if (h->nlmsg_seq != seq)
+				continue;
+			if (h->nlmsg_type == NLMSG_DONE) {
+				rv = 0;
+				goto done;
+			}
+			if (h->nlmsg_type == NLMSG_ERROR)
+				goto done;
+			if (h->nlmsg_type == RTM_NEWLINK)
+				parse_link(ni, h);
+			else if (h->nlmsg_type == RTM_NEWADDR)
+				parse_addr(ni, h);
+			else if (h->nlmsg_type == RTM_NEWROUTE)
+				parse_route(ni, h);
+		}
+	}
+
+done:
+	free(buf);
+	return rv;
+}
+
+static int route_cmp(const void *a, const void *b) {
+	const NetRoute *r1 = (const NetRoute *) a;
+	const NetRoute *r2 = (const NetRoute *) b;
+	if (r1->family != r2->family)
+		return (r1->family == AF_INET)? -1: 1;
+	if (r1->metric != r2->metric)
+		return (r1->metric < r2->metric)? -1: 1;
+	return 0;
+}
+
+static int read_netinfo(NetInfo *ni) {
+	memset(ni, 0, sizeof(NetInfo));
+	int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (sock == -1)
+		return -1;
+
+	// links first, the addresses and routes refer to them
+	int rv = -1;
+	if (dump(sock, RTM_GETLINK, 1, ni) == 0 &&
+	    dump(sock, RTM_GETADDR, 2, ni) == 0 &&
+	    dump(sock, RTM_GETROUTE, 3, ni) == 0)
+		rv = 0;
+	close(sock);
+
+	if (rv == 0 && ni->routecnt > 1)
+		qsort(ni->routes, ni->routecnt, sizeof(NetRoute), route_cmp);
+	if (rv == -1)
+		netinfo_free(ni);
+	return rv;
+}
+
+static void copy_netinfo(NetInfo *dest, const NetInfo *src) {
+	memset(dest, 0, sizeof(NetInfo));
+	if (src->ifcnt) {
+		dest->ifs = (NetIf *) malloc(src->ifcnt * sizeof(NetIf));
+		if (!dest->ifs)
+			errExit("malloc");
+		memcpy(dest->ifs, src->ifs, src->ifcnt * sizeof(NetIf));
+		dest->ifcnt = src->ifcnt;
+	}
+	if (src->routecnt) {
+		dest->routes = (NetRoute *) malloc(src->routecnt * sizeof(NetRoute));
+		if (!dest->routes)
+			errExit("malloc");
+		memcpy(dest->routes, src->routes, src->routecnt * sizeof(NetRoute));
+		dest->routecnt = src->routecnt;
+	}
+}
+
+int netinfo_get(NetInfo *ni, int max_age_ms) {
+	pthread_mutex_lock(&cache_lock);
+	long long now = now_ms();
+	if (!cache_valid || now - cache_stamp > max_age_ms) {
+		NetInfo fresh;
+		if (read_netinfo(&fresh) == -1) {
+			pthread_mutex_unlock(&cache_lock);
+			memset(ni, 0, sizeof(NetInfo));
+			return -1;
+		}
+		netinfo_free(&cache);
+		cache = fresh;
+		cache_stamp = now;
+		cache_valid = 1;
+	}
+	copy_netinfo(ni, &cache);
+	pthread_mutex_unlock(&cache_lock);
+	return 0;
+}
+
+void netinfo_free(NetInfo *ni) {
+	free(ni->ifs);
+	free(ni->routes);
+	memset(ni, 0, sizeof(NetInfo));
+}
+
+const NetIf *netinfo_find(const NetInfo *ni, const char *name) {
+	for (int i = 0; i < ni->ifcnt; i++) {
+		if (strcmp(ni->ifs[i].name, name) == 0)
+			return &ni->ifs[i];
+	}
+	return NULL;
+}
+
+const NetIf *netinfo_find_index(const NetInfo *ni, int index) {
+	for (int i = 0; i < ni->ifcnt; i++) {
+		if (ni->ifs[i].index == index)
+			return &ni->ifs[i];
+	}
+	return NULL;
+}
+
+const NetAddr4 *netinfo_find_net(const NetIf *nif, uint32_t ip) {
+	for (int i = 0; i < nif->addr4cnt; i++) {
+		if (in_netrange(ip, nif->addr4[i].ip, nif->addr4[i].mask) == NULL)
+			return &nif->addr4[i];
+	}
+	return NULL;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef NETINFO_H
+#define NETINFO_H
+#include <stdint.h>
+#include <net/if.h>
+#include <netinet/in.h>
+
+// Host network configuration read with RTNETLINK. Links, addresses and default routes are
+// dumped over a single netlink socket; wireless devices are detected in sysfs, bridges from
+// the link kind. The last snapshot is cached in memory and shared by all the callers in the
+// program; a new dump is made only if the snapshot is older than the age requested.
+
+#define NETIF_ADDR4 8	// IPv4 addresses kept for one interface
+
+typedef struct {
+	uint32_t ip;		// host format
+	uint32_t mask;
+} NetAddr4;
+
+typedef struct {
+	char name[IF_NAMESIZE];
+	int index;
+	unsigned flags;		// IFF_UP, IFF_RUNNING, IFF_LOOPBACK etc.
+	int wireless;
+	int bridge;
+	uint32_t ip;		// first IPv4 address, host format, 0 if none
+	uint32_t mask;
+	NetAddr4 addr4[NETIF_ADDR4];	// all the IPv4 addresses, the first one is ip/mask
+	int addr4cnt;
+	int has_ip6;		// global IPv6 address
+	struct in6_addr ip6;
+	int prefix6;
+} NetIf;
+
+typedef struct {
+	int family;		// AF_INET or AF_INET6
+	int ifindex;
+	uint32_t gw;		// IPv4 gateway, host format
+	struct in6_addr gw6;	// IPv6 gateway
+	uint32_t metric;
+} NetRoute;
+
+typedef struct {
+	NetIf *ifs;
+	int ifcnt;
+	NetRoute *routes;	// default routes, IPv4 first, sorted by metric
+	int routecnt;
+} NetInfo;
+
+// fill ni with a copy of the cached snapshot, refreshed if older than max_age_ms;
+// returns 0 if ok, -1 if netlink is not available; release the memory with netinfo_free
+int netinfo_get(NetInfo *ni, int max_age_ms);
+void netinfo_free(NetInfo *ni);
+
+// interface lookup, NULL if not found
+const NetIf *netinfo_find(const NetInfo *ni, const char *name);
+const NetIf *netinfo_find_index(const NetInfo *ni, int index);
+
+// the IPv4 address of the interface whose network contains ip, NULL if none
+const NetAddr4 *netinfo_find_net(const NetIf *nif, uint32_t ip);
+
+#endif
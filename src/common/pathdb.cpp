@@ -0,0 +1,512 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "common.h"
+#include "pathdb.h"
+#include "utils.h"
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+#define MAXDIRS 64
+#define DEFAULT_PATH "/usr/local/bin:/usr/bin:/bin"
+#define REFRESH_INTERVAL 2000	// ms, minimum time between two directory checks
+#define CACHE_MAGIC "FTPATHDB1\n"
+#define CACHE_MAGIC_LEN 10
+
+// directories not always present in $PATH
+static const char *extra_dirs[] = {
+	"/usr/local/bin",
+	"/usr/bin",
+	"/bin",
+	"/usr/local/games",
+	"/usr/games",
+	"/usr/local/sbin",
+	"/usr/sbin",
+	"/sbin",
+	NULL
+};
+
+typedef struct {
+	char *path;
+	int extra;		// directory not in $PATH
+	dev_t dev;
+	ino_t ino;
+	struct timespec mtime;
+} PathDir;
+
+// hash table entry
+typedef struct {
+	uint32_t offset;	// name offset in the string pool, 0 for an empty slot
+	uint8_t dir;		// index in dirs array
+} Entry;
+
+static PathDir dirs[MAXDIRS];
+static int dircnt = 0;
+static char *path_env = NULL;	// $PATH the directory list was built from
+
+// file names, '\0' separated; offset 0 is reserved for empty hash table slots
+static char *pool = NULL;
+static size_t poollen = 0;
+static size_t poolsize = 0;
+
+static Entry *table = NULL;
+static uint32_t tablesize = 0;	// power of 2
+static uint32_t entries = 0;
+
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+// the table is rebuilt when a directory changes; lookups take the lock for reading
+static pthread_rwlock_t table_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t refresh_mutex = PTHREAD_MUTEX_INITIALIZER;
+static long long last_check = 0;
+
+struct linux_dirent64 {
+	ino64_t d_ino;
+	off64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+// FNV-1a
+static inline uint32_t hash(const char *str) {
+	uint32_t h = 2166136261u;
+	while (*str) {
+		h ^= (unsigned char) *str++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static uint32_t pool_add(const char *name) {
+	size_t len = strlen(name) + 1;
+	if (poollen + len > poolsize) {
+		size_t newsize = (poolsize)? poolsize * 2: 64 * 1024;
+		while (poollen + len > newsize)
+			newsize *= 2;
+		char *ptr = (char *) realloc(pool, newsize);
+		if (!ptr)
+			errExit("realloc");
+		pool = ptr;
+		poolsize = newsize;
+	}
+	if (poollen == 0)
+		pool[poollen++] = '\0';	// reserved offset 0
+	uint32_t offset = poollen;
+	memcpy(pool + poollen, name, len);
+	poollen += len;
+	return offset;
+}
+
+static Entry *table_find(const char *name) {
+	if (!table)
+		return NULL;
+	uint32_t mask = tablesize - 1;
+	uint32_t i = hash(name) & mask;
+	while (table[i].offset) {
+		if (strcmp(pool + table[i].offset, name) == 0)
+			return &table[i];
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+static void table_insert_entry(uint32_t offset, uint8_t dir) {
+	uint32_t mask = tablesize - 1;
+	uint32_t i = hash(pool + offset) & mask;
+	while (table[i].offset)
+		i = (i + 1) & mask;
+	table[i].offset = offset;
+	table[i].dir = dir;
+}
+
+static void table_grow() {
+	uint32_t oldsize = tablesize;
+	Entry *old = table;
+	tablesize = (oldsize)? oldsize * 2: 4096;
+	table = (Entry *) calloc(tablesize, sizeof(Entry));
+	if (!table)
+		errExit("calloc");
+	for (uint32_t i = 0; i < oldsize; i++) {
+		if (old[i].offset)
+			table_insert_entry(old[i].offset, old[i].dir);
+	}
+	free(old);
+}
+
+// the first directory wins, same as in the shell
+static void table_add(const char *name, uint8_t dir) {
+	if (table_find(name))
+		return;
+	if ((entries + 1) * 2 > tablesize)	// keep the load factor under 50%
+		table_grow();
+	table_insert_entry(pool_add(name), dir);
+	entries++;
+}
+
+static void add_dir(const char *path, int extra) {
+	if (dircnt >= MAXDIRS || *path != '/')
+		return;
+	struct stat s;
+	if (stat(path, &s) == -1 || !S_ISDIR(s.st_mode))
+		return;
+
+	// skip duplicates, for example /bin symlinked to /usr/bin
+	for (int i = 0; i < dircnt; i++) {
+		if (dirs[i].dev == s.st_dev && dirs[i].ino == s.st_ino)
+			return;
+	}
+
+	PathDir *d = &dirs[dircnt++];
+	d->path = strdup(path);
+	if (!d->path)
+		errExit("strdup");
+	d->extra = extra;
+	d->dev = s.st_dev;
+	d->ino = s.st_ino;
+	d->mtime = s.st_mtim;
+}
+
+// build the directory list from $PATH
+static void build_dirs() {
+	const char *env = getenv("PATH");
+	free(path_env);
+	path_env = strdup((env && *env)? env: DEFAULT_PATH);
+	char *path = strdup(path_env);
+	if (!path_env || !path)
+		errExit("strdup");
+	char *saveptr;
+	char *ptr = strtok_r(path, ":", &saveptr);
+	while (ptr) {
+		add_dir(ptr, 0);
+		ptr = strtok_r(NULL, ":", &saveptr);
+	}
+	free(path);
+
+	for (int i = 0; extra_dirs[i]; i++)
+		add_dir(extra_dirs[i], 1);
+}
+
+static void scan_dir(int index) {
+	int fd = open(dirs[index].path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		return;
+
+	char buf[32 * 1024];
+	long len;
+	while ((len = syscall(SYS_getdents64, fd, buf, sizeof(buf))) > 0) {
+		long pos = 0;
+		while (pos < len) {
+			struct linux_dirent64 *entry = (struct linux_dirent64 *) (buf + pos);
+			pos += entry->d_reclen;
+			if (entry->d_type == DT_DIR)
+				continue;
+			if (*entry->d_name == '.' && (entry->d_name[1] == '\0' ||
+			    (entry->d_name[1] == '.' && entry->d_name[2] == '\0')))
+				continue;
+			table_add(entry->d_name, (uint8_t) index);
+		}
+	}
+	close(fd);
+}
+
+static char *cache_file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/pathdb.cache", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+	char *ptr = (char *) buf;
+	while (len) {
+		ssize_t rv = read(fd, ptr, len);
+		if (rv <= 0)
+			return -1;
+		ptr += rv;
+		len -= rv;
+	}
+	return 0;
+}
+
+// cache file format:
+//	magic
+//	uint32_t dircnt
+//	for each directory: uint32_t len, path, uint8_t extra, int64_t mtime sec, int64_t mtime nsec
+//	uint32_t pool length, pool
+// returns 0 if the cache was loaded
+static int load_cache() {
+	char *fname = cache_file_name();
+	if (!fname)
+		return -1;
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	free(fname);
+	if (fd == -1)
+		return -1;
+
+	char magic[CACHE_MAGIC_LEN];
+	uint32_t cnt;
+	if (read_all(fd, magic, CACHE_MAGIC_LEN) || memcmp(magic, CACHE_MAGIC, CACHE_MAGIC_LEN) ||
+	    read_all(fd, &cnt, sizeof(cnt)) || cnt != (uint32_t) dircnt)
+		goto errexit;
+
+	// compare the directories
+	for (int i = 0; i < dircnt; i++) {
+		uint32_t len;
+		char path[PATH_MAX];
+		uint8_t extra;
+		int64_t sec;
+		int64_t nsec;
+		if (read_all(fd, &len, sizeof(len)) || len >= PATH_MAX ||
+		    read_all(fd, path, len))
+			goto errexit;
+		path[len] = '\0';
+		if (read_all(fd, &extra, sizeof(extra)) ||
+		    read_all(fd, &sec, sizeof(sec)) ||
+		    read_all(fd, &nsec, sizeof(nsec)))
+			goto errexit;
+		if (strcmp(path, dirs[i].path) || extra != dirs[i].extra ||
+		    sec != dirs[i].mtime.tv_sec || nsec != dirs[i].mtime.tv_nsec)
+			goto errexit;
+	}
+
+	// load the names
+	{
+		uint32_t len;
+		if (read_all(fd, &len, sizeof(len)) || len == 0)
+			goto errexit;
+		char *data = (char *) malloc(len);
+		if (!data)
+			errExit("malloc");
+		if (read_all(fd, data, len) || data[len - 1] != '\0') {
+			free(data);
+			goto errexit;
+		}
+
+		// each name is preceded by the directory index
+		char *ptr = data;
+		char *end = data + len;
+		while (ptr < end) {
+			uint8_t dir = (uint8_t) *ptr++;
+			if (ptr >= end || dir >= dircnt)
+				break;
+			table_add(ptr, dir);
+			ptr += strlen(ptr) + 1;
+		}
+		free(data);
+	}
+
+	close(fd);
+	return 0;
+
+errexit:
+	close(fd);
+	return -1;
+}
+
+static void save_cache() {
+	char *fname = cache_file_name();
+	if (!fname)
+		return;
+	char *tmpname;
+	FILE *fp = cache_open(fname, &tmpname);
+	if (!fp) {
+		free(fname);
+		return;
+	}
+
+	fwrite(CACHE_MAGIC, CACHE_MAGIC_LEN, 1, fp);
+	uint32_t cnt = dircnt;
+	fwrite(&cnt, sizeof(cnt), 1, fp);
+	for (int i = 0; i < dircnt; i++) {
+		uint32_t len = strlen(dirs[i].path);
+		uint8_t extra = dirs[i].extra;
+		int64_t sec = dirs[i].mtime.tv_sec;
+		int64_t nsec = dirs[i].mtime.tv_nsec;
+		fwrite(&len, sizeof(len), 1, fp);
+		fwrite(dirs[i].path, len, 1, fp);
+		fwrite(&extra, sizeof(extra), 1, fp);
+		fwrite(&sec, sizeof(sec), 1, fp);
+		fwrite(&nsec, sizeof(nsec), 1, fp);
+	}
+
+	uint32_t len = 0;
+	for (uint32_t i = 0; i < tablesize; i++) {
+		if (table[i].offset)
+			len += 1 + strlen(pool + table[i].offset) + 1;
+	}
+	fwrite(&len, sizeof(len), 1, fp);
+	for (uint32_t i = 0; i < tablesize; i++) {
+		if (table[i].offset) {
+			fputc(table[i].dir, fp);
+			const char *name = pool + table[i].offset;
+			fwrite(name, strlen(name) + 1, 1, fp);
+		}
+	}
+
+	cache_close(fp, tmpname, fname);
+	free(fname);
+}
+
+static long long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void scan_all() {
+	// the cache might have been partially loaded
+	free(table);
+	table = NULL;
+	tablesize = 0;
+	entries = 0;
+	poollen = 0;
+	table_grow();
+
+	for (int i = 0; i < dircnt; i++)
+		scan_dir(i);
+	save_cache();
+}
+
+static void init() {
+	last_check = now_ms();
+	build_dirs();
+	if (load_cache() == 0)
+		return;
+	scan_all();
+}
+
+// $PATH or one of the directories changed since the table was built
+static bool dirs_changed() {
+	const char *env = getenv("PATH");
+	if (strcmp((env && *env)? env: DEFAULT_PATH, path_env) != 0)
+		return true;
+
+	for (int i = 0; i < dircnt; i++) {
+		struct stat s;
+		if (stat(dirs[i].path, &s) == -1 ||
+		    s.st_mtim.tv_sec != dirs[i].mtime.tv_sec || s.st_mtim.tv_nsec != dirs[i].mtime.tv_nsec)
+			return true;
+	}
+	return false;
+}
+
+// rebuild the table if a directory changed; the directories are checked at most once
+// every REFRESH_INTERVAL, a program probing many missing names doesn't stat them every time
+// returns true if the table was rebuilt
+static bool refresh() {
+	pthread_mutex_lock(&refresh_mutex);
+	long long now = now_ms();
+	bool check = now - last_check >= REFRESH_INTERVAL;
+	if (check)
+		last_check = now;
+	pthread_mutex_unlock(&refresh_mutex);
+	if (!check)
+		return false;
+
+	pthread_rwlock_wrlock(&table_lock);
+	bool changed = dirs_changed();
+	if (changed) {
+		for (int i = 0; i < dircnt; i++)
+			free(dirs[i].path);
+		dircnt = 0;
+		build_dirs();
+		scan_all();
+	}
+	pthread_rwlock_unlock(&table_lock);
+	return changed;
+}
+
+void pathdb_init() {
+	pthread_once(&init_once, init);
+}
+
+// the table holds the first directory with the name; like the shell, a file that is not
+// executable doesn't hide an executable with the same name in the next directories
+static bool lookup(const char *prog, bool any) {
+	Entry *entry = table_find(prog);
+	if (!entry)
+		return false;
+
+	for (int i = entry->dir; i < dircnt; i++) {
+		if (!any && dirs[i].extra)
+			continue;
+		char path[PATH_MAX];
+		if (snprintf(path, sizeof(path), "%s/%s", dirs[i].path, prog) >= (int) sizeof(path))
+			continue;
+		if (access(path, X_OK) == 0)
+			return true;
+	}
+	return false;
+}
+
+static bool find(const char *prog, bool any) {
+	assert(prog);
+	if (*prog == '\0')
+		return false;
+	if (strchr(prog, '/'))
+		return access(prog, X_OK) == 0;
+
+	pathdb_init();
+	pthread_rwlock_rdlock(&table_lock);
+	bool rv = lookup(prog, any);
+	pthread_rwlock_unlock(&table_lock);
+
+	// the program could have been installed after the table was built
+	if (!rv && refresh()) {
+		pthread_rwlock_rdlock(&table_lock);
+		rv = lookup(prog, any);
+		pthread_rwlock_unlock(&table_lock);
+	}
+	return rv;
+}
+
+bool pathdb_find(const char *prog) {
+	return find(prog, false);
+}
+
+bool pathdb_find_any(const char *prog) {
+	return find(prog, true);
+}
+
+uint64_t pathdb_stamp() {
+	pathdb_init();
+	pthread_rwlock_rdlock(&table_lock);
+
+	// FNV-1a over the directory list and modification times
+	uint64_t h = 14695981039346656037ULL;
+	for (int i = 0; i < dircnt; i++) {
+		int64_t data[3] = { dirs[i].extra, dirs[i].mtime.tv_sec, dirs[i].mtime.tv_nsec };
+		const unsigned char *ptr = (const unsigned char *) dirs[i].path;
+		size_t len = strlen(dirs[i].path) + 1;
+		for (size_t j = 0; j < len; j++)
+			h = (h ^ ptr[j]) * 1099511628211ULL;
+		ptr = (const unsigned char *) data;
+		for (size_t j = 0; j < sizeof(data); j++)
+			h = (h ^ ptr[j]) * 1099511628211ULL;
+	}
+	pthread_rwlock_unlock(&table_lock);
+	return h;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef PATHDB_H
+#define PATHDB_H
+#include <stdint.h>
+
+// In-process executable lookup. The directories in $PATH, followed by a few well-known
+// system directories, are read once and the file names are stored in a hash table.
+// The table is saved in ~/.config/firetools/pathdb.cache together with the modification
+// time of each directory; as long as no directory changed, the next program start loads
+// the cache and skips the scan. When a name is not found, the directories are checked
+// again (at most every two seconds) and the table is rebuilt if one of them changed.
+
+// load the cache or scan the directories; called automatically by the functions below
+void pathdb_init();
+
+// returns true if the program is found in $PATH, similar to "which" shell command
+bool pathdb_find(const char *prog);
+
+// returns true if the program is found in $PATH or in one of the well-known
+// directories (/usr/games, /sbin, /usr/sbin etc.)
+bool pathdb_find_any(const char *prog);
+
+// returns a value changing every time one of the directories is modified; callers caching
+// lookup results can store it and compare it on the next start
+uint64_t pathdb_stamp();
+
+#endif
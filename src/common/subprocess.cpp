@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "common.h"
+#include "subprocess.h"
+#include "../../firetools_config.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+#define POLL_INTERVAL 100	// ms, cancel flag check interval
+
+// one output stream of the child
+typedef struct {
+	int fd;
+	int is_stderr;
+	int keep;		// collect the data in buf
+	char *buf;		// collected data
+	size_t len;
+	size_t size;
+	char *line;		// current line
+	size_t linelen;
+} Stream;
+
+static long long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void stream_append(Stream *s, const char *data, size_t len) {
+	if (s->len + len + 1 > s->size) {
+		size_t newsize = (s->size)? s->size: 4096;
+		while (s->len + len + 1 > newsize)
+			newsize *= 2;
+		char *ptr = (char *) realloc(s->buf, newsize);
+		if (!ptr)
+			errExit("realloc");
+		s->buf = ptr;
+		s->size = newsize;
+	}
+	memcpy(s->buf + s->len, data, len);
+	s->len += len;
+	s->buf[s->len] = '\0';
+}
+
+// feed the data to the line callback; returns non-zero if the callback cancelled the program
+static int stream_lines(Stream *s, const char *data, size_t len, SubprocessLineCb cb, void *arg) {
+	for (size_t i = 0; i < len; i++) {
+		if (data[i] == '\n' || s->linelen == SUBPROCESS_MAXLINE) {
+			s->line[s->linelen] = '\0';
+			s->linelen = 0;
+			if (cb(s->line, s->is_stderr, arg))
+				return 1;
+			if (data[i] == '\n')
+				continue;
+		}
+		s->line[s->linelen++] = data[i];
+	}
+	return 0;
+}
+
+// kill the child; firejail needs some time to clean up after SIGTERM
+static void kill_child(pid_t pid, int *status) {
+	kill(pid, SIGTERM);
+	for (int i = 0; i < 20; i++) {
+		if (waitpid(pid, status, WNOHANG) == pid)
+			return;
+		usleep(50000);
+	}
+	kill(pid, SIGKILL);
+	waitpid(pid, status, 0);
+}
+
+static pid_t spawn(char *const argv[], int outfd, int errfd, const char *dir) {
+	posix_spawn_file_actions_t fa;
+	if (posix_spawn_file_actions_init(&fa))
+		return -1;
+	posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+	if (dir && posix_spawn_file_actions_addchdir_np(&fa, dir)) {
+		posix_spawn_file_actions_destroy(&fa);
+		return -1;
+	}
+#else
+	// glibc older than 2.29: a shell changes the directory and runs the program,
+	// sh -c 'cd -- "$0" && exec "$@"' dir argv...
+	char **shargv = NULL;
+	if (dir) {
+		int argc = 0;
+		while (argv[argc])
+			argc++;
+		shargv = (char **) malloc((argc + 5) * sizeof(char *));
+		if (!shargv)
+			errExit("malloc");
+		shargv[0] = (char *) "/bin/sh";
+		shargv[1] = (char *) "-c";
+		shargv[2] = (char *) "cd -- \"$0\" && exec \"$@\"";
+		shargv[3] = (char *) dir;
+		for (int i = 0; i <= argc; i++)
+			shargv[i + 4] = argv[i];
+		argv = shargv;
+	}
+#endif
+	if (outfd != -1)
+		posix_spawn_file_actions_adddup2(&fa, outfd, 1);
+	if (errfd != -1)
+		posix_spawn_file_actions_adddup2(&fa, errfd, 2);
+
+	pid_t pid;
+	int rv = posix_spawnp(&pid, argv[0], &fa, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&fa);
+#ifndef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+	free(shargv);
+#endif
+	if (rv) {
+		errno = rv;
+		return -1;
+	}
+	return pid;
+}
+
+int subprocess_run(char *const argv[], int flags, int timeout_ms, volatile int *cancel,
+	SubprocessLineCb cb, void *arg, SubprocessResult *res) {
+	return subprocess_run_dir(NULL, argv, flags, timeout_ms, cancel, cb, arg, res);
+}
+
+int subprocess_run_dir(const char *dir, char *const argv[], int flags, int timeout_ms, volatile int *cancel,
+	SubprocessLineCb cb, void *arg, SubprocessResult *res) {
+	assert(argv && argv[0]);
+	assert(res);
+	memset(res, 0, sizeof(SubprocessResult));
+
+	int outpipe[2];
+	int errpipe[2] = {-1, -1};
+	if (pipe2(outpipe, O_CLOEXEC) == -1)
+		return -1;
+	if (!(flags & SUBPROCESS_MERGE_ERR) && pipe2(errpipe, O_CLOEXEC) == -1) {
+		close(outpipe[0]);
+		close(outpipe[1]);
+		return -1;
+	}
+
+	pid_t pid = spawn(argv, outpipe[1], (flags & SUBPROCESS_MERGE_ERR)? outpipe[1]: errpipe[1], dir);
+	close(outpipe[1]);
+	if (errpipe[1] != -1)
+		close(errpipe[1]);
+	if (pid == -1) {
+		close(outpipe[0]);
+		if (errpipe[0] != -1)
+			close(errpipe[0]);
+		return -1;
+	}
+
+	Stream streams[2];
+	memset(streams, 0, sizeof(streams));
+	streams[0].fd = outpipe[0];
+	streams[0].keep = flags & SUBPROCESS_KEEP_OUT;
+	streams[1].fd = errpipe[0];
+	streams[1].is_stderr = 1;
+	streams[1].keep = flags & SUBPROCESS_KEEP_ERR;
+	if (cb) {
+		for (int i = 0; i < 2; i++) {
+			streams[i].line = (char *) malloc(SUBPROCESS_MAXLINE + 1);
+			if (!streams[i].line)
+				errExit("malloc");
+		}
+	}
+
+	long long deadline = (timeout_ms > 0)? now_ms() + timeout_ms: 0;
+	int killed = 0;
+	char buf[4096];
+	while (streams[0].fd != -1 || streams[1].fd != -1) {
+		struct pollfd pfd[2];
+		int nfds = 0;
+		Stream *s[2];
+		for (int i = 0; i < 2; i++) {
+			if (streams[i].fd == -1)
+				continue;
+			pfd[nfds].fd = streams[i].fd;
+			pfd[nfds].events = POLLIN;
+			s[nfds++] = &streams[i];
+		}
+
+		int wait = POLL_INTERVAL;
+		if (deadline) {
+			long long left = deadline - now_ms();
+			if (left <= 0) {
+				res->timedout = 1;
+				killed = 1;
+				break;
+			}
+			if (left < wait)
+				wait = (int) left;
+		}
+		if (cancel && *cancel) {
+			res->cancelled = 1;
+			killed = 1;
+			break;
+		}
+
+		int rv = poll(pfd, nfds, wait);
+		if (rv == -1) {
+			if (errno == EINTR)
+				continue;
+			killed = 1;
+			break;
+		}
+
+		for (int i = 0; i < nfds && !killed; i++) {
+			if (!pfd[i].revents)
+				continue;
+			ssize_t len = read(pfd[i].fd, buf, sizeof(buf));
+			if (len == -1 && (errno == EINTR || errno == EAGAIN))
+				continue;
+			if (len <= 0) {
+				// end of file, flush the last line
+				if (cb && s[i]->linelen) {
+					s[i]->line[s[i]->linelen] = '\0';
+					s[i]->linelen = 0;
+					if (cb(s[i]->line, s[i]->is_stderr, arg)) {
+						res->cancelled = 1;
+						killed = 1;
+					}
+				}
+				close(s[i]->fd);
+				s[i]->fd = -1;
+				continue;
+			}
+			if (s[i]->keep)
+				stream_append(s[i], buf, len);
+			if (cb && stream_lines(s[i], buf, len, cb, arg)) {
+				res->cancelled = 1;
+				killed = 1;
+			}
+		}
+		if (killed)
+			break;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		if (streams[i].fd != -1)
+			close(streams[i].fd);
+		free(streams[i].line);
+	}
+
+	if (killed)
+		kill_child(pid, &res->status);
+	else {
+		while (waitpid(pid, &res->status, 0) == -1 && errno == EINTR)
+			;
+	}
+
+	// always return valid strings for the streams requested by the caller
+	if (streams[0].keep && !streams[0].buf)
+		stream_append(&streams[0], "", 0);
+	if (streams[1].keep && !streams[1].buf)
+		stream_append(&streams[1], "", 0);
+	res->out = streams[0].buf;
+	res->outlen = streams[0].len;
+	res->err = streams[1].buf;
+	res->errlen = streams[1].len;
+	return 0;
+}
+
+void subprocess_free(SubprocessResult *res) {
+	if (!res)
+		return;
+	free(res->out);
+	free(res->err);
+	res->out = NULL;
+	res->err = NULL;
+	res->outlen = 0;
+	res->errlen = 0;
+}
+
+pid_t subprocess_spawn(char *const argv[], int *errfd) {
+	assert(argv && argv[0]);
+	int errpipe[2] = {-1, -1};
+	if (errfd && pipe2(errpipe, O_CLOEXEC) == -1)
+		return -1;
+
+	pid_t pid = spawn(argv, -1, errpipe[1], NULL);
+	if (errpipe[1] != -1)
+		close(errpipe[1]);
+	if (pid == -1) {
+		if (errpipe[0] != -1)
+			close(errpipe[0]);
+		return -1;
+	}
+
+	if (errfd)
+		*errfd = errpipe[0];
+	return pid;
+}
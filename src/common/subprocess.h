@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SUBPROCESS_H
+#define SUBPROCESS_H
+#include <sys/types.h>
+
+// Run external programs without a shell. The program is started with posix_spawnp,
+// stdout and stderr are read through pipes, and the output is either handed line by line
+// to a callback or collected in buffers owned by the caller. No static memory is used,
+// the functions can be called from multiple threads at the same time.
+
+// flags for subprocess_run
+#define SUBPROCESS_KEEP_OUT	0x01	// collect stdout in res->out
+#define SUBPROCESS_KEEP_ERR	0x02	// collect stderr in res->err
+#define SUBPROCESS_MERGE_ERR	0x04	// send stderr to the stdout stream, same as 2>&1 in shell
+
+// lines longer than this are passed to the callback in several pieces
+#define SUBPROCESS_MAXLINE (64 * 1024)
+
+// line callback: line is '\0' terminated, without '\n'; the memory is valid only during the call
+// return 0 to continue, or non-zero to cancel the program
+typedef int (*SubprocessLineCb)(char *line, int is_stderr, void *arg);
+
+typedef struct {
+	char *out;		// stdout, allocated memory, '\0' terminated, NULL if not requested
+	size_t outlen;
+	char *err;		// stderr, allocated memory, '\0' terminated, NULL if not requested
+	size_t errlen;
+	int status;		// exit status as returned by waitpid
+	int timedout;		// the program was killed after timeout_ms
+	int cancelled;		// the program was killed by the callback or by *cancel
+} SubprocessResult;
+
+// run a program and wait for it to finish
+// timeout_ms: 0 for no timeout
+// cancel: optional flag checked periodically, set it from another thread to kill the program
+// cb: optional line callback
+// returns 0 if the program was started, -1 if not
+int subprocess_run(char *const argv[], int flags, int timeout_ms, volatile int *cancel,
+	SubprocessLineCb cb, void *arg, SubprocessResult *res);
+
+// same as subprocess_run, the program is started in directory dir
+int subprocess_run_dir(const char *dir, char *const argv[], int flags, int timeout_ms, volatile int *cancel,
+	SubprocessLineCb cb, void *arg, SubprocessResult *res);
+
+// release the memory allocated in SubprocessResult
+void subprocess_free(SubprocessResult *res);
+
+// start a program in background; if errfd is not NULL, the read end of a pipe connected
+// to the stderr of the program is returned in *errfd; returns the pid or -1 if failed
+pid_t subprocess_spawn(char *const argv[], int *errfd);
+
+#endif
@@ -26,6 +26,7 @@
 #include <pwd.h>
 #include "common.h"
 #include "utils.h"
+#include "pathdb.h"
 
 #define MAXBUF (1024 * 1024) // 1MB output buffer
 static char outbuf[MAXBUF + 1];
@@ -54,20 +55,10 @@ char *run_program(const char *prog) {
 	return outbuf;
 }
 
-// returns true or false if the program was found using "which" shell command
+// returns true or false if the program was found in $PATH; no shell is involved,
+// the lookup goes through the in-process executable database
 bool which(const char *prog) {
-	// build command
-	char *cmd;
-	if (asprintf(&cmd, "which %s", prog) == -1) {
-		perror("asprintf");
-		exit(1);
-	}
-	
-	// run command
-	char *res = run_program(cmd);
-	if (strstr(res, prog))
-		return true;
-	return false;
+	return pathdb_find(prog);
 }
 
 // check if a name.desktop file exists in config home directory
@@ -154,6 +145,53 @@ void create_config_directory() {
 	free(path);
 }
 
+char *human_size(double size, char *buf) {
+	const char *units[] = { "B", "KB", "MB", "GB", "TB" };
+	int i = 0;
+	while (size >= 1024 && i < 4) {
+		size /= 1024;
+		i++;
+	}
+	snprintf(buf, HUMAN_SIZE_MAX, "%.*f %s", (i == 0)? 0: 1, size, units[i]);
+	return buf;
+}
+
+// the cache is written to a temporary file and renamed over the old one,
+// a crash or a full disk never leaves a truncated cache
+FILE *cache_open(const char *fname, char **tmpname) {
+	if (asprintf(tmpname, "%s.XXXXXX", fname) == -1)
+		errExit("asprintf");
+	int fd = mkstemp(*tmpname);
+	if (fd == -1) {
+		free(*tmpname);
+		*tmpname = NULL;
+		return NULL;
+	}
+
+	FILE *fp = fdopen(fd, "w");
+	if (!fp) {
+		close(fd);
+		unlink(*tmpname);
+		free(*tmpname);
+		*tmpname = NULL;
+	}
+	return fp;
+}
+
+int cache_close(FILE *fp, char *tmpname, const char *fname, bool ok) {
+	if (ferror(fp))
+		ok = false;
+	if (fclose(fp) != 0)
+		ok = false;
+	int rv = -1;
+	if (ok && rename(tmpname, fname) == 0)
+		rv = 0;
+	else
+		unlink(tmpname);
+	free(tmpname);
+	return rv;
+}
+
 int sargc;
 char *sargv[SARG_MAX];
 
@@ -19,11 +19,12 @@
 */
 #ifndef UTILS_H
 #define UTILS_H
+#include <stdio.h>
 
 // run a user program using popen; returns static memory
 char *run_program(const char *prog);
 
-// returns true or false if the program was found using "which" shell command
+// returns true or false if the program was found in $PATH (see pathdb.h)
 bool which(const char *prog);
 
 // check if a name.desktop file exists in config home directory
@@ -41,6 +42,19 @@ char *get_config_directory();
 // create ~/.config/firetools directory if it doesn't exist
 void create_config_directory();
 
+// format a byte count as "1.5 MB" in buf; returns buf
+#define HUMAN_SIZE_MAX 32
+char *human_size(double size, char *buf);
+
+// open a temporary file in the directory of fname for writing a cache;
+// returns NULL on error, tmpname is allocated memory
+FILE *cache_open(const char *fname, char **tmpname);
+
+// close a cache opened with cache_open and move it over fname; the file is
+// dropped if ok is false or any write failed; tmpname is freed;
+// returns 0 if fname was replaced, -1 otherwise
+int cache_close(FILE *fp, char *tmpname, const char *fname, bool ok = true);
+
 // split a line into words
 #define SARG_MAX 128
 extern int sargc;
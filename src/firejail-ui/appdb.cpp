@@ -17,7 +17,7 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-
+#include <QtGlobal>
 #if QT_VERSION >= 0x050000
 	#include <QtWidgets>
 #else
@@ -25,103 +25,76 @@
 #endif
 
 #include "appdb.h"
+#include "../common/pathdb.h"
 #include "../../firetools_config_extras.h"
-#include <QListWidget>
-#include <QLineEdit>
 #define MAXBUF 4096
 
 static bool check_executable(const char *exec) {
-	struct stat s;
-	if (stat(exec, &s) == 0)
-		return true;
-	
-	// check well-known paths
-	const char *path[] = {
-		"/usr/bin/",
-		"/bin/",
-		"/usr/games/",
-		"/usr/local/bin/",
-		"/sbin/",
-		"/usr/sbin/",
-		NULL
-	};
-	
-	int i = 0;
-	while (path[i] != NULL) {
-		bool found = false;
-		
-		char *name;
-		if (asprintf(&name, "%s%s", path[i], exec) == -1)
-			errExit("asprintf");
-		if (stat(name, &s) == 0)
-			found = true;
-		free(name);
-		if (found)
-			return true;
-		i++;
+	// full path
+	if (strchr(exec, '/')) {
+		struct stat s;
+		return stat(exec, &s) == 0;
 	}
-	return false;
+
+	// check $PATH and the well-known system paths
+	return pathdb_find_any(exec);
 }
 
+void AppProbe::run() {
+	// pathdb is initialized once, the lookups can run in any thread
+	for (int i = 0; i < execs_.size() && !stop_; i++) {
+		bool found = check_executable(execs_.at(i).constData());
+		if (arg_debug && !found)
+			printf("executable %s not found\n", execs_.at(i).constData());
+		emit probed(i, found);
+	}
+}
 
-AppEntry::AppEntry(char *line) {
-	assert(line);
-	if (arg_debug)
-		printf("processing \"%s\"\n", line);
-	group_ = QString("");
-	app_ = QString("");
-	command_ = QString("");
-	next_ = 0;
-
-	char *ptr = strtok(line, ";");
-	if (ptr) {
-		group_ = QString(ptr);
-		ptr = strtok(NULL, ";");
-		if (ptr) {
-			app_ = QString(ptr);
-			ptr = strtok(NULL, ";");
-			if (ptr) {
-				command_ = QString(ptr);
-				if (command_.endsWith("*")) {
-					command_ = "";
-					return;
-				}
-				
-				// try to find the executable
-				char *str = strdup(command_.toUtf8().data());
-				if (!str)
-					errExit("strdup");
-				
-				// skip excutables ending in *
-				
-				char *ptr = strchr(str, ' ');
-				if (ptr)
-					*ptr = '\0';
-
-				if (check_executable(str) == false) {				
-					if (arg_debug)
-						printf("executable %s not found\n", str);
-					command_ = QString("");
-				}
-				free(str);
-			}
-		}
+AppCatalog::AppCatalog(QObject *parent): QObject(parent), probe_(NULL) {}
+
+AppCatalog::~AppCatalog() {
+	if (probe_) {
+		probe_->stop();
+		probe_->wait();
 	}
 }
 
+// one line: group;application;command
+static bool parse_line(char *line, AppEntry *entry) {
+	if (arg_debug)
+		printf("processing \"%s\"\n", line);
 
+	char *group = strtok(line, ";");
+	char *app = (group)? strtok(NULL, ";"): NULL;
+	char *command = (app)? strtok(NULL, ";"): NULL;
+	if (!command)
+		return false;
+
+	entry->group_ = QString(group);
+	entry->app_ = QString(app);
+	entry->command_ = QString(command);
+	// skip excutables ending in *
+	if (entry->group_.isEmpty() || entry->app_.isEmpty() || entry->command_.isEmpty() ||
+	    entry->command_.endsWith("*"))
+		return false;
+
+	// the executable is checked later
+	char *ptr = strchr(command, ' ');
+	if (ptr)
+		*ptr = '\0';
+	entry->exec_ = QByteArray(command);
+	entry->available_ = false;
+	return true;
+}
 
-// return the list of applications
-AppEntry* appdb_load_file(void) {
+bool AppCatalog::load() {
 	const char *fname = PACKAGE_LIBDIR "/uimenus";
 	FILE *fp = fopen(fname, "r");
 	if (!fp) {
 		fprintf(stderr, "Error: cannot find uimenus file in %s\n", fname);
-		return 0;
+		return false;
 	}
-	AppEntry *retval = 0;
-	AppEntry *last = 0;
-	
+
 	char buf[MAXBUF];
 	while (fgets(buf, MAXBUF, fp)) {
 		char *ptr1 = buf;
@@ -131,71 +104,90 @@ AppEntry* appdb_load_file(void) {
 		if (ptr2)
 			*ptr2 = '\0';
 
-		AppEntry *entry = new AppEntry(ptr1);
-		if (entry->group_.isEmpty() || entry->app_.isEmpty() || entry->command_.isEmpty()) {
+		AppEntry entry;
+		if (!parse_line(ptr1, &entry)) {
 			if (arg_debug)
 				printf("line not accepted\n");
-			delete entry;
 			continue;
 		}
-		
-		// add the app to the list
-		if (!retval) {
-			retval = entry;
-			last = entry;
-		}
-		else {
-			last->next_ = entry;
-			last = entry;
+
+		// all the entries are kept, for a name listed twice (chromium, chromium-browser)
+		// the first one available wins, see probed()
+		QHash<QString, QVector<int> >::iterator it = by_group_.find(entry.group_);
+		if (it == by_group_.end()) {
+			groups_.append(entry.group_);
+			it = by_group_.insert(entry.group_, QVector<int>());
 		}
+		entry.group_index_ = (it.value().isEmpty())? groups_.size() - 1: entries_.at(it.value().first()).group_index_;
+		it.value().append(entries_.size());
+		if (!by_name_.contains(entry.app_))
+			by_name_.insert(entry.app_, entries_.size());
+		entries_.append(entry);
 	}
-	
+
 	fclose(fp);
 	if (arg_debug)
-		printf("menus loaded\n");	
-	return retval;
+		printf("menus loaded\n");
+	return true;
 }
 
-// print database
-void appdb_print_list(AppEntry *ptr) {
-	while (ptr) {
-		ptr->print();
-		ptr = ptr->next_;
-	}
+void AppCatalog::probe() {
+	if (probe_)
+		return;
+	QVector<QByteArray> execs(entries_.size());
+	for (int i = 0; i < entries_.size(); i++)
+		execs[i] = entries_.at(i).exec_;
+	probe_ = new AppProbe(execs, this);
+	connect(probe_, SIGNAL(probed(int, bool)), this, SLOT(probed(int, bool)));
+	connect(probe_, SIGNAL(finished()), this, SLOT(probeFinished()));
+	probe_->start(QThread::LowPriority);
 }
 
-// add all groups to the widget
-void appdb_load_group(AppEntry *ptr, QListWidget *group) {
-	QString last;
+bool AppCatalog::probing() const {
+	return probe_ && probe_->isRunning();
+}
 
-	while (ptr) {
-		if (last != ptr->group_) {
-			new QListWidgetItem(ptr->group_, group);
-		}
-		last = ptr->group_;
-		ptr = ptr->next_;
-	}
+// the executables are probed in file order
+void AppCatalog::probed(int index, bool found) {
+	if (!found || index >= entries_.size())
+		return;
+
+	// an earlier entry with the same name is already available, this one stays hidden
+	AppEntry &entry = entries_[index];
+	QHash<QString, int>::iterator it = by_name_.find(entry.app_);
+	if (it != by_name_.end() && it.value() != index && entries_.at(it.value()).available_)
+		return;
+	by_name_.insert(entry.app_, index);
 
+	entry.available_ = true;
+	emit appAvailable(index);
 }
 
-// add all groups to the widget
-void appdb_load_app(AppEntry *ptr, QListWidget *app, QString group) {
-	app->clear();
-	
-	while (ptr) {
-		if (group == ptr->group_) {
-			new QListWidgetItem(ptr->app_, app);
-		}
-		ptr = ptr->next_;
-	}
+void AppCatalog::probeFinished() {
+	if (arg_debug)
+		printf("executables checked\n");
+	emit probeDone();
 }
 
-void appdb_set_command(AppEntry *ptr, QLineEdit *command, QString app) {
-	while (ptr) {
-		if (app == ptr->app_) {
-			command->setText(ptr->command_);
-			break;
-		}
-		ptr = ptr->next_;
+QList<const AppEntry *> AppCatalog::apps(QString group) const {
+	QList<const AppEntry *> rv;
+	const QVector<int> list = by_group_.value(group);
+	for (int i = 0; i < list.size(); i++) {
+		const AppEntry &entry = entries_.at(list.at(i));
+		if (entry.available_)
+			rv.append(&entry);
 	}
+	return rv;
+}
+
+const AppEntry *AppCatalog::find(QString app) const {
+	QHash<QString, int>::const_iterator it = by_name_.constFind(app);
+	if (it == by_name_.constEnd())
+		return NULL;
+	return &entries_.at(it.value());
+}
+
+void AppCatalog::print() const {
+	for (int i = 0; i < entries_.size(); i++)
+		entries_.at(i).print();
 }
@@ -17,31 +17,108 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+
 #ifndef APPDB_H
 #define APPDB_H
 
 #include "firejail_ui.h"
+#include <QByteArray>
+#include <QHash>
+#include <QObject>
 #include <QString>
-class QListWidget;
-class QLineEdit;
+#include <QStringList>
+#include <QThread>
+#include <QVector>
 
 struct AppEntry {
 	QString group_;
 	QString app_;
 	QString command_;
-	AppEntry *next_;
-	
-	AppEntry(char *line);
-	void print() {
+	QByteArray exec_;	// executable, the first word of the command
+	int group_index_;	// index in AppCatalog::groups()
+	bool available_;	// the executable was found
+
+	void print() const {
 		printf("%s;%s;%s\n", group_.toUtf8().data(), app_.toUtf8().data(), command_.toUtf8().data());
 	}
+};
+
+class AppProbe;
+
+// Application catalog from the uimenus file. The entries are grouped by category and
+// indexed by name. The file is parsed without touching the filesystem; the executables
+// are looked up later in a background thread, against the PATH index in common/pathdb,
+// and every application found is announced with appAvailable().
+class AppCatalog: public QObject {
+Q_OBJECT
+
+public:
+	AppCatalog(QObject *parent = 0);
+	~AppCatalog();
+
+	// parse the uimenus file; returns false if the file is missing
+	bool load();
+	// start resolving the executables in background
+	void probe();
+	bool probing() const;
+
+	// categories, in file order
+	const QStringList &groups() const {
+		return groups_;
+	}
+	// available applications in a category, in file order
+	QList<const AppEntry *> apps(QString group) const;
+	// lookup by application name, NULL if not found
+	const AppEntry *find(QString app) const;
+	const AppEntry &entry(int index) const {
+		return entries_.at(index);
+	}
+	int size() const {
+		return entries_.size();
+	}
 
+	void print() const;
+
+signals:
+	// an application was found; emitted in file order
+	void appAvailable(int index);
+	// all the executables were checked
+	void probeDone();
+
+private slots:
+	void probed(int index, bool found);
+	void probeFinished();
+
+private:
+	friend class AppProbe;
+
+	QVector<AppEntry> entries_;
+	QStringList groups_;
+	QHash<QString, QVector<int> > by_group_;	// category -> entries
+	QHash<QString, int> by_name_;			// application -> first available entry, or first entry
+	AppProbe *probe_;
 };
 
-AppEntry *appdb_load_file(void);
-void appdb_print_list(AppEntry *ptr);
-void appdb_load_group(AppEntry *ptr, QListWidget *group);
-void appdb_load_app(AppEntry *ptr, QListWidget *app, QString group);
-void appdb_set_command(AppEntry *ptr, QLineEdit *command, QString app);
+// executable lookup thread
+class AppProbe: public QThread {
+Q_OBJECT
+
+public:
+	AppProbe(const QVector<QByteArray> &execs, QObject *parent = 0):
+		QThread(parent), execs_(execs), stop_(0) {}
+	void stop() {
+		stop_ = 1;
+	}
+
+signals:
+	void probed(int index, bool found);
+
+protected:
+	void run();
+
+private:
+	QVector<QByteArray> execs_;
+	volatile int stop_;
+};
 
-#endif
\ No newline at end of file
+#endif
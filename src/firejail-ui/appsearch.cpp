@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "appsearch.h"
+#include "appdb.h"
+#include <dirent.h>
+#include <algorithm>
+#include <QElapsedTimer>
+#include <QSet>
+
+#define DESKTOP_DIR "/usr/share/applications"
+#define MIN_HITS_PERCENT 60	// fuzzy matching: share of the query trigrams a name must contain
+
+static inline quint64 trigram(const QChar *p) {
+	return ((quint64) p[0].unicode() << 32) | ((quint64) p[1].unicode() << 16) | p[2].unicode();
+}
+
+// the names are padded with a space at both ends, a trigram can match the start of a word
+static QString pad(const QString &str) {
+	return " " + str.toLower() + " ";
+}
+
+AppSearch::AppSearch(const AppCatalog *catalog, QObject *parent): QThread(parent), ready_(false), stop_(0) {
+	// the catalog is copied in the GUI thread, the background thread doesn't touch it
+	for (int i = 0; i < catalog->size(); i++)
+		addDoc(catalog->entry(i).app_, catalog->entry(i).command_, i);
+	connect(this, SIGNAL(finished()), this, SLOT(buildFinished()));
+}
+
+AppSearch::~AppSearch() {
+	stop_ = 1;
+	wait();
+}
+
+void AppSearch::addDoc(const QString &name, const QString &command, int catalog) {
+	Doc doc;
+	doc.name = name;
+	doc.command = command;
+	doc.catalog = catalog;
+	docs_.append(doc);
+}
+
+// Name and Exec from the [Desktop Entry] group; hidden entries are skipped
+void AppSearch::scanDesktopFiles(const char *dirname) {
+	DIR *dir = opendir(dirname);
+	if (!dir)
+		return;
+
+	// programs already in the catalog
+	QSet<QString> known;
+	for (int i = 0; i < docs_.size(); i++)
+		known.insert(docs_.at(i).command.section(' ', 0, 0).section('/', -1));
+
+	struct dirent *d;
+	while ((d = readdir(dir)) && !stop_) {
+		size_t len = strlen(d->d_name);
+		if (len < 9 || strcmp(d->d_name + len - 8, ".desktop") != 0)
+			continue;
+		int fd = openat(dirfd(dir), d->d_name, O_RDONLY | O_CLOEXEC);
+		if (fd == -1)
+			continue;
+		FILE *fp = fdopen(fd, "r");
+		if (!fp) {
+			close(fd);
+			continue;
+		}
+
+		QString name;
+		QString exec;
+		bool group = false;
+		bool hidden = false;
+		char *line = NULL;
+		size_t size = 0;
+		ssize_t n;
+		while ((n = getline(&line, &size, fp)) != -1) {
+			if (n && line[n - 1] == '\n')
+				line[--n] = '\0';
+			if (*line == '[') {
+				if (group)
+					break;
+				group = strcmp(line, "[Desktop Entry]") == 0;
+			}
+			else if (!group)
+				continue;
+			else if (strncmp(line, "Name=", 5) == 0 && name.isEmpty())
+				name = QString::fromUtf8(line + 5);
+			else if (strncmp(line, "Exec=", 5) == 0 && exec.isEmpty())
+				exec = QString::fromUtf8(line + 5);
+			else if (strcmp(line, "NoDisplay=true") == 0 || strcmp(line, "Hidden=true") == 0)
+				hidden = true;
+		}
+		free(line);
+		fclose(fp);
+		if (hidden || name.isEmpty() || exec.isEmpty())
+			continue;
+
+		// drop the field codes, %f %U etc.
+		QStringList words = exec.split(' ', QString::SkipEmptyParts);
+		QStringList command;
+		for (int i = 0; i < words.size(); i++) {
+			if (!words.at(i).startsWith('%'))
+				command.append(words.at(i));
+		}
+		if (command.isEmpty())
+			continue;
+		QString prog = command.first().section('/', -1);
+		if (known.contains(prog))
+			continue;
+		known.insert(prog);
+		addDoc(name, command.join(" "), -1);
+	}
+	closedir(dir);
+}
+
+void AppSearch::run() {
+	QElapsedTimer timer;
+	timer.start();
+	scanDesktopFiles(DESKTOP_DIR);
+
+	keys_.resize(docs_.size());
+	for (int i = 0; i < docs_.size() && !stop_; i++) {
+		keys_[i] = pad(docs_.at(i).name);
+		const QChar *p = keys_.at(i).constData();
+		int len = keys_.at(i).size();
+		for (int j = 0; j + 3 <= len; j++) {
+			QVector<int> &list = postings_[trigram(p + j)];
+			// every document once per trigram
+			if (list.isEmpty() || list.last() != i)
+				list.append(i);
+		}
+	}
+	if (arg_debug)
+		printf("application index: %d documents, %d trigrams, %lld ms\n",
+			docs_.size(), postings_.size(), (long long) timer.elapsed());
+}
+
+void AppSearch::buildFinished() {
+	if (stop_)
+		return;
+	hits_.fill(0, docs_.size());
+	scores_.fill(0, docs_.size());
+	ready_ = true;
+	emit indexReady();
+}
+
+// higher is better
+int AppSearch::score(int doc, const QString &text, int hits) const {
+	const QString &key = keys_.at(doc);
+	int rv = hits * 10;
+	int pos = key.indexOf(text);
+	if (pos == 1)
+		rv += 100;		// prefix
+	else if (pos > 0 && key.at(pos - 1) == ' ')
+		rv += 60;		// start of a word
+	else if (pos > 0)
+		rv += 30;
+	return rv * 64 - qMin(key.size(), 63);	// shorter names first
+}
+
+struct ScoreCompare {
+	const QVector<int> *scores;
+	bool operator()(int a, int b) const {
+		return scores->at(a) > scores->at(b);
+	}
+};
+
+QList<int> AppSearch::query(QString text, int max) {
+	QList<int> rv;
+	if (!ready_)
+		return rv;
+	text = text.toLower().simplified();
+	if (text.isEmpty())
+		return rv;
+
+	QElapsedTimer timer;
+	timer.start();
+	QVector<int> candidates;
+
+	if (text.size() < 3) {
+		// too short for trigrams, scan the names
+		for (int i = 0; i < docs_.size(); i++) {
+			if (keys_.at(i).contains(text)) {
+				candidates.append(i);
+				scores_[i] = score(i, text, 0);
+			}
+		}
+	}
+	else {
+		// count the query trigrams found in every name, only the names sharing
+		// at least one trigram with the query are visited
+		QString padded = " " + text;
+		QVector<quint64> grams;
+		for (int j = 0; j + 3 <= padded.size(); j++) {
+			quint64 g = trigram(padded.constData() + j);
+			if (!grams.contains(g))
+				grams.append(g);
+		}
+		QVector<int> touched;
+		for (int k = 0; k < grams.size(); k++) {
+			QHash<quint64, QVector<int> >::const_iterator it = postings_.constFind(grams.at(k));
+			if (it == postings_.constEnd())
+				continue;
+			const QVector<int> &list = it.value();
+			for (int j = 0; j < list.size(); j++) {
+				if (hits_[list.at(j)]++ == 0)
+					touched.append(list.at(j));
+			}
+		}
+
+		int min_hits = (grams.size() * MIN_HITS_PERCENT + 99) / 100;
+		for (int j = 0; j < touched.size(); j++) {
+			int doc = touched.at(j);
+			int hits = hits_.at(doc);
+			hits_[doc] = 0;
+			if (hits < min_hits)
+				continue;
+			candidates.append(doc);
+			scores_[doc] = score(doc, text, hits);
+		}
+	}
+
+	ScoreCompare cmp;
+	cmp.scores = &scores_;
+	int n = qMin(max, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(), cmp);
+	for (int i = 0; i < n; i++)
+		rv.append(candidates.at(i));
+
+	if (arg_debug)
+		printf("application search \"%s\": %d matches, %lld us\n", text.toUtf8().constData(),
+			candidates.size(), (long long) timer.nsecsElapsed() / 1000);
+	return rv;
+}
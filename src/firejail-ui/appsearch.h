@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef APPSEARCH_H
+#define APPSEARCH_H
+
+#include "firejail_ui.h"
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QString>
+#include <QThread>
+#include <QVector>
+
+class AppCatalog;
+
+// Trigram index over the application catalog and the desktop files in
+// /usr/share/applications. The index is built once in a background thread and queried
+// from the GUI thread only after it is ready.
+class AppSearch: public QThread {
+Q_OBJECT
+
+public:
+	struct Doc {
+		QString name;
+		QString command;
+		int catalog;		// index in AppCatalog, -1 for desktop files
+	};
+
+	AppSearch(const AppCatalog *catalog, QObject *parent = 0);
+	~AppSearch();
+
+	bool ready() const {
+		return ready_;
+	}
+	// best matches for the text, at most max documents, best first
+	QList<int> query(QString text, int max);
+	const Doc &doc(int index) const {
+		return docs_.at(index);
+	}
+
+signals:
+	void indexReady();
+
+protected:
+	void run();
+
+private slots:
+	void buildFinished();
+
+private:
+	void addDoc(const QString &name, const QString &command, int catalog);
+	void scanDesktopFiles(const char *dir);
+	int score(int doc, const QString &text, int hits) const;
+
+	QVector<Doc> docs_;
+	QVector<QString> keys_;			// lowercase names
+	QHash<quint64, QVector<int> > postings_;	// trigram -> documents
+	bool ready_;
+	volatile int stop_;
+
+	// per document query state, allocated once and reused on every keystroke
+	QVector<int> hits_;
+	QVector<int> scores_;
+};
+
+#endif
@@ -25,6 +25,8 @@
 #endif
 
 #include <QCheckBox>
+#include <QRunnable>
+#include <QThreadPool>
 #include "firejail_ui.h"
 #include "home_widget.h"
 #include "../common/utils.h"
@@ -32,20 +34,34 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
 
+#define ESTIMATE_THREADS 4
+#define ESTIMATE_MAX_FILES 200000	// per directory, the estimate is partial after that
 
-HomeWidget::HomeWidget(QWidget * parent): QListWidget(parent) {
-	readFiles();
+// home directory file descriptor, -1 if not available
+static int open_home() {
+	char *homedir = get_home_directory();
+	int fd = open(homedir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1 && arg_debug)
+		printf("cannot open %s\n", homedir);
+	free(homedir);
+	return fd;
 }
 
-void HomeWidget::readFiles() {
-	char *homedir = get_home_directory();
-	DIR *dir = opendir(homedir);
-	if (!dir)
-		errExit("opendir");
-	
+void HomeScanner::run() {
+	if (homefd_ == -1)
+		return;
+	int fd = dup(homefd_);
+	DIR *dir = (fd == -1)? NULL: fdopendir(fd);
+	if (!dir) {
+		if (fd != -1)
+			close(fd);
+		return;
+	}
+
 	struct dirent *entry;
-	while ((entry = readdir(dir))) {
+	while ((entry = readdir(dir)) && !stop_) {
 		// with a few exceptions, reject all dot files
 		bool accept = false;
 		if (strcmp(entry->d_name, ".config") == 0 ||
@@ -53,32 +69,139 @@ void HomeWidget::readFiles() {
 		    	accept = true;
 		if (!accept && *entry->d_name == '.')
 			continue;
-		
-		// allow only directorries 
-		struct stat s;
-		char *name;
-		if (asprintf(&name, "%s/%s", homedir, entry->d_name) == -1)
-			errExit("asprintf");
-		if (stat(name, &s) == -1) {
-			free(name);
-			continue;
+
+		// allow only directories; the path is resolved relative to the home directory
+		// and symlinks are followed, same as stat
+		if (entry->d_type != DT_DIR) {
+			struct stat s;
+			if (fstatat(homefd_, entry->d_name, &s, 0) == -1 || !S_ISDIR(s.st_mode))
+				continue;
 		}
-		free(name);
-		if (!S_ISDIR(s.st_mode))
-			continue;
 
 		if (arg_debug)
 			printf("configuring homewidget entry %s\n", entry->d_name);
-
-		QCheckBox *box = new QCheckBox(entry->d_name);
-		QListWidgetItem *item = new QListWidgetItem();
-		addItem(item);
-		setItemWidget(item, box);
+		emit directoryFound(QString::fromUtf8(entry->d_name));
 	}
-	
+
 	closedir(dir);
 }
 
+// recursive size of one directory, on the same filesystem; symlinks are not followed
+class SizeEstimate : public QRunnable {
+public:
+	SizeEstimate(HomeWidget *widget, int homefd, QString name, volatile int *cancel):
+		widget_(widget), homefd_(homefd), name_(name), cancel_(cancel), size_(0), files_(0) {}
+
+	void run() {
+		int fd = openat(homefd_, name_.toUtf8().constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd == -1)
+			return;
+		struct stat s;
+		if (fstat(fd, &s) == -1) {
+			close(fd);
+			return;
+		}
+		walk(fd, s.st_dev);
+		if (*cancel_)
+			return;
+		QMetaObject::invokeMethod(widget_, "setSize", Qt::QueuedConnection,
+			Q_ARG(QString, name_), Q_ARG(quint64, size_), Q_ARG(bool, files_ >= ESTIMATE_MAX_FILES));
+	}
+
+private:
+	// fd is closed on return
+	void walk(int fd, dev_t dev) {
+		DIR *dir = fdopendir(fd);
+		if (!dir) {
+			close(fd);
+			return;
+		}
+		struct dirent *entry;
+		while ((entry = readdir(dir)) && !*cancel_ && files_ < ESTIMATE_MAX_FILES) {
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+				continue;
+			struct stat s;
+			if (fstatat(dirfd(dir), entry->d_name, &s, AT_SYMLINK_NOFOLLOW) == -1)
+				continue;
+			files_++;
+			if (S_ISREG(s.st_mode))
+				size_ += s.st_size;
+			else if (S_ISDIR(s.st_mode) && s.st_dev == dev) {
+				int child = openat(dirfd(dir), entry->d_name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+				if (child != -1)
+					walk(child, dev);
+			}
+		}
+		closedir(dir);
+	}
+
+	HomeWidget *widget_;
+	int homefd_;
+	QString name_;
+	volatile int *cancel_;
+	quint64 size_;
+	int files_;
+};
+
+HomeWidget::HomeWidget(QWidget * parent): QListWidget(parent), estimate_(false), cancel_(0) {
+	pool_ = new QThreadPool(this);
+	pool_->setMaxThreadCount(ESTIMATE_THREADS);
+
+	// all the paths are resolved relative to this descriptor, from any thread
+	homefd_ = open_home();
+
+	// the list is filled in as the directories are found
+	scanner_ = new HomeScanner(homefd_, this);
+	connect(scanner_, SIGNAL(directoryFound(QString)), this, SLOT(addDirectory(QString)));
+	scanner_->start();
+}
+
+HomeWidget::~HomeWidget() {
+	scanner_->stop();
+	scanner_->wait();
+	cancel_ = 1;
+	pool_->waitForDone();
+	if (homefd_ != -1)
+		close(homefd_);
+}
+
+void HomeWidget::addDirectory(QString name) {
+	QCheckBox *box = new QCheckBox(name);
+	QListWidgetItem *item = new QListWidgetItem();
+	item->setData(Qt::UserRole, name);
+	addItem(item);
+	setItemWidget(item, box);
+	if (estimate_)
+		startEstimate(name);
+}
+
+void HomeWidget::estimateSizes() {
+	if (estimate_)
+		return;
+	estimate_ = true;
+	// the directories found from now on are started in addDirectory
+	for (int i = 0; i < count(); ++i)
+		startEstimate(item(i)->data(Qt::UserRole).toString());
+}
+
+void HomeWidget::startEstimate(const QString &name) {
+	if (homefd_ != -1)
+		pool_->start(new SizeEstimate(this, homefd_, name, &cancel_));
+}
+
+void HomeWidget::setSize(QString name, quint64 size, bool partial) {
+	for (int i = 0; i < count(); ++i) {
+		QListWidgetItem *ptr = item(i);
+		if (ptr->data(Qt::UserRole).toString() != name)
+			continue;
+		QCheckBox *box = (QCheckBox *) itemWidget(ptr);
+		char buf[HUMAN_SIZE_MAX];
+		QString txt = name + "  (" + ((partial)? "> ": "") + human_size(size, buf) + ")";
+		box->setText(txt);
+		break;
+	}
+}
+
 QString HomeWidget::getContent() {
 	QString retval = QString("");
 
@@ -86,10 +209,8 @@ QString HomeWidget::getContent() {
 		QListWidgetItem* ptr = item(i);
 		
 		QCheckBox *box = (QCheckBox *) itemWidget(ptr);
-		if (box->isChecked()) {
-			QString name = box->text();
-			retval += "whitelist ~/" + box->text() + "\n";
-		}	
+		if (box->isChecked())
+			retval += "whitelist ~/" + ptr->data(Qt::UserRole).toString() + "\n";
 	}
 
 	return retval;
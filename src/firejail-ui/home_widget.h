@@ -22,18 +22,57 @@
 
 #include "firejail_ui.h"
 #include <QListWidget>
+#include <QThread>
 
+class QThreadPool;
+
+// home directory reader, running in background; the directories are passed to the
+// widget one by one as they are found
+class HomeScanner : public QThread {
+	Q_OBJECT
+
+public:
+	HomeScanner(int homefd, QObject *parent = 0): QThread(parent), homefd_(homefd), stop_(0) {}
+	void stop() {
+		stop_ = 1;
+	}
+
+signals:
+	void directoryFound(QString name);
+
+protected:
+	void run();
+
+private:
+	int homefd_;
+	volatile int stop_;
+};
 
 class HomeWidget : public QListWidget {
 	Q_OBJECT
 
 public:
 	HomeWidget(QWidget * parent = 0);
+	~HomeWidget();
 	QString getContent();
+	// compute the size of every directory in background, the sizes are shown next to the names
+	void estimateSizes();
+
+public slots:
+	// called from the size estimate tasks; partial if the walk stopped early
+	void setSize(QString name, quint64 size, bool partial);
+
+private slots:
+	void addDirectory(QString name);
 
 private:
-	void readFiles();
+	void startEstimate(const QString &name);
+
+	int homefd_;
+	HomeScanner *scanner_;
+	QThreadPool *pool_;
+	bool estimate_;
+	volatile int cancel_;
 };
 
 #endif
-
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "firejail_ui.h"
+#include "launch.h"
+#include "../common/subprocess.h"
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/inotify.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define RUNDIR "/run/firejail"
+#define CHECK_INTERVAL 50	// ms, the ready file is not visible to inotify
+#define FALLBACK_DELAY 1000	// ms, the sandbox is assumed ready if the ready file cannot be checked
+#define MAXERR (16 * 1024)	// error text kept for the message
+
+static long long now_ms() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// watch /run/firejail and its subdirectories; firejail creates its files there
+// (sandbox lock, name, profile, network etc.) while the sandbox is set up
+static int watch_rundir() {
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	uint32_t mask = IN_CREATE | IN_MOVED_TO | IN_CLOSE_WRITE;
+	if (inotify_add_watch(fd, RUNDIR, mask) == -1) {
+		close(fd);
+		return -1;
+	}
+
+	DIR *dir = opendir(RUNDIR);
+	if (dir) {
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (entry->d_type != DT_DIR || *entry->d_name == '.')
+				continue;
+			char *path;
+			if (asprintf(&path, RUNDIR "/%s", entry->d_name) == -1)
+				errExit("asprintf");
+			inotify_add_watch(fd, path, mask);
+			free(path);
+		}
+		closedir(dir);
+	}
+	return fd;
+}
+
+// the sandbox is a child of the firejail process; firejail creates
+// /run/firejail/mnt/ready-for-join in the sandbox when the setup is finished
+// returns 1 if ready, 0 if not yet, -1 if the sandbox cannot be checked: the sandbox root
+// cannot be accessed (EACCES/EPERM, e.g. the sandbox runs in a different user namespace), or
+// the kernel doesn't provide the children file (CONFIG_PROC_CHILDREN)
+static int sandbox_ready(pid_t pid) {
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/task/%d/children", pid, pid) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp) {
+		// firejail exited, this is picked up by the caller
+		if (kill(pid, 0) == -1 && errno == ESRCH)
+			return 0;
+		return -1;
+	}
+
+	int rv = 0;
+	int child;
+	while (rv == 0 && fscanf(fp, "%d", &child) == 1) {
+		if (asprintf(&fname, "/proc/%d/root/run/firejail/mnt/ready-for-join", child) == -1)
+			errExit("asprintf");
+		if (access(fname, F_OK) == 0)
+			rv = 1;
+		else if (errno == EACCES || errno == EPERM)
+			rv = -1;
+		free(fname);
+	}
+	fclose(fp);
+	return rv;
+}
+
+// copy the data from the pipe on stderr; the first MAXERR bytes are also kept in buf
+// returns -1 on end of file
+static int copy_stderr(int fd, char *buf, size_t *len) {
+	char data[4096];
+	ssize_t rv = read(fd, data, sizeof(data));
+	if (rv == -1 && (errno == EINTR || errno == EAGAIN))
+		return 0;
+	if (rv <= 0)
+		return -1;
+
+	ssize_t written = write(2, data, rv);
+	(void) written;
+	size_t n = ((size_t) rv < MAXERR - *len)? rv: MAXERR - *len;
+	memcpy(buf + *len, data, n);
+	*len += n;
+	buf[*len] = '\0';
+	return 0;
+}
+
+// the sandbox keeps the pipe after the program exits; a small process copies the
+// remaining output on stderr, this way the program doesn't get SIGPIPE
+static void relay_stderr(int fd) {
+	pid_t pid = fork();
+	if (pid == -1)
+		return;
+	if (pid == 0) {
+		// the second fork detaches the relay, it is adopted by init
+		if (fork() != 0)
+			_exit(0);
+		char buf[4096];
+		ssize_t rv;
+		while ((rv = read(fd, buf, sizeof(buf))) != 0) {
+			if (rv == -1) {
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+			ssize_t written = write(2, buf, rv);
+			(void) written;
+		}
+		_exit(0);
+	}
+	waitpid(pid, NULL, 0);
+}
+
+pid_t launch_sandbox(char *const argv[], int timeout_ms, char **err) {
+	if (err)
+		*err = NULL;
+
+	int errfd = -1;
+	pid_t pid = subprocess_spawn(argv, &errfd);
+	if (pid == -1) {
+		if (err && asprintf(err, "cannot start %s: %s", argv[0], strerror(errno)) == -1)
+			errExit("asprintf");
+		return -1;
+	}
+
+	// without pidfd support the process is checked at every CHECK_INTERVAL
+	int pidfd = syscall(SYS_pidfd_open, pid, 0);
+	int ifd = watch_rundir();
+	if (arg_debug)
+		printf("firejail pid %d, pidfd %d, inotify %d\n", pid, pidfd, ifd);
+
+	char *errbuf = (char *) malloc(MAXERR + 1);
+	if (!errbuf)
+		errExit("malloc");
+	size_t errlen = 0;
+	*errbuf = '\0';
+
+	long long start = now_ms();
+	bool ready = false;
+	bool blind = false;	// the ready file cannot be checked
+	bool exited = false;
+	int status = 0;
+	while (!ready && !exited) {
+		long long left = start + timeout_ms - now_ms();
+		if (left <= 0)
+			break;
+
+		struct pollfd pfd[3];
+		int nfds = 0;
+		int errindex = -1;
+		int pidindex = -1;
+		int inindex = -1;
+		if (errfd != -1) {
+			pfd[nfds].fd = errfd;
+			pfd[nfds].events = POLLIN;
+			errindex = nfds++;
+		}
+		if (pidfd != -1) {
+			pfd[nfds].fd = pidfd;
+			pfd[nfds].events = POLLIN;
+			pidindex = nfds++;
+		}
+		if (ifd != -1) {
+			pfd[nfds].fd = ifd;
+			pfd[nfds].events = POLLIN;
+			inindex = nfds++;
+		}
+		int rv = poll(pfd, nfds, (left < CHECK_INTERVAL)? left: CHECK_INTERVAL);
+		if (rv == -1 && errno != EINTR)
+			errExit("poll");
+
+		if (rv > 0 && errindex != -1 && (pfd[errindex].revents & (POLLIN | POLLHUP))) {
+			if (copy_stderr(errfd, errbuf, &errlen)) {
+				close(errfd);
+				errfd = -1;
+			}
+		}
+		if (rv > 0 && inindex != -1 && (pfd[inindex].revents & POLLIN)) {
+			char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+			while (read(ifd, buf, sizeof(buf)) > 0)
+				;
+		}
+
+		// pidfd becomes readable when the process exits; without it, check at every interval
+		if (pidindex == -1 || (rv > 0 && (pfd[pidindex].revents & POLLIN))) {
+			if (waitpid(pid, &status, WNOHANG) == pid) {
+				exited = true;
+				break;
+			}
+		}
+		int state = sandbox_ready(pid);
+		if (state == -1 && !blind) {
+			blind = true;
+			if (arg_debug)
+				printf("cannot check the sandbox, waiting %d ms\n", FALLBACK_DELAY);
+		}
+		// without access to the sandbox, a firejail still running after FALLBACK_DELAY is
+		// taken as started, same as the fixed delay used before
+		ready = (state == 1) || (blind && now_ms() - start >= FALLBACK_DELAY);
+	}
+
+	if (pidfd != -1)
+		close(pidfd);
+	if (ifd != -1)
+		close(ifd);
+	if (arg_debug)
+		printf("sandbox %s after %lld ms\n",
+		       (ready)? "ready": (exited)? "exited": "not confirmed", now_ms() - start);
+
+	// a short program could run and exit normally before the check
+	if (exited && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+		exited = false;
+
+	if (exited) {
+		// collect the rest of the error message; processes started by firejail could
+		// still keep the pipe open, stop as soon as no more data is coming
+		while (errfd != -1) {
+			struct pollfd pfd = { errfd, POLLIN, 0 };
+			if (poll(&pfd, 1, CHECK_INTERVAL) <= 0 || copy_stderr(errfd, errbuf, &errlen)) {
+				close(errfd);
+				errfd = -1;
+			}
+		}
+		if (err) {
+			if (errlen)
+				*err = errbuf;
+			else {
+				free(errbuf);
+				if (WIFEXITED(status) &&
+				    asprintf(err, "firejail exited with status %d", WEXITSTATUS(status)) == -1)
+					errExit("asprintf");
+				else if (WIFSIGNALED(status) &&
+				    asprintf(err, "firejail killed by signal %d", WTERMSIG(status)) == -1)
+					errExit("asprintf");
+			}
+		}
+		else
+			free(errbuf);
+		return -1;
+	}
+
+	free(errbuf);
+	if (errfd != -1) {
+		relay_stderr(errfd);
+		close(errfd);
+	}
+	return pid;
+}
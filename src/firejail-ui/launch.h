@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef LAUNCH_H
+#define LAUNCH_H
+#include <sys/types.h>
+
+// Start a sandbox and wait until it is running. The firejail process is started with
+// subprocess_spawn; its exit is detected through a pidfd, and the sandbox setup through
+// inotify events in /run/firejail. The sandbox is running as soon as firejail's
+// ready-for-join file shows up in the mount namespace of the sandbox. If the sandbox root
+// cannot be accessed (EACCES/EPERM), or the kernel has no /proc/<pid>/task/<pid>/children,
+// firejail still running after one second is taken as a started sandbox.
+//
+// Returns the pid of the firejail process, or -1 if the sandbox could not be started; in
+// this case the error printed by firejail is returned in *err (allocated memory, it can be
+// NULL). If firejail is still running after timeout_ms, the sandbox is considered started.
+// The error output of firejail and of the sandboxed program is copied on stderr.
+pid_t launch_sandbox(char *const argv[], int timeout_ms, char **err);
+
+#endif
@@ -22,128 +22,74 @@
 #ifndef _GNU_SOURCE
 #define _GNU_SOURCE
 #endif
+#include "../common/netinfo.h"
 #include <arpa/inet.h>
 #include <sys/socket.h>
-#include <netdb.h>
-#include <ifaddrs.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
-#include <linux/if.h>
-#include <linux/if_link.h>
-#include <linux/wireless.h>
-#include <sys/ioctl.h>
 
-#define BUFSIZE 1024
-
-// return default gateway for the system in host format
-uint32_t network_get_defaultgw() {
-	FILE *fp = fopen("/proc/self/net/route", "r");
-	if (!fp)
-		// probably we are dealing with a GrSecurity system
-		return 0; // attempt error recovery
-	
-	char buf[BUFSIZE];
-	uint32_t retval = 0;
-	while (fgets(buf, BUFSIZE, fp)) {
-		if (strncmp(buf, "Iface", 5) == 0)
-			continue;
-		
-		char *ptr = buf;
-		while (*ptr != ' ' && *ptr != '\t')
-			ptr++;
-		while (*ptr == ' ' || *ptr == '\t')
-			ptr++;
-			
-		unsigned dest;
-		unsigned gw;
-		int rv = sscanf(ptr, "%x %x", &dest, &gw);
-		if (rv == 2 && dest == 0) {
-			retval = ntohl(gw);
-			break;
-		}
-	}
-
-	fclose(fp);
-	return retval;
-}
-
-
-
-// return 1 if the interface is a wireless interface
-int check_wireless(const char* ifname, char* protocol) {
-	int sock = -1;
-	struct iwreq pwrq;
-	memset(&pwrq, 0, sizeof(pwrq));
-	strncpy(pwrq.ifr_name, ifname, IFNAMSIZ);
-
-	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1) {
-		perror("sockqet");
-		return 0;
-	}
-
-	if (ioctl(sock, SIOCGIWNAME, &pwrq) != -1) {
-		if (protocol)
-			strncpy(protocol, pwrq.u.name, IFNAMSIZ);
-		close(sock);
-		return 1;
-	}
-
-	close(sock);
-	return 0;
-}
+#define NETINFO_AGE 1000	// ms, accept a snapshot this old
 
 // detect network
 const char *detect_network() {
-	struct ifaddrs *ifaddr, *ifa;
-
-	if (getifaddrs(&ifaddr) == -1)
-		errExit("getifaddrs");
-		
-	// find the default gateway
-	uint32_t gw = network_get_defaultgw();
-	printf("default gateway detected: %d.%d.%d.%d\n", PRINT_IP(gw));
-	if (gw == 0) {
+	NetInfo ni;
+	if (netinfo_get(&ni, NETINFO_AGE) == -1) {
+		fprintf(stderr, "Warning: cannot read the network configuration. Networking namespace is disabled.\n");
+		return "";
+	}
+	if (ni.routecnt == 0) {
 		fprintf(stderr, "Warning: cannot find the default gateway. Networking namespace is disabled.\n");
+		netinfo_free(&ni);
 		return "";
 	}
-	
-	// Walk through linked list, maintaining head pointer so we can free list later
-	for (ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
-		if (ifa->ifa_addr == NULL)
-			continue;
 
-		int family = ifa->ifa_addr->sa_family;
-		if (family != AF_INET)
+	// the default routes are sorted, IPv4 first, lowest metric first
+	for (int i = 0; i < ni.routecnt; i++) {
+		const NetRoute *r = &ni.routes[i];
+		const NetIf *nif = netinfo_find_index(&ni, r->ifindex);
+		if (!nif)
 			continue;
-		
+
+		char gw[INET6_ADDRSTRLEN];
+		if (r->family == AF_INET)
+			snprintf(gw, sizeof(gw), "%d.%d.%d.%d", PRINT_IP(r->gw));
+		else if (!inet_ntop(AF_INET6, &r->gw6, gw, sizeof(gw)))
+			strcpy(gw, "?");
+		printf("default gateway detected: %s on %s, metric %u\n", gw, nif->name, r->metric);
+
 		// no loopback
-		if (ifa->ifa_flags & IFF_LOOPBACK)
+		if (nif->flags & IFF_LOOPBACK)
 			continue;
 
 		// interface not running
-		if ((ifa->ifa_flags & (IFF_UP | IFF_RUNNING)) != (IFF_UP | IFF_RUNNING))
+		if ((nif->flags & (IFF_UP | IFF_RUNNING)) != (IFF_UP | IFF_RUNNING))
 			continue;
-		
+
 		// no wireless
-		if (check_wireless(ifa->ifa_name, NULL))
+		if (nif->wireless)
 			continue;
 
-		uint32_t if_addr = ntohl(((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr);
-		uint32_t if_mask = ntohl(((struct sockaddr_in *)ifa->ifa_netmask)->sin_addr.s_addr);
-		printf("network interface: %s %d.%d.%d.%d %d.%d.%d.%d\n", 
-			ifa->ifa_name, PRINT_IP(if_addr), PRINT_IP(if_mask));
+		// firejail's net needs an IPv4 address on the parent interface, an IPv6 only
+		// default route is not usable
+		if (r->family != AF_INET || nif->addr4cnt == 0)
+			continue;
 
-		// check default gateway is resolved on this interface
-		if (in_netrange(gw, if_addr, if_mask) == NULL) {
-			char *ifname = strdup(ifa->ifa_name);
-			if (!ifname)
-				errExit("strdup");
-			freeifaddrs(ifaddr);
-			return ifname;
-		}
+		// check default gateway is resolved on one of the addresses of this interface
+		const NetAddr4 *addr = &nif->addr4[0];
+		if (r->gw && (addr = netinfo_find_net(nif, r->gw)) == NULL)
+			continue;
+		printf("network interface: %s %d.%d.%d.%d %d.%d.%d.%d\n",
+			nif->name, PRINT_IP(addr->ip), PRINT_IP(addr->mask));
+
+		char *ifname = strdup(nif->name);
+		if (!ifname)
+			errExit("strdup");
+		netinfo_free(&ni);
+		return ifname;
 	}
+
 	fprintf(stderr, "Warning: no suitable interface detected for network namespace.\n");
-	freeifaddrs(ifaddr);
+	netinfo_free(&ni);
 	return "";
 }
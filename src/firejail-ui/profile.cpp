@@ -0,0 +1,945 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include "firejail_ui.h"
+#include "profile.h"
+#include "../common/utils.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+
+#define CACHE_MAGIC "FTPROFILE2\n"
+#define CACHE_MAGIC_LEN 11
+#define HASH_SIZE 256
+#define SYSCFG "/etc/firejail"
+
+// line types
+#define LINE_DIRECTIVE	0
+#define LINE_INCLUDE	1
+
+// directive arguments
+#define ARG_NONE	0	// no argument
+#define ARG_OPTIONAL	1	// optional argument
+#define ARG_REQUIRED	2	// one or more words
+#define ARG_PATH	3	// file or directory
+#define ARG_OPTPATH	4	// optional file or directory
+
+typedef struct {
+	const char *name;
+	int arg;
+} Directive;
+
+// profile commands known to firejail; unknown commands are reported as warnings,
+// the list could be older than the firejail version installed
+static const Directive directives[] = {
+	// filesystem
+	{ "blacklist", ARG_PATH },
+	{ "blacklist-nolog", ARG_PATH },
+	{ "noblacklist", ARG_PATH },
+	{ "whitelist", ARG_PATH },
+	{ "whitelist-ro", ARG_PATH },
+	{ "nowhitelist", ARG_PATH },
+	{ "read-only", ARG_PATH },
+	{ "read-write", ARG_PATH },
+	{ "noexec", ARG_PATH },
+	{ "tmpfs", ARG_PATH },
+	{ "mkdir", ARG_PATH },
+	{ "mkfile", ARG_PATH },
+	{ "bind", ARG_REQUIRED },
+	{ "private", ARG_OPTPATH },
+	{ "private-bin", ARG_REQUIRED },
+	{ "private-etc", ARG_REQUIRED },
+	{ "private-lib", ARG_OPTIONAL },
+	{ "private-opt", ARG_REQUIRED },
+	{ "private-srv", ARG_REQUIRED },
+	{ "private-home", ARG_REQUIRED },
+	{ "private-cache", ARG_NONE },
+	{ "private-cwd", ARG_OPTPATH },
+	{ "private-dev", ARG_NONE },
+	{ "private-tmp", ARG_NONE },
+	{ "disable-mnt", ARG_NONE },
+	{ "overlay", ARG_NONE },
+	{ "overlay-tmpfs", ARG_NONE },
+	{ "writable-etc", ARG_NONE },
+	{ "writable-run-user", ARG_NONE },
+	{ "writable-var", ARG_NONE },
+	{ "writable-var-log", ARG_NONE },
+	{ "keep-config-pulse", ARG_NONE },
+	{ "keep-dev-shm", ARG_NONE },
+	{ "keep-var-tmp", ARG_NONE },
+	{ "keep-fd", ARG_REQUIRED },
+	{ "keep-shell-rc", ARG_NONE },
+	{ "machine-id", ARG_NONE },
+	{ "hosts-file", ARG_PATH },
+	{ "allusers", ARG_NONE },
+	{ "tracelog", ARG_NONE },
+
+	// network
+	{ "net", ARG_REQUIRED },
+	{ "netfilter", ARG_OPTPATH },
+	{ "netfilter6", ARG_PATH },
+	{ "netns", ARG_REQUIRED },
+	{ "interface", ARG_REQUIRED },
+	{ "ip", ARG_REQUIRED },
+	{ "ip6", ARG_REQUIRED },
+	{ "iprange", ARG_REQUIRED },
+	{ "mac", ARG_REQUIRED },
+	{ "mtu", ARG_REQUIRED },
+	{ "netmask", ARG_REQUIRED },
+	{ "defaultgw", ARG_REQUIRED },
+	{ "veth-name", ARG_REQUIRED },
+	{ "dns", ARG_REQUIRED },
+	{ "hostname", ARG_REQUIRED },
+	{ "protocol", ARG_REQUIRED },
+
+	// multimedia and devices
+	{ "nosound", ARG_NONE },
+	{ "noautopulse", ARG_NONE },
+	{ "no3d", ARG_NONE },
+	{ "nodvd", ARG_NONE },
+	{ "novideo", ARG_NONE },
+	{ "notv", ARG_NONE },
+	{ "nou2f", ARG_NONE },
+	{ "noinput", ARG_NONE },
+	{ "noprinters", ARG_NONE },
+	{ "x11", ARG_OPTIONAL },
+	{ "xephyr-screen", ARG_REQUIRED },
+
+	// kernel and security
+	{ "seccomp", ARG_OPTIONAL },
+	{ "seccomp.drop", ARG_REQUIRED },
+	{ "seccomp.keep", ARG_REQUIRED },
+	{ "seccomp.32", ARG_OPTIONAL },
+	{ "seccomp.32.drop", ARG_REQUIRED },
+	{ "seccomp.32.keep", ARG_REQUIRED },
+	{ "seccomp.block-secondary", ARG_NONE },
+	{ "seccomp-error-action", ARG_REQUIRED },
+	{ "caps", ARG_NONE },
+	{ "caps.drop", ARG_REQUIRED },
+	{ "caps.keep", ARG_REQUIRED },
+	{ "nonewprivs", ARG_NONE },
+	{ "noroot", ARG_NONE },
+	{ "nogroups", ARG_NONE },
+	{ "apparmor", ARG_OPTIONAL },
+	{ "apparmor-replace", ARG_NONE },
+	{ "apparmor-stack", ARG_NONE },
+	{ "landlock.enforce", ARG_NONE },
+	{ "landlock.fs.read", ARG_PATH },
+	{ "landlock.fs.write", ARG_PATH },
+	{ "landlock.fs.makeipc", ARG_PATH },
+	{ "landlock.fs.makedev", ARG_PATH },
+	{ "landlock.fs.execute", ARG_PATH },
+	{ "memory-deny-write-execute", ARG_NONE },
+	{ "restrict-namespaces", ARG_OPTIONAL },
+	{ "ipc-namespace", ARG_NONE },
+	{ "allow-debuggers", ARG_NONE },
+	{ "nodbus", ARG_NONE },
+	{ "dbus-user", ARG_REQUIRED },
+	{ "dbus-user.own", ARG_REQUIRED },
+	{ "dbus-user.talk", ARG_REQUIRED },
+	{ "dbus-user.see", ARG_REQUIRED },
+	{ "dbus-user.call", ARG_REQUIRED },
+	{ "dbus-user.broadcast", ARG_REQUIRED },
+	{ "dbus-system", ARG_REQUIRED },
+	{ "dbus-system.own", ARG_REQUIRED },
+	{ "dbus-system.talk", ARG_REQUIRED },
+	{ "dbus-system.see", ARG_REQUIRED },
+	{ "dbus-system.call", ARG_REQUIRED },
+	{ "dbus-system.broadcast", ARG_REQUIRED },
+
+	// resources and environment
+	{ "rlimit-as", ARG_REQUIRED },
+	{ "rlimit-cpu", ARG_REQUIRED },
+	{ "rlimit-fsize", ARG_REQUIRED },
+	{ "rlimit-nofile", ARG_REQUIRED },
+	{ "rlimit-nproc", ARG_REQUIRED },
+	{ "rlimit-sigpending", ARG_REQUIRED },
+	{ "cpu", ARG_REQUIRED },
+	{ "nice", ARG_REQUIRED },
+	{ "cgroup", ARG_PATH },
+	{ "timeout", ARG_REQUIRED },
+	{ "env", ARG_REQUIRED },
+	{ "rmenv", ARG_REQUIRED },
+	{ "name", ARG_REQUIRED },
+	{ "shell", ARG_REQUIRED },
+	{ "join-or-start", ARG_REQUIRED },
+	{ "deterministic-exit-code", ARG_NONE },
+	{ "deterministic-shutdown", ARG_NONE },
+	{ "quiet", ARG_NONE },
+	{ NULL, 0 }
+};
+
+typedef struct {
+	int type;
+	int lineno;
+	char *text;		// the full line for directives, the file name for includes
+} Line;
+
+typedef struct {
+	int lineno;
+	int warning;
+	char *msg;
+} Error;
+
+// parsed file
+typedef struct File {
+	char *path;
+	int exists;
+	ino_t ino;
+	off_t size;
+	struct timespec mtime;
+	Line *lines;
+	int nlines;
+	Error *errors;
+	int nerrors;
+	int checked;		// the stamp was verified in this program run
+	int state;		// expansion state, see expand()
+	unsigned generation;	// profile_compile run owning the state
+	struct File *next;	// hash chain
+} File;
+
+// growing string buffer
+typedef struct {
+	char *data;
+	size_t len;
+	size_t size;
+} Buffer;
+
+// growing string array
+typedef struct {
+	char **str;
+	int cnt;
+} Strings;
+
+struct Profile {
+	Buffer source;
+	Buffer output;
+	Strings errors;
+	Strings warnings;
+};
+
+// parsed files, loaded from the cache file on the first compile
+static File *table[HASH_SIZE];
+static int cache_loaded = 0;
+static int cache_dirty = 0;
+static unsigned generation = 0;
+
+// FNV-1a
+static inline uint32_t hash(const char *str) {
+	uint32_t h = 2166136261u;
+	while (*str) {
+		h ^= (unsigned char) *str++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static void buffer_add(Buffer *b, const char *str, size_t len) {
+	if (b->len + len + 1 > b->size) {
+		size_t newsize = (b->size)? b->size * 2: 4096;
+		while (b->len + len + 1 > newsize)
+			newsize *= 2;
+		char *ptr = (char *) realloc(b->data, newsize);
+		if (!ptr)
+			errExit("realloc");
+		b->data = ptr;
+		b->size = newsize;
+	}
+	memcpy(b->data + b->len, str, len);
+	b->len += len;
+	b->data[b->len] = '\0';
+}
+
+static void buffer_puts(Buffer *b, const char *str) {
+	buffer_add(b, str, strlen(str));
+}
+
+static void strings_add(Strings *s, char *str) {
+	if ((s->cnt & 15) == 0) {
+		char **ptr = (char **) realloc(s->str, (s->cnt + 16) * sizeof(char *));
+		if (!ptr)
+			errExit("realloc");
+		s->str = ptr;
+	}
+	s->str[s->cnt++] = str;
+}
+
+static void strings_clear(Strings *s) {
+	for (int i = 0; i < s->cnt; i++)
+		free(s->str[i]);
+	free(s->str);
+	s->str = NULL;
+	s->cnt = 0;
+}
+
+static void file_add_line(File *f, int type, int lineno, const char *text) {
+	if ((f->nlines & 63) == 0) {
+		Line *ptr = (Line *) realloc(f->lines, (f->nlines + 64) * sizeof(Line));
+		if (!ptr)
+			errExit("realloc");
+		f->lines = ptr;
+	}
+	Line *l = &f->lines[f->nlines++];
+	l->type = type;
+	l->lineno = lineno;
+	l->text = strdup(text);
+	if (!l->text)
+		errExit("strdup");
+}
+
+static void file_add_error(File *f, int lineno, int warning, const char *fmt, ...) {
+	if ((f->nerrors & 15) == 0) {
+		Error *ptr = (Error *) realloc(f->errors, (f->nerrors + 16) * sizeof(Error));
+		if (!ptr)
+			errExit("realloc");
+		f->errors = ptr;
+	}
+	Error *e = &f->errors[f->nerrors++];
+	e->lineno = lineno;
+	e->warning = warning;
+	va_list ap;
+	va_start(ap, fmt);
+	if (vasprintf(&e->msg, fmt, ap) == -1)
+		errExit("vasprintf");
+	va_end(ap);
+}
+
+static void file_clear(File *f) {
+	for (int i = 0; i < f->nlines; i++)
+		free(f->lines[i].text);
+	free(f->lines);
+	f->lines = NULL;
+	f->nlines = 0;
+	for (int i = 0; i < f->nerrors; i++)
+		free(f->errors[i].msg);
+	free(f->errors);
+	f->errors = NULL;
+	f->nerrors = 0;
+}
+
+static File *table_find(const char *path) {
+	File *f = table[hash(path) % HASH_SIZE];
+	while (f) {
+		if (strcmp(f->path, path) == 0)
+			return f;
+		f = f->next;
+	}
+	return NULL;
+}
+
+static File *table_add(const char *path) {
+	File *f = (File *) calloc(1, sizeof(File));
+	if (!f)
+		errExit("calloc");
+	f->path = strdup(path);
+	if (!f->path)
+		errExit("strdup");
+	uint32_t h = hash(path) % HASH_SIZE;
+	f->next = table[h];
+	table[h] = f;
+	return f;
+}
+
+//*************************************************************
+// parser
+//*************************************************************
+static const Directive *find_directive(const char *name, size_t len) {
+	for (int i = 0; directives[i].name; i++) {
+		if (strlen(directives[i].name) == len && strncmp(directives[i].name, name, len) == 0)
+			return &directives[i];
+	}
+	return NULL;
+}
+
+static int check_path(File *f, int lineno, const char *cmd, const char *path) {
+	if (*path != '/' && *path != '~' && strncmp(path, "${", 2) != 0) {
+		file_add_error(f, lineno, 0, "%s: \"%s\" is not an absolute path", cmd, path);
+		return -1;
+	}
+	const char *ptr = strstr(path, "..");
+	if (ptr && (ptr == path || ptr[-1] == '/') && (ptr[2] == '\0' || ptr[2] == '/')) {
+		file_add_error(f, lineno, 0, "%s: \"..\" is not allowed in \"%s\"", cmd, path);
+		return -1;
+	}
+	return 0;
+}
+
+// validate one directive; the line is already trimmed
+static void check_directive(File *f, int lineno, const char *line) {
+	// conditional directive, ?CONDITION: command
+	if (*line == '?') {
+		const char *ptr = strchr(line, ':');
+		if (!ptr || ptr == line + 1) {
+			file_add_error(f, lineno, 0, "invalid conditional \"%s\"", line);
+			return;
+		}
+		ptr++;
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+		if (*ptr == '\0') {
+			file_add_error(f, lineno, 0, "missing command in \"%s\"", line);
+			return;
+		}
+		line = ptr;
+	}
+
+	// command and argument
+	size_t len = strcspn(line, " \t");
+	const char *arg = line + len;
+	while (*arg == ' ' || *arg == '\t')
+		arg++;
+	char cmd[64];
+	snprintf(cmd, sizeof(cmd), "%.*s", (int) ((len < sizeof(cmd))? len: sizeof(cmd) - 1), line);
+
+	// ignore takes any other command as argument
+	if (strcmp(cmd, "ignore") == 0) {
+		if (*arg == '\0')
+			file_add_error(f, lineno, 0, "ignore: missing command");
+		return;
+	}
+
+	const Directive *d = find_directive(line, len);
+	if (!d) {
+		file_add_error(f, lineno, 1, "unknown command \"%s\"", cmd);
+		return;
+	}
+
+	switch (d->arg) {
+	case ARG_NONE:
+		if (*arg)
+			file_add_error(f, lineno, 0, "%s: unexpected argument \"%s\"", cmd, arg);
+		break;
+	case ARG_REQUIRED:
+		if (*arg == '\0')
+			file_add_error(f, lineno, 0, "%s: missing argument", cmd);
+		break;
+	case ARG_PATH:
+		if (*arg == '\0')
+			file_add_error(f, lineno, 0, "%s: missing file name", cmd);
+		else
+			check_path(f, lineno, cmd, arg);
+		break;
+	case ARG_OPTPATH:
+		if (*arg)
+			check_path(f, lineno, cmd, arg);
+		break;
+	default:
+		break;
+	}
+}
+
+// parse a profile or an include file; errors are stored in the file
+static void parse(File *f, char *data) {
+	int lineno = 0;
+	char *line = data;
+	while (line) {
+		char *end = strchr(line, '\n');
+		if (end)
+			*end = '\0';
+		lineno++;
+
+		// trim
+		char *ptr = line;
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+		char *last = ptr + strlen(ptr);
+		while (last > ptr && (last[-1] == ' ' || last[-1] == '\t' || last[-1] == '\r'))
+			last--;
+		*last = '\0';
+
+		if (*ptr == '\0' || *ptr == '#')
+			;
+		else if (strncmp(ptr, "include", 7) == 0 && (ptr[7] == ' ' || ptr[7] == '\t' || ptr[7] == '\0')) {
+			char *name = ptr + 7;
+			while (*name == ' ' || *name == '\t')
+				name++;
+			if (*name == '\0')
+				file_add_error(f, lineno, 0, "include: missing file name");
+			else
+				file_add_line(f, LINE_INCLUDE, lineno, name);
+		}
+		else {
+			check_directive(f, lineno, ptr);
+			file_add_line(f, LINE_DIRECTIVE, lineno, ptr);
+		}
+
+		line = (end)? end + 1: NULL;
+	}
+}
+
+static char *read_file(int fd, size_t size) {
+	char *data = (char *) malloc(size + 1);
+	if (!data)
+		errExit("malloc");
+	size_t len = 0;
+	while (len < size) {
+		ssize_t rv = read(fd, data + len, size - len);
+		if (rv == -1 && errno == EINTR)
+			continue;
+		if (rv <= 0)
+			break;
+		len += rv;
+	}
+	data[len] = '\0';
+	return data;
+}
+
+// return the parsed file, reading it only if it changed since it was cached
+static File *load_file(const char *path) {
+	File *f = table_find(path);
+	if (f && f->checked)
+		return f;
+	if (!f)
+		f = table_add(path);
+	f->checked = 1;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat s;
+	if (fd == -1 || fstat(fd, &s) == -1 || !S_ISREG(s.st_mode)) {
+		if (fd != -1)
+			close(fd);
+		if (f->exists) {
+			file_clear(f);
+			cache_dirty = 1;
+		}
+		f->exists = 0;
+		return f;
+	}
+
+	if (f->exists && f->ino == s.st_ino && f->size == s.st_size &&
+	    f->mtime.tv_sec == s.st_mtim.tv_sec && f->mtime.tv_nsec == s.st_mtim.tv_nsec) {
+		close(fd);
+		return f;
+	}
+
+	if (arg_debug)
+		printf("parsing %s\n", path);
+	file_clear(f);
+	char *data = read_file(fd, s.st_size);
+	close(fd);
+	parse(f, data);
+	free(data);
+	f->exists = 1;
+	f->ino = s.st_ino;
+	f->size = s.st_size;
+	f->mtime = s.st_mtim;
+	cache_dirty = 1;
+	return f;
+}
+
+//*************************************************************
+// cache file
+//*************************************************************
+static char *cache_file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/profile.cache", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+static int read_all(FILE *fp, void *buf, size_t len) {
+	return (fread(buf, len, 1, fp) == 1)? 0: -1;
+}
+
+static char *read_string(FILE *fp) {
+	uint32_t len;
+	if (read_all(fp, &len, sizeof(len)) || len >= 64 * 1024)
+		return NULL;
+	char *str = (char *) malloc(len + 1);
+	if (!str)
+		errExit("malloc");
+	if (read_all(fp, str, len)) {
+		free(str);
+		return NULL;
+	}
+	str[len] = '\0';
+	return str;
+}
+
+static void write_string(FILE *fp, const char *str) {
+	uint32_t len = strlen(str);
+	fwrite(&len, sizeof(len), 1, fp);
+	fwrite(str, len, 1, fp);
+}
+
+// cache file format:
+//	magic
+//	uint64_t hash of the directive table, the cached diagnostics depend on it
+//	for each file:
+//		path, uint64_t ino, int64_t size, int64_t mtime sec, int64_t mtime nsec
+//		uint32_t line count, for each line: uint8_t type, uint32_t lineno, text
+//		uint32_t error count, for each error: uint8_t warning, uint32_t lineno, message
+// strings are stored as uint32_t length followed by the characters
+// a damaged file is ignored from the first bad record on
+// FNV-1a over the directive table
+static uint64_t directives_hash() {
+	uint64_t h = 14695981039346656037ULL;
+	for (int i = 0; directives[i].name; i++) {
+		const unsigned char *ptr = (const unsigned char *) directives[i].name;
+		do
+			h = (h ^ *ptr) * 1099511628211ULL;
+		while (*ptr++);
+		h = (h ^ (unsigned char) directives[i].arg) * 1099511628211ULL;
+	}
+	return h;
+}
+
+static void load_cache() {
+	cache_loaded = 1;
+	char *fname = cache_file_name();
+	if (!fname)
+		return;
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return;
+
+	// the diagnostics stored depend on the directive table
+	char magic[CACHE_MAGIC_LEN];
+	uint64_t table_hash;
+	if (read_all(fp, magic, CACHE_MAGIC_LEN) || memcmp(magic, CACHE_MAGIC, CACHE_MAGIC_LEN) ||
+	    read_all(fp, &table_hash, sizeof(table_hash)) || table_hash != directives_hash()) {
+		fclose(fp);
+		return;
+	}
+
+	char *path;
+	while ((path = read_string(fp)) != NULL) {
+		uint64_t ino;
+		int64_t size;
+		int64_t sec;
+		int64_t nsec;
+		uint32_t nlines;
+		if (table_find(path) ||
+		    read_all(fp, &ino, sizeof(ino)) ||
+		    read_all(fp, &size, sizeof(size)) ||
+		    read_all(fp, &sec, sizeof(sec)) ||
+		    read_all(fp, &nsec, sizeof(nsec)) ||
+		    read_all(fp, &nlines, sizeof(nlines))) {
+			free(path);
+			break;
+		}
+
+		File *f = table_add(path);
+		free(path);
+		f->exists = 1;
+		f->ino = ino;
+		f->size = size;
+		f->mtime.tv_sec = sec;
+		f->mtime.tv_nsec = nsec;
+
+		int ok = 1;
+		for (uint32_t i = 0; i < nlines && ok; i++) {
+			uint8_t type;
+			uint32_t lineno;
+			char *text = NULL;
+			if (read_all(fp, &type, sizeof(type)) || read_all(fp, &lineno, sizeof(lineno)) ||
+			    (text = read_string(fp)) == NULL)
+				ok = 0;
+			else
+				file_add_line(f, type, lineno, text);
+			free(text);
+		}
+
+		uint32_t nerrors;
+		if (ok && read_all(fp, &nerrors, sizeof(nerrors)))
+			ok = 0;
+		for (uint32_t i = 0; ok && i < nerrors; i++) {
+			uint8_t warning;
+			uint32_t lineno;
+			char *msg = NULL;
+			if (read_all(fp, &warning, sizeof(warning)) || read_all(fp, &lineno, sizeof(lineno)) ||
+			    (msg = read_string(fp)) == NULL)
+				ok = 0;
+			else
+				file_add_error(f, lineno, warning, "%s", msg);
+			free(msg);
+		}
+
+		if (!ok) {
+			// the entry is incomplete, force a new parse
+			file_clear(f);
+			f->exists = 0;
+			break;
+		}
+	}
+
+	fclose(fp);
+}
+
+static void save_cache() {
+	char *fname = cache_file_name();
+	if (!fname)
+		return;
+	char *tmpname;
+	FILE *fp = cache_open(fname, &tmpname);
+	if (!fp) {
+		free(fname);
+		return;
+	}
+
+	fwrite(CACHE_MAGIC, CACHE_MAGIC_LEN, 1, fp);
+	uint64_t table_hash = directives_hash();
+	fwrite(&table_hash, sizeof(table_hash), 1, fp);
+	for (int i = 0; i < HASH_SIZE; i++) {
+		for (File *f = table[i]; f; f = f->next) {
+			if (!f->exists)
+				continue;
+			uint64_t ino = f->ino;
+			int64_t size = f->size;
+			int64_t sec = f->mtime.tv_sec;
+			int64_t nsec = f->mtime.tv_nsec;
+			uint32_t nlines = f->nlines;
+			uint32_t nerrors = f->nerrors;
+			write_string(fp, f->path);
+			fwrite(&ino, sizeof(ino), 1, fp);
+			fwrite(&size, sizeof(size), 1, fp);
+			fwrite(&sec, sizeof(sec), 1, fp);
+			fwrite(&nsec, sizeof(nsec), 1, fp);
+			fwrite(&nlines, sizeof(nlines), 1, fp);
+			for (int j = 0; j < f->nlines; j++) {
+				uint8_t type = f->lines[j].type;
+				uint32_t lineno = f->lines[j].lineno;
+				fwrite(&type, sizeof(type), 1, fp);
+				fwrite(&lineno, sizeof(lineno), 1, fp);
+				write_string(fp, f->lines[j].text);
+			}
+			fwrite(&nerrors, sizeof(nerrors), 1, fp);
+			for (int j = 0; j < f->nerrors; j++) {
+				uint8_t warning = f->errors[j].warning;
+				uint32_t lineno = f->errors[j].lineno;
+				fwrite(&warning, sizeof(warning), 1, fp);
+				fwrite(&lineno, sizeof(lineno), 1, fp);
+				write_string(fp, f->errors[j].msg);
+			}
+		}
+	}
+
+	if (cache_close(fp, tmpname, fname) == 0)
+		cache_dirty = 0;
+	free(fname);
+}
+
+//*************************************************************
+// include expansion
+//*************************************************************
+// expansion state, valid only if the file generation is the current one
+#define STATE_ACTIVE	1	// on the include stack
+#define STATE_DONE	2	// already expanded in this profile
+
+// replace ${HOME} and ${CFG} macros; returns allocated memory
+static char *expand_macros(const char *name, const char *home) {
+	Buffer b = { NULL, 0, 0 };
+	const char *ptr = name;
+	while (*ptr) {
+		if (strncmp(ptr, "${HOME}", 7) == 0 && home) {
+			buffer_puts(&b, home);
+			ptr += 7;
+		}
+		else if (strncmp(ptr, "${CFG}", 6) == 0) {
+			buffer_puts(&b, SYSCFG);
+			ptr += 6;
+		}
+		else if (*ptr == '~' && ptr == name && (ptr[1] == '/' || ptr[1] == '\0') && home) {
+			buffer_puts(&b, home);
+			ptr++;
+		}
+		else
+			buffer_add(&b, ptr++, 1);
+	}
+	if (!b.data)
+		buffer_add(&b, "", 0);
+	return b.data;
+}
+
+// resolve an include file name; a name without a directory is searched in
+// ~/.config/firejail first and in /etc/firejail next; returns allocated memory
+static char *resolve_include(const char *name, const char *home) {
+	char *path = expand_macros(name, home);
+	if (strchr(path, '/'))
+		return path;
+
+	char *fname;
+	if (home) {
+		if (asprintf(&fname, "%s/.config/firejail/%s", home, path) == -1)
+			errExit("asprintf");
+		if (access(fname, R_OK) == 0) {
+			free(path);
+			return fname;
+		}
+		free(fname);
+	}
+	if (asprintf(&fname, SYSCFG "/%s", path) == -1)
+		errExit("asprintf");
+	free(path);
+	return fname;
+}
+
+static void add_message(Profile *p, const char *file, const Error *e) {
+	char *msg;
+	if (asprintf(&msg, "%s:%d: %s", file, e->lineno, e->msg) == -1)
+		errExit("asprintf");
+	strings_add((e->warning)? &p->warnings: &p->errors, msg);
+}
+
+static void add_error(Profile *p, const char *file, int lineno, const char *fmt, const char *arg) {
+	Error e;
+	e.lineno = lineno;
+	e.warning = 0;
+	if (asprintf(&e.msg, fmt, arg) == -1)
+		errExit("asprintf");
+	add_message(p, file, &e);
+	free(e.msg);
+}
+
+static void expand(Profile *p, File *f, const char *home) {
+	f->state = STATE_ACTIVE;
+	f->generation = generation;
+	for (int i = 0; i < f->nerrors; i++)
+		add_message(p, f->path, &f->errors[i]);
+
+	for (int i = 0; i < f->nlines; i++) {
+		const Line *l = &f->lines[i];
+		if (l->type == LINE_DIRECTIVE) {
+			buffer_puts(&p->output, l->text);
+			buffer_add(&p->output, "\n", 1);
+			continue;
+		}
+
+		char *path = resolve_include(l->text, home);
+		File *inc = load_file(path);
+		if (!inc->exists) {
+			// missing .local files are normal, they are created by the user
+			size_t len = strlen(path);
+			if (len < 6 || strcmp(path + len - 6, ".local") != 0)
+				add_error(p, f->path, l->lineno, "cannot read include file %s", path);
+		}
+		else if (inc->generation == generation && inc->state == STATE_ACTIVE)
+			add_error(p, f->path, l->lineno, "include cycle through %s", path);
+		else if (inc->generation != generation) {
+			buffer_puts(&p->output, "# include ");
+			buffer_puts(&p->output, path);
+			buffer_add(&p->output, "\n", 1);
+			expand(p, inc, home);
+		}
+		free(path);
+	}
+	f->state = STATE_DONE;
+}
+
+//*************************************************************
+// public interface
+//*************************************************************
+Profile *profile_new() {
+	Profile *p = (Profile *) calloc(1, sizeof(Profile));
+	if (!p)
+		errExit("calloc");
+	return p;
+}
+
+void profile_free(Profile *p) {
+	if (!p)
+		return;
+	free(p->source.data);
+	free(p->output.data);
+	strings_clear(&p->errors);
+	strings_clear(&p->warnings);
+	free(p);
+}
+
+void profile_add(Profile *p, const char *fmt, ...) {
+	char *str;
+	va_list ap;
+	va_start(ap, fmt);
+	if (vasprintf(&str, fmt, ap) == -1)
+		errExit("vasprintf");
+	va_end(ap);
+	buffer_puts(&p->source, str);
+	free(str);
+}
+
+int profile_compile(Profile *p) {
+	if (!cache_loaded)
+		load_cache();
+
+	p->output.len = 0;
+	strings_clear(&p->errors);
+	strings_clear(&p->warnings);
+	generation++;
+
+	// the profile itself is not cached
+	File top;
+	memset(&top, 0, sizeof(top));
+	top.path = (char *) "profile";
+	top.exists = 1;
+	char *data = strdup((p->source.data)? p->source.data: "");
+	if (!data)
+		errExit("strdup");
+	parse(&top, data);
+	free(data);
+
+	char *home = get_home_directory();
+	expand(p, &top, home);
+	free(home);
+	file_clear(&top);
+	if (!p->output.data)
+		buffer_add(&p->output, "", 0);
+
+	// the stamps are verified again on the next compile
+	for (int i = 0; i < HASH_SIZE; i++) {
+		for (File *f = table[i]; f; f = f->next)
+			f->checked = 0;
+	}
+	if (cache_dirty)
+		save_cache();
+
+	if (arg_debug)
+		printf("profile compiled, %d errors, %d warnings\n", p->errors.cnt, p->warnings.cnt);
+	return p->errors.cnt;
+}
+
+int profile_errors(const Profile *p) {
+	return p->errors.cnt;
+}
+
+const char *profile_error(const Profile *p, int index) {
+	return p->errors.str[index];
+}
+
+int profile_warnings(const Profile *p) {
+	return p->warnings.cnt;
+}
+
+const char *profile_warning(const Profile *p, int index) {
+	return p->warnings.str[index];
+}
+
+const char *profile_output(const Profile *p, size_t *len) {
+	if (len)
+		*len = p->output.len;
+	return (p->output.data)? p->output.data: "";
+}
+
+const char *profile_source(const Profile *p) {
+	return (p->source.data)? p->source.data: "";
+}
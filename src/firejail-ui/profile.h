@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <sys/types.h>
+
+// Profile compiler. The profile is built in memory line by line, then compiled: every
+// include is resolved the same way firejail does it (~/.config/firejail first, /etc/firejail
+// next), the include graph is expanded depth-first with cycle detection, and every directive
+// is checked against the list of known profile commands. The result is a flattened profile
+// without include statements; each file is expanded only once, no matter how many times it
+// is included.
+//
+// Parsed include files are kept in memory and saved in ~/.config/firetools/profile.cache
+// together with the inode, size and modification time of each file; unchanged files are
+// not read again, in this program run or in the next one.
+//
+// The functions are not thread-safe, the profile is built from the GUI thread.
+
+typedef struct Profile Profile;
+
+Profile *profile_new();
+void profile_free(Profile *p);
+
+// add one or more lines to the profile, printf style
+void profile_add(Profile *p, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// expand the includes and validate the directives; returns the number of errors
+int profile_compile(Profile *p);
+
+// errors and warnings from the last profile_compile call, as "file:line: message"
+int profile_errors(const Profile *p);
+const char *profile_error(const Profile *p, int index);
+int profile_warnings(const Profile *p);
+const char *profile_warning(const Profile *p, int index);
+
+// the flattened profile, valid after profile_compile
+const char *profile_output(const Profile *p, size_t *len);
+
+// the profile lines as added by profile_add, without expanding the includes
+const char *profile_source(const Profile *p);
+
+#endif
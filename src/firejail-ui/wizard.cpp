@@ -32,7 +32,6 @@
 #include <QLabel>
 #include <QLineEdit>
 #include <QListWidgetItem>
-#include <QProcess>
 #include <QPushButton>
 #include <QFileDialog>
 #include "../../firetools_config_extras.h"
@@ -40,8 +39,16 @@
 #include "home_widget.h"
 #include "help_widget.h"
 #include "appdb.h"
+#include "appsearch.h"
+#include "profile.h"
+#include "launch.h"
+#include "../common/subprocess.h"
 #include <unistd.h>
 
+#define SEARCH_RESULTS 50	// type-ahead search, items in the application list
+#define PROFILE_ERRORS 20	// profile errors shown in the message box
+#define LAUNCH_TIMEOUT 5000	// ms, wait for the sandbox to start
+
 //QString global_title("Firejail Configuration Wizard");
 QString global_title("");
 
@@ -85,28 +92,18 @@ void Wizard::accept() {
 	if (arg_debug)
 		printf("Wizard::accept\n");
 	QStringList arguments;
+	QByteArray profile_file;
 
 	if (field("use_custom").toBool()) {
 		if (arg_debug)
 			printf("building a custom profile\n");
 
-		// build the profile in a termporary file
-		char profname[] = "/tmp/firejail-ui-XXXXXX";
-		int fd = mkstemp(profname);
-		if (fd == -1)
-			errExit("mkstemp");
-		QString profarg = QString("--profile=") + QString(profname);
-		arguments << profarg;
-
-		// always print the profile on stdout
-		printf("\n");
-		printf("############## start of profile file\n");
+		// build the profile in memory
+		Profile *prof = profile_new();
 
 		// include
-		dprintf(fd, "include /etc/firejail/disable-common.inc\n");
-		dprintf(fd, "include /etc/firejail/disable-passwdmgr.inc\n");
-		printf("include /etc/firejail/disable-common.inc\n");
-		printf("include /etc/firejail/disable-passwdmgr.inc\n");
+		profile_add(prof, "include /etc/firejail/disable-common.inc\n");
+		profile_add(prof, "include /etc/firejail/disable-passwdmgr.inc\n");
 
 		// home directory
 		if (field("restricted_home").toBool()) {
@@ -115,23 +112,19 @@ void Wizard::accept() {
 				whitelist = QString("private\n");
 			else
 				whitelist += QString("include /etc/firejail/whitelist-common.inc\n");
-			dprintf(fd, "%s", whitelist.toUtf8().data());
-			printf("%s", whitelist.toUtf8().data());
+			profile_add(prof, "%s", whitelist.toUtf8().data());
 		}
 
 		// filesystem
 		if (field("private_tmp").toBool()) {
-			dprintf(fd, "private-tmp\n");
-			printf("private-tmp\n");
+			profile_add(prof, "private-tmp\n");
 		}
 		if (field("private_dev").toBool()) {
-			dprintf(fd, "private-dev\n");
-			printf("private-dev\n");
+			profile_add(prof, "private-dev\n");
 		}
 		if (field("mnt_media").toBool()) {
-			dprintf(fd, "blacklist /mnt\n");
-			dprintf(fd, "blacklist /media\n");
-			printf("blacklist /mnt\nblacklist /media\n");
+			profile_add(prof, "blacklist /mnt\n");
+			profile_add(prof, "blacklist /media\n");
 		}
 
 		// network
@@ -139,27 +132,21 @@ void Wizard::accept() {
 			;
 		}
 		else if (field("nonetwork").toBool()) {
-			dprintf(fd, "net none\n");
-			printf("net none\n");
+			profile_add(prof, "net none\n");
 		}
 		else if (field("netnamespace").toBool()) {
-			dprintf(fd, "net %s\nnetfilter\n", global_ifname.toUtf8().data());
-			printf("net %s\nnetfilter\n", global_ifname.toUtf8().data());
+			profile_add(prof, "net %s\nnetfilter\n", global_ifname.toUtf8().data());
 		}
 
 		// dns
 		if (global_dns_enabled) {
 			QString dns1 = field("dns1").toString();
 			if (!dns1.isEmpty()) {
-				char *d1 = dns1.toUtf8().data();
-				dprintf(fd, "dns %s\n", d1);
-				printf("dns %s\n", d1);
+				profile_add(prof, "dns %s\n", dns1.toUtf8().data());
 			}
 			QString dns2 = field("dns2").toString();
 			if (!dns2.isEmpty()) {
-				char *d2 = dns2.toUtf8().data();
-				dprintf(fd, "dns %s\n", d2);
-				printf("dns %s\n", d2);
+				profile_add(prof, "dns %s\n", dns2.toUtf8().data());
 			}
 		}
 
@@ -182,56 +169,88 @@ void Wizard::accept() {
 				if (field("protocol_packet").toBool())
 					protocol += QString("packet");
 
-				char *str = protocol.toUtf8().data();
-				dprintf(fd, "%s\n", str);
-				printf("%s\n", str);
+				profile_add(prof, "%s\n", protocol.toUtf8().data());
 			}
 		}
 
 		// multimedia
 		if (field("nosound").toBool()) {
-			dprintf(fd, "nosound\n");
-			printf("nosound\n");
+			profile_add(prof, "nosound\n");
 		}
 		if (field("no3d").toBool()) {
-			dprintf(fd, "no3d\n");
-			printf("no3d\n");
+			profile_add(prof, "no3d\n");
 		}
 		if (field("nox11").toBool()) {
-			dprintf(fd, "x11 none\n");
-			printf("x11 none\n");
+			profile_add(prof, "x11 none\n");
 		}
 		if (field("nodvd").toBool()) {
-			dprintf(fd, "nodvd\n");
-			printf("nodvd\n");
+			profile_add(prof, "nodvd\n");
 		}
 		if (field("novideo").toBool()) {
-			dprintf(fd, "novideo\n");
-			printf("novideo\n");
+			profile_add(prof, "novideo\n");
 		}
 		if (field("notv").toBool()) {
-			dprintf(fd, "notv\n");
-			printf("notv\n");
+			profile_add(prof, "notv\n");
 		}
 
 
 		// kernel
 		if (field("seccomp").toBool()) {
-			dprintf(fd, "seccomp\n");
-			dprintf(fd, "nonewprivs\n");
-			printf("seccomp\nnonewprivs\n");
+			profile_add(prof, "seccomp\n");
+			profile_add(prof, "nonewprivs\n");
 		}
 		if (field("caps").toBool()) {
-			dprintf(fd, "caps.drop all\n");
-			printf("caps.drop all\n");
+			profile_add(prof, "caps.drop all\n");
 		}
 		if (field("noroot").toBool()) {
-			dprintf(fd, "noroot\n");
-			printf("noroot\n");
+			profile_add(prof, "noroot\n");
 		}
 
+		// always print the profile on stdout
+		printf("\n");
+		printf("############## start of profile file\n");
+		printf("%s", profile_source(prof));
 		printf("############# end of profile file\n");
 		printf("\n");
+
+		// expand the includes and check the directives before starting the sandbox
+		profile_compile(prof);
+		for (int i = 0; i < profile_warnings(prof); i++)
+			fprintf(stderr, "Warning: %s\n", profile_warning(prof, i));
+		if (profile_errors(prof)) {
+			// the directive table could be older than the firejail version installed,
+			// the user can still start the sandbox and let firejail decide
+			QString msg = tr("Problems found in the security profile:\n\n");
+			for (int i = 0; i < profile_errors(prof); i++) {
+				fprintf(stderr, "Error: %s\n", profile_error(prof, i));
+				if (i < PROFILE_ERRORS)
+					msg += QString(profile_error(prof, i)) + "\n";
+			}
+			QMessageBox box(QMessageBox::Warning, tr("Firejail Configuration Wizard"), msg,
+				QMessageBox::Cancel, this);
+			QPushButton *launch = box.addButton(tr("Launch anyway"), QMessageBox::AcceptRole);
+			box.setDefaultButton(QMessageBox::Cancel);
+			box.exec();
+			if (box.clickedButton() != launch) {
+				profile_free(prof);
+				return;
+			}
+		}
+
+		// the flattened profile goes in a temporary file
+		char profname[] = "/tmp/firejail-ui-XXXXXX";
+		int fd = mkstemp(profname);
+		if (fd == -1)
+			errExit("mkstemp");
+		size_t len;
+		const char *out = profile_output(prof, &len);
+		if (write(fd, out, len) != (ssize_t) len)
+			errExit("write");
+		close(fd);
+		profile_free(prof);
+		profile_file = QByteArray(profname);
+		QString profarg = QString("--profile=") + QString(profname);
+		arguments << profarg;
 	}
 
 	// debug
@@ -245,15 +264,38 @@ void Wizard::accept() {
 	QStringList cmds = cmd.split( " " );
 	arguments += cmds;
 
-	// start a new process,
-	QProcess *process = new QProcess();
-	process->startDetached(QString("firejail"), arguments);
-	sleep(1);
-	printf("Sandbox started, exiting firejail-ui...\n");
+	// start firejail and wait for the sandbox to come up
+	QList<QByteArray> args;
+	args.append(QByteArray("firejail"));
+	for (int i = 0; i < arguments.size(); i++)
+		args.append(arguments.at(i).toLocal8Bit());
+	QVector<char *> argv;
+	for (int i = 0; i < args.size(); i++)
+		argv.append(args[i].data());
+	argv.append(NULL);
+
+	QApplication::setOverrideCursor(Qt::WaitCursor);
+	char *err;
+	pid_t pid = launch_sandbox(argv.data(), LAUNCH_TIMEOUT, &err);
+	QApplication::restoreOverrideCursor();
+	if (pid == -1) {
+		if (!profile_file.isEmpty())
+			unlink(profile_file.constData());
+		QString msg = tr("Cannot start the sandbox:\n\n") + QString::fromLocal8Bit((err)? err: "unknown error");
+		free(err);
+		QMessageBox::warning(this, tr("Firejail Configuration Wizard"), msg);
+		return;
+	}
+	printf("Sandbox %d started, exiting firejail-ui...\n", pid);
 
 	if (field("mon").toBool()) {
-		int rv = system(PACKAGE_LIBDIR "/fstats &");
-		(void) rv;
+		char *pidarg;
+		if (asprintf(&pidarg, "--pid=%d", pid) == -1)
+			errExit("asprintf");
+		char *fstats[] = { (char *) PACKAGE_LIBDIR "/fstats", pidarg, NULL };
+		if (subprocess_spawn(fstats, NULL) == -1)
+			fprintf(stderr, "Error: cannot start fstats\n");
+		free(pidarg);
 	}
 
 	// force a program exit
@@ -298,12 +340,18 @@ ApplicationPage::ApplicationPage(QWidget *parent): QWizardPage(parent) {
 	app_->setFont(oldFont);
 //	app_->setStyleSheet("QListWidget { color : black; }");
 	app_->setMinimumWidth(300);
+	search_ = new QLineEdit;
+	search_->setFont(oldFont);
+	search_->setPlaceholderText(tr("Search applications"));
+	search_->setClearButtonEnabled(true);
+	search_->setEnabled(false);
 	app_box_layout->addWidget(label1, 0, 0, 1, 2);
-	app_box_layout->addWidget(group_, 1, 0);
-	app_box_layout->addWidget(app_, 1, 1);
-	app_box_layout->addWidget(browse_, 2, 0);
-	app_box_layout->addWidget(label2, 2, 1);
-	app_box_layout->addWidget(command_, 3, 0, 1, 2);
+	app_box_layout->addWidget(search_, 1, 0, 1, 2);
+	app_box_layout->addWidget(group_, 2, 0);
+	app_box_layout->addWidget(app_, 2, 1);
+	app_box_layout->addWidget(browse_, 3, 0);
+	app_box_layout->addWidget(label2, 3, 1);
+	app_box_layout->addWidget(command_, 4, 0, 1, 2);
 	app_box->setLayout(app_box_layout);
 
 	QGroupBox *profile_box = new QGroupBox(tr("Step 2: Choose a security profile"));
@@ -326,11 +374,19 @@ ApplicationPage::ApplicationPage(QWidget *parent): QWizardPage(parent) {
 	layout->addWidget(profile_box, 1, 0);
 	setLayout(layout);
 
-	// load database
-	appdb_ = appdb_load_file();
+	// load database; the applications show up as their executables are found
+	appdb_ = new AppCatalog(this);
+	appdb_->load();
 	if (arg_debug)
-		appdb_print_list(appdb_);
-	appdb_load_group(appdb_, group_);
+		appdb_->print();
+	connect(appdb_, SIGNAL(appAvailable(int)), this, SLOT(appAvailable(int)));
+	appdb_->probe();
+
+	// type-ahead search, enabled when the index is built
+	index_ = new AppSearch(appdb_, this);
+	connect(index_, SIGNAL(indexReady()), this, SLOT(indexReady()));
+	connect(search_, SIGNAL(textChanged(const QString &)), this, SLOT(searchChanged(const QString &)));
+	index_->start(QThread::LowPriority);
 
 	// connect widgets
 	connect(group_, SIGNAL(itemClicked(QListWidgetItem*)),
@@ -392,17 +448,83 @@ void ApplicationPage::groupClicked(QListWidgetItem *item) {
 		printf("ApplicationPage::groupClicked %s\n", group.toLatin1().data());
 
 
-	appdb_load_app(appdb_, app_, group);
+	app_->clear();
+	QList<const AppEntry *> apps = appdb_->apps(group);
+	for (int i = 0; i < apps.size(); i++)
+		new QListWidgetItem(apps.at(i)->app_, app_);
 	app_->repaint();
 }
 
+void ApplicationPage::indexReady() {
+	search_->setEnabled(true);
+}
+
+// list the best matches; with an empty search box the group browsing is back
+void ApplicationPage::searchChanged(const QString &text) {
+	if (text.trimmed().isEmpty()) {
+		group_->setEnabled(true);
+		if (group_->currentItem())
+			groupClicked(group_->currentItem());
+		else
+			app_->clear();
+		return;
+	}
+
+	group_->setEnabled(false);
+	app_->clear();
+	QList<int> docs = index_->query(text, SEARCH_RESULTS);
+	for (int i = 0; i < docs.size(); i++) {
+		const AppSearch::Doc &doc = index_->doc(docs.at(i));
+		// catalog entries are listed only if the program is installed
+		if (doc.catalog != -1 && !appdb_->entry(doc.catalog).available_)
+			continue;
+		QListWidgetItem *item = new QListWidgetItem(doc.name, app_);
+		item->setData(Qt::UserRole, doc.command);
+	}
+}
+
+// an application was found: add its category if not there yet, in file order, and add the
+// application to the list if the category is selected
+void ApplicationPage::appAvailable(int index) {
+	const AppEntry &entry = appdb_->entry(index);
+	int row = 0;
+	for (; row < group_->count(); row++) {
+		QListWidgetItem *item = group_->item(row);
+		int group_index = item->data(Qt::UserRole).toInt();
+		if (group_index == entry.group_index_)
+			break;
+		if (group_index > entry.group_index_) {
+			item = new QListWidgetItem(entry.group_);
+			item->setData(Qt::UserRole, entry.group_index_);
+			group_->insertItem(row, item);
+			return;
+		}
+	}
+	if (row == group_->count()) {
+		QListWidgetItem *item = new QListWidgetItem(entry.group_, group_);
+		item->setData(Qt::UserRole, entry.group_index_);
+		return;
+	}
+
+	if (search_->text().trimmed().isEmpty() && group_->currentItem() && group_->currentItem()->text() == entry.group_)
+		new QListWidgetItem(entry.app_, app_);
+}
+
 void ApplicationPage::appClicked(QListWidgetItem *item) {
 	QString app = item->text();
 	if (arg_debug)
 		printf("ApplicationPage::appClicked %s\n", app.toLatin1().data());
 
+	// search results carry the command, desktop files are not in the catalog
+	QVariant command = item->data(Qt::UserRole);
+	if (command.isValid()) {
+		command_->setText(command.toString());
+		return;
+	}
 
-	appdb_set_command(appdb_, command_, app);
+	const AppEntry *entry = appdb_->find(app);
+	if (entry)
+		command_->setText(entry->command_);
 }
 
 int ApplicationPage::nextId() const {
@@ -598,6 +720,9 @@ void ConfigPage::setProtocol(bool on) {
 
 void ConfigPage::setHome(bool active) {
 	home_->setEnabled(active);
+	// show how much every directory would expose
+	if (active)
+		home_->estimateSizes();
 }
 
 int ConfigPage::nextId() const {
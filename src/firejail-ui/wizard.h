@@ -31,7 +31,8 @@ class QPushButton;
 class HomeWidget;
 class QListWidget;
 class QListWidgetItem;
-struct AppEntry;
+class AppCatalog;
+class AppSearch;
 
 class Wizard : public QWizard {
 	Q_OBJECT
@@ -62,9 +63,14 @@ private slots:
 	void groupClicked(QListWidgetItem*);
 	void appClicked(QListWidgetItem*);
 	void browseClicked();
+	void appAvailable(int index);
+	void indexReady();
+	void searchChanged(const QString &text);
 
 private:
-	AppEntry *appdb_;
+	AppCatalog *appdb_;
+	AppSearch *index_;
+	QLineEdit *search_;
 	QListWidget *app_;
 	QListWidget *group_;
 	QLineEdit *command_;
@@ -20,61 +20,69 @@
 #include <stdio.h>
 #include <string.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "firetools.h"
 #include "applications.h"
 #include "../common/utils.h"
+#include "../common/pathdb.h"
+#include "frecency.h"
+#include <algorithm>
+#include <QByteArray>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
 #include "../../firetools_config_extras.h"
-#include <QDirIterator>
-#include <QPainter>
 QList<Application> applist;
 
 Application::Application(const char *name, const char *description, const char *exec, const char *icon):
-	name_(name), description_(description), exec_(exec), icon_(icon) {
-
-	app_icon_ = loadIcon(icon_);
+	name_(name), description_(description), icon_(icon) {
+	setExec(exec);
 };
 
 Application::Application(QString name, QString description, QString exec, QString icon):
-	name_(name), description_(description), exec_(exec), icon_(icon) {
-
-	app_icon_ = loadIcon(icon_);
+	name_(name), description_(description), icon_(icon) {
+	setExec(exec);
 };
 
 // Load an application from a desktop file
 Application::Application(const char *name):
 	name_(name), description_("unknown"), exec_("unknown"), icon_("unknown") {
 
-	// retrieve desktop file
-	if (!have_config_file(name))
-		return;
-	char *fname = get_config_file_name(name);
-	if (!fname)
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
 		return;
+	load(cfgdir);
+	free(cfgdir);
+}
+
+// Parse the desktop file in cfgdir; safe to call from worker threads
+void Application::load(const char *cfgdir) {
+	char *fname;
+	if (asprintf(&fname, "%s/%s.desktop", cfgdir, name_.toLocal8Bit().constData()) == -1)
+		errExit("asprintf");
 
 	if (arg_debug)
 		printf("loading %s\n", fname);
 
 	// open file
 	FILE *fp = fopen(fname, "r");
-	if (!fp) {
-		free(fname);
-		return;
-	}
 	free(fname);
+	if (!fp)
+		return;
 
 	// read file
-#define MAXBUF 10000
-	char buf[MAXBUF];
-	while (fgets(buf, MAXBUF, fp)) {
+	char *buf = NULL;
+	size_t size = 0;
+	ssize_t len;
+	while ((len = getline(&buf, &size, fp)) != -1) {
 		// remove '\n'
-		char *ptr = strchr(buf, '\n');
-		if (ptr)
-			*ptr = '\0';
-
-		// skip blancs
-		char *start = buf;
-		while (*start == ' ' || *start == '\t')
-			start++;
+		if (len > 0 && buf[len - 1] == '\n')
+			buf[len - 1] = '\0';
 
 		// parse
 		if (strncmp(buf, "Comment=", 8) == 0)
@@ -84,9 +92,119 @@ Application::Application(const char *name):
 		else if (strncmp(buf, "Icon=", 5) == 0)
 				icon_ = buf + 5;
 	}
+	free(buf);
 	fclose(fp);
+	setExec(exec_);
+}
 
-	app_icon_ = loadIcon(icon_);
+void Application::setExec(QString exec) {
+	exec_ = exec;
+	argv_.clear();
+	error_.clear();
+	if (!applications_split_exec(exec_.toLocal8Bit(), &argv_, &error_)) {
+		argv_.clear();
+		return;
+	}
+
+	// the program is resolved once, a missing executable is reported at launch
+	const char *prog = argv_.first().constData();
+	if (strchr(prog, '/') ? access(prog, X_OK) != 0: !pathdb_find_any(prog)) {
+		error_ = QString("program ") + argv_.first() + " not found";
+		argv_.clear();
+	}
+}
+
+// Split an Exec= value following the desktop entry specification. The string escapes
+// (\s, \n, \t, \r, \\) are applied first; the arguments are separated by spaces, and a
+// double-quoted argument can contain spaces, with \", \`, \$ and \\ escaped by a backslash.
+// The field codes are dropped, the launcher has no files or URLs to pass; %% is a literal %.
+bool applications_split_exec(const QByteArray &exec, QList<QByteArray> *argv, QString *error) {
+	// string escapes
+	QByteArray str;
+	for (int i = 0; i < exec.size(); i++) {
+		char c = exec.at(i);
+		if (c == '\\' && i + 1 < exec.size()) {
+			char next = exec.at(i + 1);
+			if (next == 's')
+				c = ' ';
+			else if (next == 'n')
+				c = '\n';
+			else if (next == 't')
+				c = '\t';
+			else if (next == 'r')
+				c = '\r';
+			else if (next == '\\')
+				c = '\\';
+			else {
+				str.append(c);
+				continue;
+			}
+			i++;
+		}
+		str.append(c);
+	}
+
+	argv->clear();
+	QByteArray arg;
+	bool in_arg = false;
+	bool quoted = false;
+	bool field_code = false;	// the argument is only a field code
+	for (int i = 0; i < str.size(); i++) {
+		char c = str.at(i);
+		if (quoted) {
+			if (c == '"')
+				quoted = false;
+			else if (c == '\\' && i + 1 < str.size() && strchr("\"`$\\", str.at(i + 1)))
+				arg.append(str.at(++i));
+			else
+				arg.append(c);
+			continue;
+		}
+
+		if (c == ' ' || c == '\t' || c == '\n') {
+			if (in_arg && !(field_code && arg.isEmpty()))
+				argv->append(arg);
+			arg.clear();
+			in_arg = false;
+			field_code = false;
+			continue;
+		}
+
+		if (!in_arg)
+			field_code = true;
+		in_arg = true;
+		if (c == '"') {
+			quoted = true;
+			field_code = false;
+		}
+		else if (c == '%' && i + 1 < str.size()) {
+			char code = str.at(++i);
+			if (code == '%') {
+				arg.append('%');
+				field_code = false;
+			}
+			else if (!strchr("fFuUdDnNickvm", code)) {
+				*error = QString("invalid field code %") + code;
+				return false;
+			}
+		}
+		else {
+			arg.append(c);
+			field_code = false;
+		}
+	}
+
+	if (quoted) {
+		*error = QString("unterminated quote");
+		return false;
+	}
+	if (in_arg && !(field_code && arg.isEmpty()))
+		argv->append(arg);
+	if (argv->isEmpty()) {
+		*error = QString("empty command");
+		return false;
+	}
+	return true;
 }
 
 // Save the app's configuration
@@ -113,216 +231,6 @@ int Application::saveConfig() {
 	return 0;
 }
 
-/*
-From: http://standards.freedesktop.org/icon-theme-spec/icon-theme-spec-latest.html
-
-Icons and themes are looked for in a set of directories. By default, apps should look
-in $HOME/.icons (for backwards compatibility), in $XDG_DATA_DIRS/icons and in /
-usr/share/pixmaps (in that order). Applications may further add their own icon
-directories to this list, and users may extend or change the list (in application/desktop
-specific ways).In each of these directories themes are stored as subdirectories.
-A theme can be spread across several base directories by having subdirectories of
-the same name. This way users can extend and override system themes.
-
-In order to have a place for third party applications to install their icons there
-should always exist a theme called "hicolor" [1]. The data for the hicolor theme is
-available for download at: http://www.freedesktop.org/software/icon-theme/. I
-mplementations are required to look in the "hicolor" theme if an icon was not found
-in the current theme.
-*/
-
-// compare strings
-static inline bool compare_ignore_case(QString q1, QString q2) {
-	q1 = q1.toLower();
-	q2 = q2.toLower();
-	return q1 == q2;
-}
-
-static QString walk(QString path, QString name) {
-	QDirIterator it(path, QDirIterator::Subdirectories);
-	while (it.hasNext()) {
-		it.next();
-		QFileInfo fi = it.fileInfo();
-		if (fi.isFile() && compare_ignore_case(fi.baseName(), name)) {
-			if (arg_debug)
-				printf("\t- %s\n", fi.canonicalFilePath().toUtf8().data());
-			return fi.canonicalFilePath();
-		}
-	}
-	return QString("");
-}
-
-static QIcon resize48x48(QIcon icon) {
-	QSize sz = icon.actualSize(QSize(64, 64));
-	if (arg_debug)
-		printf("\t- input pixmap: w %d, h %d\n", sz.width(), sz.height());
-
-	QPixmap pix = icon.pixmap(sz.height(), sz.width());
-	QPixmap pixin;
-	int delta = 0;
-
-	if (sz.height() ==  sz.width() && sz.height() <= 40) {
-		pixin = pix.scaled(40, 40);
-		delta = 12;
-	}
-	else {
-		pixin = pix.scaled(48, 48);
-		delta = 8;
-	}
-
-
-	QPixmap pixout(64, 64);
-	pixout.fill(QColor(0, 0, 0, 0));
-	QPainter *paint = new QPainter(&pixout);
-	paint->drawPixmap(delta, delta, pixin);
-	if (arg_debug)
-		printf("\t- output pixmap: w %d, h %d\n", pixout.width(), pixout.height());
-	paint->end();
-	return QIcon(pixout);
-}
-
-QIcon Application::loadIcon(QString name) {
-	if (arg_debug)
-		printf("searching icon %s\n", name.toLocal8Bit().data());
-
-	if (name == ":resources/fstats" || name == ":resources/firejail-ui") {
-		if (arg_debug)
-			printf("\t- resource\n");
-		return QIcon(name); // not resized, using the real 64x64 size
-	}
-
-	if (name.startsWith(":resources")) {
-		if (arg_debug)
-			printf("\t- resource\n");
-		return resize48x48(QIcon(name));
-	}
-
-	if (name.startsWith('/')) {
-		if (arg_debug)
-			printf("\t- full path\n");
-		return resize48x48(QIcon(name));
-	}
-
-
-
-	// Look for the file in Firejail config directory under /home/user
-	QString conf = QDir::homePath() + "/.config/firetools/" + name + ".png";
-	QFileInfo checkFile1(conf);
-	if (checkFile1.exists() && checkFile1.isFile()) {
-		if (arg_debug)
-			printf("\t- local config dir, png file\n");
-		return QIcon(conf);
-	}
-	conf = QDir::homePath() + "/.config/firetools/" + name + ".jpg";
-	QFileInfo checkFile2(conf);
-	if (checkFile2.exists() && checkFile2.isFile()) {
-		if (arg_debug)
-			printf("\t- local config dir, jpg file\n");
-		return QIcon(conf);
-	}
-
-	if (!svg_not_found) {
-		conf = QDir::homePath() + "/.config/firetools/" + name + ".svg";
-		QFileInfo checkFile3(conf);
-		if (checkFile3.exists() && checkFile3.isFile()) {
-			if (arg_debug)
-				printf("\t- local config dir, svg file\n");
-			return QIcon(conf);
-		}
-	}
-
-	{
-		QString qstr = walk("/usr/share/icons/hicolor/48x48", name);
-		if (!qstr.isEmpty()) {
-			return resize48x48(QIcon(qstr));
-		}
-	}
-
-	{
-		QString qstr = walk("/usr/share/icons/hicolor/64x64", name);
-		if (!qstr.isEmpty())
-			return resize48x48(QIcon(qstr));
-	}
-
-	{
-		QString qstr = walk("/usr/share/icons/hicolor/128x128", name);
-		if (!qstr.isEmpty())
-			return resize48x48(QIcon(qstr));
-	}
-
-	{
-		QString qstr = walk("/usr/share/icons/hicolor/256x256", name);
-		if (!qstr.isEmpty())
-			return resize48x48(QIcon(qstr));
-	}
-
-	{
-		QDirIterator it("/usr/share/pixmaps", QDirIterator::Subdirectories);
-		while (it.hasNext()) {
-			it.next();
-			QFileInfo fi = it.fileInfo();
-			if (fi.isFile() && compare_ignore_case(fi.baseName(), name)) {
-				if (arg_debug)
-					printf("\t- /usr/share/pixmaps\n");
-				QIcon icon = QIcon(fi.canonicalFilePath());
-				return resize48x48(icon);
-			}
-		}
-	}
-
-	if (QIcon::hasThemeIcon(name)) {
-		if (arg_debug)
-			printf("\t- fromTheme\n");
-		return resize48x48(QIcon::fromTheme(name));
-	}
-
-	if (!svg_not_found) {
-		QString qstr = walk("/usr/share/icons/hicolor/scalable", name);
-		if (!qstr.isEmpty())
-			return resize48x48(QIcon(qstr));
-	}
-
-
-	// we failed to get an icon so far, look all over /usr/share/icons directory
-	{
-		QString qstr = walk("/usr/share/icons", name);
-		if (!qstr.isEmpty())
-			return resize48x48(QIcon(qstr));
-	}
-
-
-	// Create a new icon
-	if (arg_debug)
-		printf("\t- created\n");
-
-	// Create a new QPixmap instance for icons
-	QPixmap pix(64, 64);
-
-	// Set the background color for generated icons
-	QColor iconBackgroundColor(68, 68, 68);
-
-	// Fill the icon with a color
-	pix.fill(iconBackgroundColor);
-
-
-	// Create a QPainter instance
-	QPainter painter( &pix );
-
-	// Set color and font for the painter
-	painter.setPen(Qt::white);
-	painter.setFont(QFont("Sans"));
-
-	// Draw application's name to the icon
-	painter.drawText(3, 20, name);
-	painter.end();
-
-	// Use generated pixmap as an icon
-	QIcon icon(pix);
-
-	return icon;
-}
-
-
 // Default application configurations for the app launcher
 struct DefaultApp {
 	const char *name;
@@ -468,13 +376,259 @@ void applist_print() {
 }
 
 
+// Desktop file found in ~/.config/firetools
+struct DesktopFile {
+	QByteArray name;	// file name without .desktop extension
+	int64_t sec;		// modification time
+	int64_t nsec;
+	int64_t size;
+};
+
+// scan the config directory; the files are returned in directory order
+static QVector<DesktopFile> scan_desktop_files(const char *cfgdir) {
+	QVector<DesktopFile> files;
+	DIR *dir = opendir(cfgdir);
+	if (!dir)
+		return files;
+
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		// look only at .desktop files
+		int len = strlen(entry->d_name);
+		if (len <= 8 || strcmp(entry->d_name + len - 8, ".desktop") != 0)
+			continue;
+
+		struct stat s;
+		if (fstatat(dirfd(dir), entry->d_name, &s, 0) == -1 || !S_ISREG(s.st_mode))
+			continue;
+
+		DesktopFile file;
+		file.name = QByteArray(entry->d_name, len - 8);
+		file.sec = s.st_mtim.tv_sec;
+		file.nsec = s.st_mtim.tv_nsec;
+		file.size = s.st_size;
+		files.append(file);
+	}
+	closedir(dir);
+	return files;
+}
+
+// thread pool task parsing one desktop file
+class DesktopLoader: public QRunnable {
+public:
+	DesktopLoader(Application *app, const char *cfgdir): app_(app), cfgdir_(cfgdir) {}
+	void run() {
+		app_->load(cfgdir_);
+	}
+
+private:
+	Application *app_;
+	const char *cfgdir_;
+};
+
+// Launcher cache, ~/.config/firetools/applications.cache. The file is mapped in memory,
+// all the integers are in host byte order and the strings are offsets in the string pool:
+//	CacheHeader
+//	CacheFile[nfiles]	desktop files the list was built from, in directory order
+//	CacheApp[napps]		resolved application list
+//	string pool, '\0' terminated strings
+// The cache is valid as long as the desktop files, the $PATH directories and the default
+// application table are unchanged.
+#define CACHE_MAGIC "FTAPPS01"
+
+struct CacheHeader {
+	char magic[8];
+	uint32_t nfiles;
+	uint32_t napps;
+	uint64_t stamp;		// pathdb_stamp() and default application table
+	uint32_t poolsize;
+	uint32_t unused;
+};
+
+struct CacheFile {
+	uint32_t name;
+	uint32_t unused;
+	int64_t sec;
+	int64_t nsec;
+	int64_t size;
+};
+
+struct CacheApp {
+	uint32_t name;
+	uint32_t description;
+	uint32_t exec;
+	uint32_t icon;
+};
+
+// FNV-1a over the default application table, a new firetools version invalidates the cache
+static uint64_t default_apps_hash() {
+	uint64_t h = 14695981039346656037ULL;
+	DefaultApp *app = &dapps[0];
+	while (app->name != 0) {
+		const char *str[5] = { app->name, app->alias, app->description, app->command, app->icon };
+		for (int i = 0; i < 5; i++) {
+			const unsigned char *ptr = (const unsigned char *) str[i];
+			do
+				h = (h ^ *ptr) * 1099511628211ULL;
+			while (*ptr++);
+		}
+		app++;
+	}
+	return h;
+}
+
+static char *cache_file_name(const char *cfgdir) {
+	char *fname;
+	if (asprintf(&fname, "%s/applications.cache", cfgdir) == -1)
+		errExit("asprintf");
+	return fname;
+}
+
+// returns true if the application list was loaded from the cache
+static bool load_cache(const char *cfgdir, const QVector<DesktopFile> &files, uint64_t stamp) {
+	char *fname = cache_file_name(cfgdir);
+	int fd = open(fname, O_RDONLY | O_CLOEXEC);
+	free(fname);
+	if (fd == -1)
+		return false;
+	struct stat s;
+	if (fstat(fd, &s) == -1 || s.st_size < (off_t) sizeof(CacheHeader)) {
+		close(fd);
+		return false;
+	}
+	size_t len = s.st_size;
+	void *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return false;
+
+	bool rv = false;
+	const CacheHeader *hdr = (const CacheHeader *) map;
+	const CacheFile *cfiles;
+	const CacheApp *capps;
+	const char *pool;
+
+	// the sizes in the header are checked against the file length before any pointer is computed
+	if (memcmp(hdr->magic, CACHE_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    hdr->stamp != stamp ||
+	    hdr->nfiles != (uint32_t) files.size() ||
+	    hdr->poolsize == 0 ||
+	    sizeof(CacheHeader) + (uint64_t) hdr->nfiles * sizeof(CacheFile) +
+	    (uint64_t) hdr->napps * sizeof(CacheApp) + hdr->poolsize != len)
+		goto doexit;
+	cfiles = (const CacheFile *) (hdr + 1);
+	capps = (const CacheApp *) (cfiles + hdr->nfiles);
+	pool = (const char *) (capps + hdr->napps);
+	if (pool[hdr->poolsize - 1] != '\0')
+		goto doexit;
+
+#define CACHE_STR(off) (((off) < hdr->poolsize)? pool + (off): NULL)
+	for (uint32_t i = 0; i < hdr->nfiles; i++) {
+		const char *name = CACHE_STR(cfiles[i].name);
+		if (!name || files[i].name != name || files[i].sec != cfiles[i].sec ||
+		    files[i].nsec != cfiles[i].nsec || files[i].size != cfiles[i].size)
+			goto doexit;
+	}
+
+	for (uint32_t i = 0; i < hdr->napps; i++) {
+		const char *name = CACHE_STR(capps[i].name);
+		const char *description = CACHE_STR(capps[i].description);
+		const char *exec = CACHE_STR(capps[i].exec);
+		const char *icon = CACHE_STR(capps[i].icon);
+		if (!name || !description || !exec || !icon) {
+			applist.clear();
+			goto doexit;
+		}
+		applist.append(Application(name, description, exec, icon));
+	}
+#undef CACHE_STR
+	rv = true;
+
+doexit:
+	munmap(map, len);
+	return rv;
+}
+
+static uint32_t pool_add(QByteArray *pool, const QByteArray &str) {
+	uint32_t offset = pool->size();
+	pool->append(str);
+	pool->append('\0');
+	return offset;
+}
+
+static void save_cache(const char *cfgdir, const QVector<DesktopFile> &files, uint64_t stamp) {
+	QByteArray pool;
+	QVector<CacheFile> cfiles(files.size());
+	QVector<CacheApp> capps(applist.size());
+	for (int i = 0; i < files.size(); i++) {
+		memset(&cfiles[i], 0, sizeof(CacheFile));
+		cfiles[i].name = pool_add(&pool, files[i].name);
+		cfiles[i].sec = files[i].sec;
+		cfiles[i].nsec = files[i].nsec;
+		cfiles[i].size = files[i].size;
+	}
+	for (int i = 0; i < applist.size(); i++) {
+		capps[i].name = pool_add(&pool, applist[i].name_.toLocal8Bit());
+		capps[i].description = pool_add(&pool, applist[i].description_.toLocal8Bit());
+		capps[i].exec = pool_add(&pool, applist[i].exec_.toLocal8Bit());
+		capps[i].icon = pool_add(&pool, applist[i].icon_.toLocal8Bit());
+	}
+	if (pool.isEmpty())
+		pool.append('\0');
+
+	CacheHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CACHE_MAGIC, sizeof(hdr.magic));
+	hdr.nfiles = cfiles.size();
+	hdr.napps = capps.size();
+	hdr.stamp = stamp;
+	hdr.poolsize = pool.size();
+
+	char *fname = cache_file_name(cfgdir);
+	char *tmpname;
+	FILE *fp = cache_open(fname, &tmpname);
+	if (!fp) {
+		free(fname);
+		return;
+	}
+
+	bool ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+		(cfiles.isEmpty() || fwrite(cfiles.constData(), sizeof(CacheFile), cfiles.size(), fp) == (size_t) cfiles.size()) &&
+		(capps.isEmpty() || fwrite(capps.constData(), sizeof(CacheApp), capps.size(), fp) == (size_t) capps.size()) &&
+		fwrite(pool.constData(), pool.size(), 1, fp) == 1;
+	cache_close(fp, tmpname, fname, ok);
+	free(fname);
+}
+
 void applications_init() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return;
+	QVector<DesktopFile> files = scan_desktop_files(cfgdir);
+	uint64_t stamp = pathdb_stamp() ^ default_apps_hash();
+
+	if (load_cache(cfgdir, files, stamp)) {
+		if (arg_debug)
+			printf("%d applications loaded from cache\n", applist.size());
+		free(cfgdir);
+		return;
+	}
+
+	QSet<QByteArray> user_files;
+	for (int i = 0; i < files.size(); i++)
+		user_files.insert(files[i].name);
+
+	// applications loaded from desktop files, parsed in parallel below
+	QVector<int> pending;
+
 	// load default apps
 	if (arg_debug)
 		printf("Loading default applications\n");
 
+	QSet<QByteArray> default_names;
 	DefaultApp *app = &dapps[0];
 	while (app->name != 0) {
+		default_names.insert(app->name);
 		if (arg_debug)
 			printf("checking %s\n", app->name);
 
@@ -491,78 +645,80 @@ void applications_init() {
 		}
 
 		// is there a user config file?
-		if (have_config_file(app->name))
-			applist.append(Application(app->name));
+		if (user_files.contains(app->name)) {
+			pending.append(applist.size());
+			applist.append(Application(app->name, "unknown", "unknown", "unknown"));
+		}
 		else
 			applist.append(Application(app->name, app->description, app->command, app->icon));
 
 		app++;
 	}
 
-	// load user apps from home directory
-	char *home = get_home_directory();
-	if (!home)
-		return;
-	char *homecfg;
-	if (asprintf(&homecfg, "%s/.config/firetools", home) == -1)
-		errExit("asprintf");
-	free(home);
-	DIR *dir = opendir(homecfg);
-	if (!dir) {
-		free(homecfg);
-		return;
+	// load user apps from home directory, skipping the apps in default list
+	for (int i = 0; i < files.size(); i++) {
+		if (default_names.contains(files[i].name))
+			continue;
+		pending.append(applist.size());
+		applist.append(Application(files[i].name.constData(), "unknown", "unknown", "unknown"));
 	}
 
-	// walk home config directory
-	struct dirent *entry;
-	while ((entry = readdir(dir))) {
-		if (strcmp(entry->d_name, ".") == 0)
-			continue;
-		if (strcmp(entry->d_name, "..") == 0)
-			continue;
+	// parse the desktop files; applist is not resized until all the tasks are done
+	QThreadPool pool;
+	for (int i = 0; i < pending.size(); i++) {
+		DesktopLoader *loader = new DesktopLoader(&applist[pending[i]], cfgdir);
+		pool.start(loader);
+	}
+	pool.waitForDone();
 
-		// look only at .desktop files
-		int len = strlen(entry->d_name);
-		if (len <= 8)
-			continue;
-		char *fname = strdup(entry->d_name);
-		if (!fname)
-			errExit("strdup");
-		char *ending = fname + len - 8;
-		if (strcmp(ending, ".desktop") != 0) {
-			free(fname);
-			continue;
-		}
+	save_cache(cfgdir, files, stamp);
+	free(cfgdir);
+}
 
-		// check if the app is in default list
-		fflush(0);
-		*ending = '\0';
-		DefaultApp *app = &dapps[0];
-		bool found = false;
-		while (app->name != 0) {
-			if (strcmp(fname, app->name) == 0) {
-				found = true;
-			}
 
-			app++;
-		}
-		if (found) {
-			free(fname);
-			continue;
-		}
+// Order the launcher by the frecency score, most used applications first; the applications
+// never launched keep their order at the end. Not called while the window is on the screen,
+// the icons do not move under the mouse.
+struct SortKey {
+	double score;
+	int index;
+};
 
-		// load file
-		applist.append(Application(fname));
-		free(fname);
-	}
+static bool sort_key_less(const SortKey &a, const SortKey &b) {
+	return a.score > b.score;
+}
 
-	free(homecfg);
-	closedir(dir);
+void applications_sort() {
+	QVector<SortKey> keys(applist.size());
+	for (int i = 0; i < applist.size(); i++) {
+		keys[i].score = frecency_score(applist[i].name_);
+		keys[i].index = i;
+	}
+	std::stable_sort(keys.begin(), keys.end(), sort_key_less);
+
+	QList<Application> sorted;
+	for (int i = 0; i < keys.size(); i++)
+		sorted.append(applist[keys[i].index]);
+	applist = sorted;
+
+	if (arg_debug) {
+		printf("Applications sorted by usage:\n");
+		for (int i = 0; i < keys.size(); i++)
+			printf("\t%s %.3f%s\n", applist[i].name_.toLocal8Bit().constData(), keys[i].score,
+				(i >= applications_visible())? " (hidden)": "");
+	}
 }
 
+// number of applications in the grid, --max-apps caps it to the most used ones
+int applications_visible() {
+	int nelem = applist.count();
+	if (arg_max_apps > 0 && arg_max_apps < nelem)
+		return arg_max_apps;
+	return nelem;
+}
 
 int applications_get_index(QPoint pos) {
-	int nelem = applist.count();
+	int nelem = applications_visible();
 	int cols = nelem / ROWS + 1;
 
 	if (pos.y() < (MARGIN * 2 + TOP))
@@ -580,7 +736,7 @@ int applications_get_index(QPoint pos) {
 }
 
 int applications_get_position(QPoint pos) {
-	int nelem = applist.count();
+	int nelem = applications_visible();
 	int cols = nelem / ROWS + 1;
 
 	if (pos.y() < (MARGIN * 2 + TOP))
@@ -19,9 +19,9 @@
 */
 #ifndef APPLICATIONS_H
 #define APPLICATIONS_H
+#include <QByteArray>
 #include <QList>
 #include <QString>
-#include <QIcon>
 
 #define TOP 10
 #define MARGIN 2
@@ -35,23 +35,29 @@ struct Application {
 	QString description_;
 	QString exec_;
 	QString icon_;
-	QIcon app_icon_;
-	
+	QList<QByteArray> argv_;	// exec_ split in arguments, empty if exec_ is not valid
+	QString error_;			// the reason argv_ is empty
+
 	Application(const char *name, const char *description, const char *exec, const char *icon);
 	Application(QString name, QString description, QString exec, QString icon);
 	Application(const char *name);
-	
-	QIcon loadIcon(QString name);
+
+	void load(const char *cfgdir);
 	int saveConfig();
+	// set exec_ and split it in arguments
+	void setExec(QString exec);
 };
 
 extern QList<Application> applist;
 void applications_init();
+void applications_sort();
+int applications_visible();
 int applications_get_index(QPoint pos);
 int applications_get_position(QPoint pos);
 bool applications_check_default(const char *name);
 bool applist_check(QString name);
 void applications_print();
 void applist_print();
+bool applications_split_exec(const QByteArray &exec, QList<QByteArray> *argv, QString *error);
 
 #endif
\ No newline at end of file
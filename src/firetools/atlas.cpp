@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include "firetools.h"
+#include "atlas.h"
+#include "../common/utils.h"
+#include <QIcon>
+#include <QImage>
+#include <QPainter>
+
+// cache file format (host byte order):
+//	magic, int32 entries, int64 icon source stamp
+//	for each entry: uint16 name length, name, uint16 icon length, icon,
+//		int32 width, int32 height, width * height * 4 bytes ARGB32 premultiplied
+// only the full size icons are stored, the other animation sizes are scaled down on load
+#define ATLAS_MAGIC "FTATLAS1"
+#define ATLAS_MAXSIZE 256
+
+IconAtlas::IconAtlas(): capacity_(0), next_(0), stamp_(0) {}
+
+int IconAtlas::bandOffset(int band) const {
+	int lines = capacity_ / SLOTS_PER_LINE;
+	int offset = 0;
+	for (int i = 0; i < band; i++)
+		offset += lines * bandSize(i);
+	return offset;
+}
+
+QRect IconAtlas::cellRect(int slot, int band) const {
+	int s = bandSize(band);
+	return QRect((slot % SLOTS_PER_LINE) * s, bandOffset(band) + (slot / SLOTS_PER_LINE) * s, s, s);
+}
+
+void IconAtlas::grow(int capacity) {
+	capacity = ((capacity + SLOTS_PER_LINE - 1) / SLOTS_PER_LINE) * SLOTS_PER_LINE;
+	if (capacity <= capacity_)
+		return;
+
+	int lines = capacity / SLOTS_PER_LINE;
+	int height = 0;
+	for (int i = 0; i < BANDS; i++)
+		height += lines * bandSize(i);
+	QPixmap pix(SLOTS_PER_LINE * bandSize(0), height);
+	pix.fill(Qt::transparent);
+
+	// the band offsets depend on the number of lines, copy the cells one by one
+	IconAtlas old = *this;
+	capacity_ = capacity;
+	if (!old.pixmap_.isNull()) {
+		QPainter painter(&pix);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		for (int slot = 0; slot < old.next_; slot++) {
+			for (int band = 0; band < BANDS; band++)
+				painter.drawPixmap(cellRect(slot, band).topLeft(), old.pixmap_, old.cellRect(slot, band));
+		}
+	}
+	pixmap_ = pix;
+	sizes_.resize(capacity_ * BANDS);
+}
+
+void IconAtlas::rasterize(int slot, const QIcon &icon) {
+	QPainter painter(&pixmap_);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	for (int band = 0; band < BANDS; band++) {
+		QRect cell = cellRect(slot, band);
+		painter.fillRect(cell, Qt::transparent);
+
+		// same pixmap the launcher used to request from the icon on every paint
+		QPixmap pix = icon.pixmap(cell.size(), QIcon::Normal, QIcon::On);
+		QSize size = pix.size().boundedTo(cell.size());
+		painter.drawPixmap(cell.topLeft(), pix, QRect(QPoint(0, 0), size));
+		sizes_[slot * BANDS + band] = size;
+	}
+}
+
+void IconAtlas::insert(QString name, QIcon icon) {
+	int slot;
+	QHash<QString, int>::const_iterator it = slots_.constFind(name);
+	if (it != slots_.constEnd())
+		slot = it.value();
+	else if (!free_.isEmpty())
+		slot = free_.takeFirst();
+	else {
+		if (next_ == capacity_)
+			grow(capacity_ + SLOTS_PER_LINE);
+		slot = next_++;
+	}
+
+	rasterize(slot, icon);
+	slots_.insert(name, slot);
+}
+
+void IconAtlas::remove(QString name) {
+	QHash<QString, int>::iterator it = slots_.find(name);
+	if (it == slots_.end())
+		return;
+	free_.append(it.value());
+	slots_.erase(it);
+}
+
+void IconAtlas::rename(QString oldname, QString newname) {
+	if (oldname == newname || !slots_.contains(oldname))
+		return;
+	remove(newname);
+	slots_.insert(newname, slots_.take(oldname));
+}
+
+void IconAtlas::reset(long long stamp) {
+	slots_.clear();
+	free_.clear();
+	for (int i = 0; i < next_; i++)
+		free_.append(i);
+	stamp_ = stamp;
+}
+
+bool IconAtlas::draw(QPainter *painter, QString name, int sz, QPoint target) const {
+	QHash<QString, int>::const_iterator it = slots_.constFind(name);
+	if (it == slots_.constEnd())
+		return false;
+
+	int band = (bandSize(0) - sz) / 3;
+	if (band < 0)
+		band = 0;
+	else if (band >= BANDS)
+		band = BANDS - 1;
+	int slot = it.value();
+	QRect cell = cellRect(slot, band);
+	painter->drawPixmap(target, pixmap_, QRect(cell.topLeft(), sizes_[slot * BANDS + band]));
+	return true;
+}
+
+static char *atlas_file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/atlas.cache", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+static bool read_string(FILE *fp, QString *str) {
+	uint16_t len;
+	if (fread(&len, sizeof(len), 1, fp) != 1)
+		return false;
+	QByteArray data(len, '\0');
+	if (len && fread(data.data(), len, 1, fp) != 1)
+		return false;
+	*str = QString::fromUtf8(data);
+	return true;
+}
+
+static bool write_string(FILE *fp, QString str) {
+	QByteArray data = str.toUtf8();
+	uint16_t len = (uint16_t) data.size();
+	if (fwrite(&len, sizeof(len), 1, fp) != 1)
+		return false;
+	return len == 0 || fwrite(data.constData(), len, 1, fp) == 1;
+}
+
+bool IconAtlas::load(const QList<Application> &apps) {
+	char *fname = atlas_file_name();
+	if (!fname)
+		return false;
+	FILE *fp = fopen(fname, "r");
+	free(fname);
+	if (!fp)
+		return false;
+
+	char magic[sizeof(ATLAS_MAGIC) - 1];
+	int32_t entries;
+	int64_t stamp;
+	if (fread(magic, sizeof(magic), 1, fp) != 1 || memcmp(magic, ATLAS_MAGIC, sizeof(magic)) != 0 ||
+	    fread(&entries, sizeof(entries), 1, fp) != 1 || fread(&stamp, sizeof(stamp), 1, fp) != 1 ||
+	    entries < 0) {
+		fclose(fp);
+		return false;
+	}
+	stamp_ = stamp;
+
+	for (int i = 0; i < entries; i++) {
+		QString name;
+		QString icon;
+		int32_t w;
+		int32_t h;
+		if (!read_string(fp, &name) || !read_string(fp, &icon) ||
+		    fread(&w, sizeof(w), 1, fp) != 1 || fread(&h, sizeof(h), 1, fp) != 1 ||
+		    w < 0 || h < 0 || w > ATLAS_MAXSIZE || h > ATLAS_MAXSIZE)
+			break;
+
+		QImage image;
+		if (w && h)
+			image = QImage(w, h, QImage::Format_ARGB32_Premultiplied);
+		bool ok = true;
+		for (int y = 0; y < h && ok; y++)
+			ok = fread(image.scanLine(y), w * 4, 1, fp) == 1;
+		if (!ok)
+			break;
+
+		// skip the icons no longer in use or changed since the atlas was saved
+		QList<Application>::const_iterator it;
+		for (it = apps.constBegin(); it != apps.constEnd(); ++it) {
+			if (it->name_ == name && it->icon_ == icon) {
+				insert(name, (image.isNull())? QIcon(): QIcon(QPixmap::fromImage(image)));
+				break;
+			}
+		}
+	}
+	fclose(fp);
+
+	if (arg_debug)
+		printf("icon atlas: %d icons loaded\n", slots_.size());
+
+	QList<Application>::const_iterator it;
+	for (it = apps.constBegin(); it != apps.constEnd(); ++it) {
+		if (!slots_.contains(it->name_))
+			return false;
+	}
+	return true;
+}
+
+void IconAtlas::save(const QList<Application> &apps) {
+	char *fname = atlas_file_name();
+	if (!fname)
+		return;
+	char *tmpname;
+	FILE *fp = cache_open(fname, &tmpname);
+	if (!fp) {
+		free(fname);
+		return;
+	}
+
+	int32_t entries = 0;
+	QList<Application>::const_iterator it;
+	for (it = apps.constBegin(); it != apps.constEnd(); ++it) {
+		if (slots_.contains(it->name_))
+			entries++;
+	}
+	int64_t stamp = stamp_;
+	bool ok = fwrite(ATLAS_MAGIC, sizeof(ATLAS_MAGIC) - 1, 1, fp) == 1 &&
+		fwrite(&entries, sizeof(entries), 1, fp) == 1 &&
+		fwrite(&stamp, sizeof(stamp), 1, fp) == 1;
+
+	for (it = apps.constBegin(); it != apps.constEnd() && ok; ++it) {
+		QHash<QString, int>::const_iterator sit = slots_.constFind(it->name_);
+		if (sit == slots_.constEnd())
+			continue;
+		int slot = sit.value();
+		QSize size = sizes_[slot * BANDS];
+		QImage image;
+		if (!size.isEmpty())
+			image = pixmap_.copy(QRect(cellRect(slot, 0).topLeft(), size)).toImage()
+				.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+		int32_t w = image.width();
+		int32_t h = image.height();
+		ok = write_string(fp, it->name_) && write_string(fp, it->icon_) &&
+			fwrite(&w, sizeof(w), 1, fp) == 1 && fwrite(&h, sizeof(h), 1, fp) == 1;
+		for (int y = 0; y < h && ok; y++)
+			ok = fwrite(image.constScanLine(y), w * 4, 1, fp) == 1;
+	}
+
+	cache_close(fp, tmpname, fname, ok);
+	free(fname);
+
+	if (arg_debug)
+		printf("icon atlas: %d icons saved\n", entries);
+}
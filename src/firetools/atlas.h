@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef ATLAS_H
+#define ATLAS_H
+#include <QHash>
+#include <QIcon>
+#include <QList>
+#include <QPixmap>
+#include <QVector>
+#include "applications.h"
+
+class QPainter;
+
+// All launcher icons rasterized in a single pixmap, once for every animation frame size
+// (64, 61, ... 64 - AFRAMES * 3). Painting an icon is a drawPixmap blit from the atlas.
+// The full size icons are saved uncompressed in ~/.config/firetools/atlas.cache, a cold
+// start with a valid cache doesn't decode any icon file.
+class IconAtlas {
+public:
+	IconAtlas();
+
+	// load the atlas from disk; returns true if all the applications were found
+	bool load(const QList<Application> &apps);
+	// save the atlas to disk
+	void save(const QList<Application> &apps);
+	// icon stamp the atlas was built with, see icon_source_stamp()
+	long long stamp() const {
+		return stamp_;
+	}
+	// drop all the icons
+	void reset(long long stamp);
+
+	void insert(QString name, QIcon icon);
+	void remove(QString name);
+	void rename(QString oldname, QString newname);
+	bool contains(QString name) const {
+		return slots_.contains(name);
+	}
+
+	// draw the icon with the top left corner in target; sz is one of the animation sizes;
+	// returns false if the icon is not in the atlas
+	bool draw(QPainter *painter, QString name, int sz, QPoint target) const;
+
+private:
+	enum {
+		SLOTS_PER_LINE = 16,
+		BANDS = AFRAMES + 1
+	};
+	static int bandSize(int band) {
+		return 64 - band * 3;
+	}
+	int bandOffset(int band) const;
+	QRect cellRect(int slot, int band) const;
+	void grow(int capacity);
+	void rasterize(int slot, const QIcon &icon);
+
+	QPixmap pixmap_;
+	QHash<QString, int> slots_;	// application name -> slot
+	QList<int> free_;		// free slots
+	QVector<QSize> sizes_;		// icon size in each slot, BANDS entries per slot
+	int capacity_;			// number of slots, multiple of SLOTS_PER_LINE
+	int next_;			// first slot never used
+	long long stamp_;		// icon_source_stamp() when the atlas was built
+};
+
+#endif
@@ -29,6 +29,8 @@ typedef enum {
 	
 
 extern int arg_debug;
+extern int arg_profile;
+extern int arg_max_apps;
 extern int svg_not_found;
 
 #endif
\ No newline at end of file
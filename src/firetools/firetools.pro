@@ -2,13 +2,23 @@ QMAKE_CXXFLAGS += $$(CXXFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -
 QMAKE_CFLAGS += $$(CFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -pie -Wformat -Wformat-security
 QMAKE_LFLAGS += $$(LDFLAGS) -Wl,-z,relro -Wl,-z,now
 QT += widgets
- HEADERS       = mainwindow.h ../common/utils.h ../common/common.h applications.h \
-		  firetools.h edit_dialog.h
+ HEADERS       = mainwindow.h ../common/utils.h ../common/pathdb.h ../common/subprocess.h ../common/common.h applications.h \
+		  firetools.h edit_dialog.h icons.h atlas.h launcher.h \
+		  profiler.h latencydialog.h pool.h frecency.h
  SOURCES       = mainwindow.cpp \
                  main.cpp \
                  edit_dialog.cpp \
                   ../common/utils.cpp \
+                  ../common/pathdb.cpp \
+                  ../common/subprocess.cpp \
                   ../common/pid.cpp \
-                  applications.cpp
+                  applications.cpp \
+                  icons.cpp \
+                  atlas.cpp \
+                  launcher.cpp \
+                  profiler.cpp \
+                  latencydialog.cpp \
+                  pool.cpp \
+                  frecency.cpp
 RESOURCES = firetools.qrc
 TARGET=../../build/firetools
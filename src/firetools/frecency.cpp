@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "firetools.h"
+#include "frecency.h"
+#include "../common/utils.h"
+#include <math.h>
+#include <time.h>
+#include <QHash>
+
+#define FRECENCY_HALFLIFE (7 * 24 * 3600)	// seconds
+
+struct Entry {
+	double score;		// at the time of the last launch
+	long long last;
+	unsigned count;
+};
+
+static QHash<QString, Entry> entries;
+static bool initialized = false;
+
+static char *file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/frecency", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+static double decay(const Entry &entry, long long now) {
+	long long age = now - entry.last;
+	if (age <= 0)
+		return entry.score;
+	return entry.score * exp2(-(double) age / FRECENCY_HALFLIFE);
+}
+
+void frecency_init() {
+	if (initialized)
+		return;
+	initialized = true;
+
+	char *fname = file_name();
+	if (!fname)
+		return;
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return;
+
+	char *buf = NULL;
+	size_t size = 0;
+	while (getline(&buf, &size, fp) != -1) {
+		char *ptr = strchr(buf, '\n');
+		if (ptr)
+			*ptr = '\0';
+		Entry entry;
+		long long score;
+		int offset;
+		if (sscanf(buf, "%lld %lld %u %n", &score, &entry.last, &entry.count, &offset) != 3 ||
+		    buf[offset] == '\0' || score < 0)
+			continue;
+		entry.score = score / 1000.0;
+		entries.insert(QString::fromLocal8Bit(buf + offset), entry);
+	}
+	free(buf);
+	fclose(fp);
+
+	if (arg_debug)
+		printf("launch statistics loaded for %d applications\n", entries.size());
+}
+
+// the file is replaced atomically, a crash never leaves a truncated file
+static void save() {
+	char *fname = file_name();
+	if (!fname)
+		return;
+	char *tmpname;
+	FILE *fp = cache_open(fname, &tmpname);
+	if (!fp) {
+		free(fname);
+		return;
+	}
+
+	QHash<QString, Entry>::const_iterator it;
+	for (it = entries.begin(); it != entries.end(); ++it)
+		fprintf(fp, "%lld %lld %u %s\n", llround(it->score * 1000), it->last, it->count,
+			it.key().toLocal8Bit().constData());
+	cache_close(fp, tmpname, fname);
+	free(fname);
+}
+
+void frecency_record(const QString &name) {
+	frecency_init();
+	long long now = time(NULL);
+	QHash<QString, Entry>::iterator it = entries.find(name);
+	if (it == entries.end()) {
+		Entry entry;
+		entry.score = 0;
+		entry.last = now;
+		entry.count = 0;
+		it = entries.insert(name, entry);
+	}
+	it->score = decay(*it, now) + 1;
+	it->last = now;
+	it->count++;
+	save();
+}
+
+void frecency_rename(const QString &oldname, const QString &newname) {
+	frecency_init();
+	if (oldname == newname || !entries.contains(oldname))
+		return;
+	entries.insert(newname, entries.take(oldname));
+	save();
+}
+
+void frecency_remove(const QString &name) {
+	frecency_init();
+	if (entries.remove(name))
+		save();
+}
+
+double frecency_score(const QString &name) {
+	frecency_init();
+	QHash<QString, Entry>::const_iterator it = entries.find(name);
+	if (it == entries.end())
+		return 0;
+	return decay(*it, time(NULL));
+}
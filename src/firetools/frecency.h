@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef FRECENCY_H
+#define FRECENCY_H
+#include <QString>
+
+// Launch statistics, ~/.config/firetools/frecency. Every application launched from the
+// launcher gets a score combining the number of launches and their recency: each launch
+// adds 1 and the score halves every FRECENCY_HALFLIFE seconds. The file is a text file,
+// one application per line, the score in thousandths so the file does not depend on the locale:
+//	score last-launch-time launch-count name
+
+// load the statistics; called automatically by the functions below
+void frecency_init();
+
+// an application was launched; the file is updated
+void frecency_record(const QString &name);
+
+// the application was renamed or removed in the launcher
+void frecency_rename(const QString &oldname, const QString &newname);
+void frecency_remove(const QString &name);
+
+// current score, 0 if the application was never launched
+double frecency_score(const QString &name);
+
+#endif
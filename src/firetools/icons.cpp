@@ -0,0 +1,495 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "firetools.h"
+#include "icons.h"
+#include "../common/utils.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QImageReader>
+#include <QList>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QPixmap>
+#include <QStringList>
+
+/*
+From: http://standards.freedesktop.org/icon-theme-spec/icon-theme-spec-latest.html
+
+Icons and themes are looked for in a set of directories. By default, apps should look
+in $HOME/.icons (for backwards compatibility), in $XDG_DATA_DIRS/icons and in /
+usr/share/pixmaps (in that order). Applications may further add their own icon
+directories to this list, and users may extend or change the list (in application/desktop
+specific ways).In each of these directories themes are stored as subdirectories.
+A theme can be spread across several base directories by having subdirectories of
+the same name. This way users can extend and override system themes.
+
+In order to have a place for third party applications to install their icons there
+should always exist a theme called "hicolor" [1]. The data for the hicolor theme is
+available for download at: http://www.freedesktop.org/software/icon-theme/. I
+mplementations are required to look in the "hicolor" theme if an icon was not found
+in the current theme.
+*/
+
+#define INDEX_MAGIC "# firetools icon index 1"
+
+struct IconEntry {
+	QString path;
+	int rank;
+};
+
+struct IconDir {
+	QByteArray path;
+	struct timespec mtime;
+};
+
+static QMutex index_mutex;
+static bool index_ready = false;
+static QHash<QString, IconEntry> index;	// lowercase base name -> best file
+static QList<IconDir> index_dirs;	// all directories walked, used to validate the stored index
+
+// directories with a rank of their own; all their subdirectories inherit the rank
+static int dir_rank(const char *path) {
+	if (strcmp(path, "/usr/share/icons/hicolor/48x48") == 0)
+		return ICON_RANK_48;
+	if (strcmp(path, "/usr/share/icons/hicolor/64x64") == 0)
+		return ICON_RANK_64;
+	if (strcmp(path, "/usr/share/icons/hicolor/128x128") == 0)
+		return ICON_RANK_128;
+	if (strcmp(path, "/usr/share/icons/hicolor/256x256") == 0)
+		return ICON_RANK_256;
+	if (strcmp(path, "/usr/share/icons/hicolor/scalable") == 0)
+		return (svg_not_found)? ICON_RANK_OTHER: ICON_RANK_SCALABLE;
+	return -1;
+}
+
+static void index_add(QString key, QString path, int rank) {
+	QHash<QString, IconEntry>::iterator it = index.find(key);
+	if (it != index.end() && it->rank <= rank)
+		return;
+	IconEntry entry;
+	entry.path = path;
+	entry.rank = rank;
+	index.insert(key, entry);
+}
+
+static void index_add_file(const char *name, const char *path, int rank) {
+	QString fname = QString::fromLocal8Bit(name).toLower();
+	QString qpath = QString::fromLocal8Bit(path);
+
+	// index both the complete base name (org.gnome.Evince.png -> org.gnome.evince)
+	// and the base name (org.gnome.Evince.png -> org)
+	int last = fname.lastIndexOf('.');
+	int first = fname.indexOf('.');
+	if (last > 0)
+		index_add(fname.left(last), qpath, rank);
+	if (first > 0 && first != last)
+		index_add(fname.left(first), qpath, rank);
+	if (first == -1)
+		index_add(fname, qpath, rank);
+}
+
+static void walk(const char *dirpath, int rank) {
+	DIR *dir = opendir(dirpath);
+	if (!dir)
+		return;
+
+	struct stat s;
+	if (fstat(dirfd(dir), &s) == 0) {
+		IconDir d;
+		d.path = QByteArray(dirpath);
+		d.mtime = s.st_mtim;
+		index_dirs.append(d);
+	}
+
+	struct dirent *entry;
+	while ((entry = readdir(dir))) {
+		if (*entry->d_name == '.')
+			continue;
+
+		char *path;
+		if (asprintf(&path, "%s/%s", dirpath, entry->d_name) == -1)
+			errExit("asprintf");
+
+		// symbolic links to files are accepted, symbolic links to directories are not followed
+		unsigned char type = entry->d_type;
+		if (type == DT_LNK || type == DT_UNKNOWN) {
+			if (stat(path, &s) == -1)
+				type = DT_UNKNOWN;
+			else if (S_ISREG(s.st_mode))
+				type = DT_REG;
+			else if (S_ISDIR(s.st_mode) && type == DT_UNKNOWN)
+				type = DT_DIR;
+			else
+				type = DT_UNKNOWN;
+		}
+
+		if (type == DT_DIR) {
+			int r = dir_rank(path);
+			walk(path, (r == -1)? rank: r);
+		}
+		else if (type == DT_REG)
+			index_add_file(entry->d_name, path, rank);
+		free(path);
+	}
+	closedir(dir);
+}
+
+static char *index_file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/icons.index", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+// index file format:
+//	magic svg <0|1>
+//	D <mtime sec> <mtime nsec> <directory>
+//	I <rank> <key>\t<path>
+// returns 0 if the index was loaded and all the directories are unchanged
+static int load_index() {
+	char *fname = index_file_name();
+	if (!fname)
+		return 1;
+	FILE *fp = fopen(fname, "r");
+	free(fname);
+	if (!fp)
+		return 1;
+
+	char *buf = NULL;
+	size_t size = 0;
+	ssize_t len;
+	int rv = 1;
+
+	// header
+	char *magic;
+	if (asprintf(&magic, "%s svg %d\n", INDEX_MAGIC, (svg_not_found)? 0: 1) == -1)
+		errExit("asprintf");
+	len = getline(&buf, &size, fp);
+	if (len == -1 || strcmp(buf, magic) != 0)
+		goto doexit;
+
+	while ((len = getline(&buf, &size, fp)) != -1) {
+		if (len > 0 && buf[len - 1] == '\n')
+			buf[len - 1] = '\0';
+
+		if (*buf == 'D') {
+			long long sec;
+			long nsec;
+			int pos;
+			if (sscanf(buf, "D %lld %ld %n", &sec, &nsec, &pos) != 2)
+				goto doexit;
+			struct stat s;
+			if (stat(buf + pos, &s) == -1 || s.st_mtim.tv_sec != sec || s.st_mtim.tv_nsec != nsec) {
+				if (arg_debug)
+					printf("icon index: %s changed\n", buf + pos);
+				goto doexit;
+			}
+		}
+		else if (*buf == 'I') {
+			int rank;
+			int pos;
+			if (sscanf(buf, "I %d %n", &rank, &pos) != 1)
+				goto doexit;
+			char *key = buf + pos;
+			char *path = strchr(key, '\t');
+			if (!path)
+				goto doexit;
+			*path++ = '\0';
+			IconEntry entry;
+			entry.path = QString::fromLocal8Bit(path);
+			entry.rank = rank;
+			index.insert(QString::fromLocal8Bit(key), entry);
+		}
+	}
+	rv = 0;
+
+doexit:
+	free(magic);
+	free(buf);
+	fclose(fp);
+	return rv;
+}
+
+static void save_index() {
+	char *fname = index_file_name();
+	if (!fname)
+		return;
+	char *tmpname;
+	FILE *fp = cache_open(fname, &tmpname);
+	if (!fp) {
+		free(fname);
+		return;
+	}
+
+	fprintf(fp, "%s svg %d\n", INDEX_MAGIC, (svg_not_found)? 0: 1);
+	QList<IconDir>::const_iterator dit;
+	for (dit = index_dirs.constBegin(); dit != index_dirs.constEnd(); ++dit)
+		fprintf(fp, "D %lld %ld %s\n", (long long) dit->mtime.tv_sec, (long) dit->mtime.tv_nsec, dit->path.constData());
+	QHash<QString, IconEntry>::const_iterator it;
+	for (it = index.constBegin(); it != index.constEnd(); ++it)
+		fprintf(fp, "I %d %s\t%s\n", it->rank, it.key().toLocal8Bit().constData(),
+			it->path.toLocal8Bit().constData());
+
+	cache_close(fp, tmpname, fname);
+	free(fname);
+}
+
+void icon_index_build() {
+	QMutexLocker locker(&index_mutex);
+	if (index_ready)
+		return;
+
+	if (load_index() == 0) {
+		if (arg_debug)
+			printf("icon index: %d icons loaded\n", index.size());
+	}
+	else {
+		index.clear();
+		index_dirs.clear();
+		walk("/usr/share/icons", ICON_RANK_OTHER);
+		walk("/usr/share/pixmaps", ICON_RANK_PIXMAPS);
+		save_index();
+		if (arg_debug)
+			printf("icon index: %d icons, %d directories indexed\n", index.size(), index_dirs.size());
+	}
+	index_ready = true;
+}
+
+int icon_index_lookup(QString name, QString *path) {
+	assert(path);
+	icon_index_build();
+
+	// the index is not modified once it's ready
+	QHash<QString, IconEntry>::const_iterator it = index.constFind(name.toLower());
+	if (it == index.constEnd())
+		return ICON_RANK_NONE;
+	*path = it->path;
+	return it->rank;
+}
+
+long long icon_index_stamp() {
+	char *fname = index_file_name();
+	if (!fname)
+		return 0;
+	struct stat s;
+	long long rv = 0;
+	if (stat(fname, &s) == 0)
+		rv = (long long) s.st_mtim.tv_sec * 1000000000LL + s.st_mtim.tv_nsec;
+	free(fname);
+	return rv;
+}
+
+static uint64_t stamp_add(uint64_t h, const void *data, size_t len) {
+	const unsigned char *ptr = (const unsigned char *) data;
+	for (size_t i = 0; i < len; i++)
+		h = (h ^ ptr[i]) * 1099511628211ULL;
+	return h;
+}
+
+static uint64_t stamp_add_path(uint64_t h, const QString &path) {
+	QByteArray fname = path.toLocal8Bit();
+	h = stamp_add(h, fname.constData(), fname.size() + 1);
+	struct stat s;
+	if (stat(fname.constData(), &s) == 0) {
+		h = stamp_add(h, &s.st_mtim, sizeof(s.st_mtim));
+		h = stamp_add(h, &s.st_size, sizeof(s.st_size));
+	}
+	return h;
+}
+
+static bool user_icon_file(const char *name) {
+	const char *ext = strrchr(name, '.');
+	return ext && (strcmp(ext, ".png") == 0 || strcmp(ext, ".jpg") == 0 || strcmp(ext, ".svg") == 0);
+}
+
+long long icon_source_stamp() {
+	// FNV-1a
+	uint64_t h = 14695981039346656037ULL;
+	long long index_stamp = icon_index_stamp();
+	h = stamp_add(h, &index_stamp, sizeof(index_stamp));
+
+	// theme icons are resolved by Qt in the theme search paths (~/.icons, ~/.local/share/icons...)
+	QByteArray theme = QIcon::themeName().toUtf8();
+	h = stamp_add(h, theme.constData(), theme.size() + 1);
+	QStringList paths = QIcon::themeSearchPaths();
+	for (int i = 0; i < paths.size(); i++) {
+		h = stamp_add_path(h, paths.at(i));
+		if (!theme.isEmpty())
+			h = stamp_add_path(h, paths.at(i) + "/" + QIcon::themeName());
+	}
+
+	// user icons; the directory itself changes every time a cache file is written
+	QString cfgdir = QDir::homePath() + "/.config/firetools";
+	DIR *dir = opendir(cfgdir.toLocal8Bit().constData());
+	if (dir) {
+		QStringList files;
+		struct dirent *entry;
+		while ((entry = readdir(dir))) {
+			if (user_icon_file(entry->d_name))
+				files.append(QString::fromLocal8Bit(entry->d_name));
+		}
+		closedir(dir);
+		files.sort();
+		for (int i = 0; i < files.size(); i++)
+			h = stamp_add_path(h, cfgdir + "/" + files.at(i));
+	}
+
+	return (long long) h;
+}
+
+void IconIndexThread::run() {
+	icon_index_build();
+	emit indexReady();
+}
+
+static QImage read_image(QString path) {
+	QImageReader reader(path);
+
+	// render svg files directly at the launcher size
+	if (reader.format() == "svg" || reader.format() == "svgz") {
+		QSize sz = reader.size();
+		if (sz.isValid())
+			reader.setScaledSize(sz.scaled(64, 64, Qt::KeepAspectRatio));
+	}
+	return reader.read();
+}
+
+static QImage resize48x48(QImage image) {
+	if (image.isNull())
+		return image;
+
+	// same as QIcon::actualSize(QSize(64, 64)): scale down, never up
+	if (image.width() > 64 || image.height() > 64)
+		image = image.scaled(64, 64, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+	if (arg_debug)
+		printf("\t- input image: w %d, h %d\n", image.width(), image.height());
+
+	QImage imgin;
+	int delta = 0;
+	if (image.height() == image.width() && image.height() <= 40) {
+		imgin = image.scaled(40, 40);
+		delta = 12;
+	}
+	else {
+		imgin = image.scaled(48, 48);
+		delta = 8;
+	}
+
+	QImage imgout(64, 64, QImage::Format_ARGB32_Premultiplied);
+	imgout.fill(Qt::transparent);
+	QPainter painter(&imgout);
+	painter.drawImage(delta, delta, imgin);
+	painter.end();
+	return imgout;
+}
+
+QImage icon_load_image(QString name, bool *try_theme) {
+	assert(try_theme);
+	*try_theme = false;
+	if (arg_debug)
+		printf("searching icon %s\n", name.toLocal8Bit().data());
+
+	if (name == ":resources/fstats" || name == ":resources/firejail-ui")
+		return QImage(name); // not resized, using the real 64x64 size
+
+	if (name.startsWith(":resources") || name.startsWith('/'))
+		return resize48x48(read_image(name));
+
+	// look for the file in firetools config directory under /home/user
+	const char *ext[] = { ".png", ".jpg", ".svg", NULL };
+	for (int i = 0; ext[i]; i++) {
+		if (svg_not_found && strcmp(ext[i], ".svg") == 0)
+			continue;
+		QString conf = QDir::homePath() + "/.config/firetools/" + name + ext[i];
+		QFileInfo fi(conf);
+		if (fi.exists() && fi.isFile()) {
+			if (arg_debug)
+				printf("\t- local config dir, %s file\n", ext[i] + 1);
+			return read_image(conf);
+		}
+	}
+
+	// system icon directories
+	QString path;
+	int rank = icon_index_lookup(name, &path);
+
+	// theme icons are preferred over scalable icons and icons from other themes
+	if (rank > ICON_RANK_PIXMAPS)
+		*try_theme = true;
+	if (rank == ICON_RANK_NONE)
+		return QImage();
+
+	if (arg_debug)
+		printf("\t- %s\n", path.toLocal8Bit().data());
+	return resize48x48(read_image(path));
+}
+
+QIcon icon_finish(QString name, QImage image, bool try_theme) {
+	if (try_theme && QIcon::hasThemeIcon(name)) {
+		if (arg_debug)
+			printf("\t- fromTheme %s\n", name.toLocal8Bit().data());
+		QIcon icon = QIcon::fromTheme(name);
+		QImage img = icon.pixmap(icon.actualSize(QSize(64, 64))).toImage();
+		return QIcon(QPixmap::fromImage(resize48x48(img)));
+	}
+
+	if (!image.isNull())
+		return QIcon(QPixmap::fromImage(image));
+
+	// create a new icon
+	if (arg_debug)
+		printf("\t- created %s\n", name.toLocal8Bit().data());
+
+	// create a new QPixmap instance for icons
+	QPixmap pix(64, 64);
+
+	// set the background color for generated icons
+	QColor iconBackgroundColor(68, 68, 68);
+
+	// fill the icon with a color
+	pix.fill(iconBackgroundColor);
+
+	// draw application's name to the icon
+	QPainter painter(&pix);
+	painter.setPen(Qt::white);
+	painter.setFont(QFont("Sans"));
+	painter.drawText(3, 20, name);
+	painter.end();
+
+	return QIcon(pix);
+}
+
+void IconLoader::run() {
+	bool try_theme;
+	QImage image = icon_load_image(icon_, &try_theme);
+	QMetaObject::invokeMethod(receiver_, "iconLoaded", Qt::QueuedConnection,
+		Q_ARG(QString, app_), Q_ARG(QString, icon_), Q_ARG(QImage, image), Q_ARG(bool, try_theme));
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef ICONS_H
+#define ICONS_H
+#include <QThread>
+#include <QRunnable>
+#include <QString>
+#include <QImage>
+#include <QIcon>
+
+// Icon search order; an icon found in a lower rank directory wins.
+enum {
+	ICON_RANK_48 = 0,	// /usr/share/icons/hicolor/48x48
+	ICON_RANK_64,		// /usr/share/icons/hicolor/64x64
+	ICON_RANK_128,		// /usr/share/icons/hicolor/128x128
+	ICON_RANK_256,		// /usr/share/icons/hicolor/256x256
+	ICON_RANK_PIXMAPS,	// /usr/share/pixmaps
+	ICON_RANK_SCALABLE,	// /usr/share/icons/hicolor/scalable
+	ICON_RANK_OTHER,	// anything else under /usr/share/icons
+	ICON_RANK_NONE
+};
+
+// Build the icon index (base name -> best icon file) in a background thread.
+// The index is stored in ~/.config/firetools/icons.index and reused as long as
+// none of the icon directories changed.
+class IconIndexThread: public QThread {
+Q_OBJECT
+
+public:
+	IconIndexThread(QObject *parent = 0): QThread(parent) {}
+
+signals:
+	void indexReady();
+
+protected:
+	void run();
+};
+
+// build or load the index; blocks until the index is available
+void icon_index_build();
+
+// find the best file for an icon name; returns the rank, ICON_RANK_NONE if not found
+int icon_index_lookup(QString name, QString *path);
+
+// modification time of the index file in nanoseconds, 0 if not available;
+// it changes every time the index is rebuilt
+long long icon_index_stamp();
+
+// key of everything the launcher icons are built from: the index stamp, the icon theme name,
+// the theme directories and the user icons in ~/.config/firetools; GUI thread only
+long long icon_source_stamp();
+
+// find and decode the icon file; safe to call from worker threads
+// try_theme is set when a theme icon should be preferred over the returned image
+QImage icon_load_image(QString name, bool *try_theme);
+
+// build the final launcher icon; GUI thread only
+QIcon icon_finish(QString name, QImage image, bool try_theme);
+
+// thread pool task loading one application icon; the result is delivered to
+// receiver's iconLoaded(QString app, QString icon, QImage image, bool try_theme) slot
+class IconLoader: public QRunnable {
+public:
+	IconLoader(QObject *receiver, QString app, QString icon):
+		receiver_(receiver), app_(app), icon_(icon) {}
+	void run();
+
+private:
+	QObject *receiver_;
+	QString app_;
+	QString icon_;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "firetools.h"
+#include <QtGlobal>
+
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
+
+#include "latencydialog.h"
+#include "profiler.h"
+#include <algorithm>
+
+#define COLUMNS 10
+
+LatencyDialog::LatencyDialog(QWidget *parent): QDialog(parent) {
+	table_ = new QTableWidget(0, COLUMNS);
+	QStringList header;
+	header << tr("Application") << tr("Runs")
+		<< tr("Spawn p50") << tr("Spawn p90")
+		<< tr("Sandbox p50") << tr("Sandbox p90")
+		<< tr("Program p50") << tr("Program p90")
+		<< tr("Window p50") << tr("Window p90");
+	table_->setHorizontalHeaderLabels(header);
+	table_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	table_->setSelectionMode(QAbstractItemView::NoSelection);
+	table_->verticalHeader()->hide();
+
+	QLabel *note = new QLabel(tr("Milliseconds from the double-click, over the last runs of each application."));
+
+	// Buttons
+	QDialogButtonBox *buttonBox = new QDialogButtonBox(QDialogButtonBox::Close);
+	connect(buttonBox, SIGNAL(rejected()), this, SLOT(reject()));
+	QPushButton *clearButton = new QPushButton(tr("Clear"));
+	connect(clearButton, SIGNAL(pressed()), this, SLOT(clear()));
+
+	QGridLayout *layout = new QGridLayout;
+	layout->addWidget(table_, 0, 0, 1, 2);
+	layout->addWidget(note, 1, 0, 1, 2);
+	layout->addWidget(clearButton, 2, 0);
+	layout->addWidget(buttonBox, 2, 1);
+	setLayout(layout);
+	resize(900, 400);
+	setWindowTitle(tr("Launch Latency"));
+
+	fill();
+}
+
+// nearest-rank percentile in milliseconds, events not detected are ignored
+static QString percentile(QList<qint64> values, int p) {
+	int i = 0;
+	while (i < values.size()) {
+		if (values.at(i) < 0)
+			values.removeAt(i);
+		else
+			i++;
+	}
+	if (values.isEmpty())
+		return QString("-");
+
+	std::sort(values.begin(), values.end());
+	int rank = (p * values.size() + 99) / 100;
+	if (rank < 1)
+		rank = 1;
+	return QString::number(values.at(rank - 1) / 1000.0, 'f', 1);
+}
+
+void LatencyDialog::fill() {
+	QList<LaunchSample> samples = LaunchProfiler::load();
+
+	// samples are grouped by application, in the order they were first seen
+	QStringList apps;
+	QHash<QString, QList<LaunchSample> > groups;
+	for (int i = 0; i < samples.size(); i++) {
+		const LaunchSample &s = samples.at(i);
+		if (!groups.contains(s.name))
+			apps.append(s.name);
+		groups[s.name].append(s);
+	}
+
+	table_->setRowCount(apps.size());
+	for (int row = 0; row < apps.size(); row++) {
+		const QList<LaunchSample> &list = groups[apps.at(row)];
+		QList<qint64> values[4];
+		for (int i = 0; i < list.size(); i++) {
+			values[0].append(list.at(i).spawn_us);
+			values[1].append(list.at(i).sandbox_us);
+			values[2].append(list.at(i).exec_us);
+			values[3].append(list.at(i).window_us);
+		}
+
+		table_->setItem(row, 0, new QTableWidgetItem(apps.at(row)));
+		table_->setItem(row, 1, new QTableWidgetItem(QString::number(list.size())));
+		for (int i = 0; i < 4; i++) {
+			table_->setItem(row, 2 + i * 2, new QTableWidgetItem(percentile(values[i], 50)));
+			table_->setItem(row, 3 + i * 2, new QTableWidgetItem(percentile(values[i], 90)));
+		}
+	}
+	table_->resizeColumnsToContents();
+}
+
+void LatencyDialog::clear() {
+	LaunchProfiler::clear();
+	fill();
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef LATENCY_DIALOG_H
+#define LATENCY_DIALOG_H
+#include <QDialog>
+class QTableWidget;
+
+// launch-latency report, median and 90th percentile for each application
+class LatencyDialog: public QDialog {
+Q_OBJECT
+
+public:
+	LatencyDialog(QWidget *parent = 0);
+
+private slots:
+	void clear();
+
+private:
+	void fill();
+
+	QTableWidget *table_;
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "firetools.h"
+#include "launcher.h"
+#include "../common/subprocess.h"
+#include <errno.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <QSocketNotifier>
+#include <QTimer>
+#include <QVector>
+
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+
+#define REAP_INTERVAL 1000	// ms, fallback without pidfd
+
+AppLauncher::AppLauncher(QObject *parent): QObject(parent) {
+	reaper_ = new QTimer(this);
+	reaper_->setInterval(REAP_INTERVAL);
+	connect(reaper_, SIGNAL(timeout()), this, SLOT(reap()));
+}
+
+AppLauncher::~AppLauncher() {
+	// the applications keep running, only the tracking stops
+	QHash<pid_t, Child>::iterator it;
+	for (it = children_.begin(); it != children_.end(); ++it) {
+		delete it->notifier;
+		if (it->pidfd != -1)
+			close(it->pidfd);
+	}
+}
+
+pid_t AppLauncher::launch(const Application &app, QString *error) {
+	if (app.argv_.isEmpty()) {
+		*error = app.error_;
+		return -1;
+	}
+	return launch(app, app.argv_, error);
+}
+
+pid_t AppLauncher::launch(const Application &app, const QList<QByteArray> &command, QString *error) {
+	QElapsedTimer timer;
+	timer.start();
+	QList<QByteArray> args = command;
+	QVector<char *> argv;
+	for (int i = 0; i < args.size(); i++)
+		argv.append(args[i].data());
+	argv.append(NULL);
+
+	pid_t pid = subprocess_spawn(argv.data(), NULL);
+	if (pid == -1) {
+		*error = QString("cannot start ") + args.first() + ": " + strerror(errno);
+		return -1;
+	}
+	qint64 spawn_us = timer.nsecsElapsed() / 1000;
+
+	Child child;
+	child.name = app.name_;
+	child.pid = pid;
+	child.pidfd = syscall(SYS_pidfd_open, pid, 0);
+	child.notifier = NULL;
+	child.timer = timer;
+	if (child.pidfd != -1) {
+		child.notifier = new QSocketNotifier(child.pidfd, QSocketNotifier::Read, this);
+		connect(child.notifier, SIGNAL(activated(int)), this, SLOT(pidfdReady(int)));
+	}
+	else if (!reaper_->isActive())
+		reaper_->start();
+	children_.insert(pid, child);
+	running_[app.name_]++;
+
+	if (arg_debug)
+		printf("%s started, pid %d, %lld us\n", app.name_.toLocal8Bit().constData(), pid, (long long) spawn_us);
+	return pid;
+}
+
+void AppLauncher::rename(QString oldname, QString newname) {
+	QHash<pid_t, Child>::iterator it;
+	for (it = children_.begin(); it != children_.end(); ++it) {
+		if (it->name == oldname)
+			it->name = newname;
+	}
+	int cnt = running_.take(oldname);
+	if (cnt)
+		running_[newname] += cnt;
+}
+
+// a pidfd becomes readable when the process exits
+void AppLauncher::pidfdReady(int fd) {
+	QHash<pid_t, Child>::iterator it;
+	for (it = children_.begin(); it != children_.end(); ++it) {
+		if (it->pidfd == fd) {
+			int status = 0;
+			pid_t pid = it->pid;
+			if (waitpid(pid, &status, WNOHANG) == pid)
+				finish(pid, status);
+			return;
+		}
+	}
+}
+
+void AppLauncher::reap() {
+	int status;
+	QList<pid_t> pids = children_.keys();
+	bool waiting = false;
+	for (int i = 0; i < pids.size(); i++) {
+		if (children_.value(pids[i]).pidfd != -1)
+			continue;
+		if (waitpid(pids[i], &status, WNOHANG) == pids[i])
+			finish(pids[i], status);
+		else
+			waiting = true;
+	}
+	if (!waiting)
+		reaper_->stop();
+}
+
+void AppLauncher::finish(pid_t pid, int status) {
+	Child child = children_.take(pid);
+	if (child.notifier) {
+		child.notifier->setEnabled(false);
+		child.notifier->deleteLater();
+	}
+	if (child.pidfd != -1)
+		close(child.pidfd);
+	if (--running_[child.name] <= 0)
+		running_.remove(child.name);
+
+	qint64 runtime = child.timer.elapsed();
+	if (arg_debug)
+		printf("%s exited, pid %d, status %d, %lld ms\n", child.name.toLocal8Bit().constData(),
+			pid, status, (long long) runtime);
+	emit exited(child.name, pid, status, runtime);
+}
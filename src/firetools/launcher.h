@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef LAUNCHER_H
+#define LAUNCHER_H
+#include <sys/types.h>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include "applications.h"
+
+class QSocketNotifier;
+class QTimer;
+
+// Start applications from their pre-split argv with posix_spawn (subprocess_spawn) and
+// keep track of the running processes. The exit of a process is delivered by the kernel
+// through a pidfd watched with a QSocketNotifier; on kernels without pidfd support the
+// children are reaped by a timer.
+class AppLauncher: public QObject {
+Q_OBJECT
+
+public:
+	AppLauncher(QObject *parent = 0);
+	~AppLauncher();
+
+	// start the application; returns the pid, or -1 with the reason in *error
+	pid_t launch(const Application &app, QString *error);
+	// same, with a different command, e.g. joining a sandbox from the warm pool
+	pid_t launch(const Application &app, const QList<QByteArray> &command, QString *error);
+
+	// number of running instances of an application
+	int running(QString name) const {
+		return running_.value(name);
+	}
+	// an application was renamed in the edit dialog
+	void rename(QString oldname, QString newname);
+
+signals:
+	// status as returned by waitpid; runtime_ms: time since the launch
+	void exited(QString name, pid_t pid, int status, qint64 runtime_ms);
+
+private slots:
+	void pidfdReady(int fd);
+	void reap();
+
+private:
+	struct Child {
+		QString name;
+		pid_t pid;
+		int pidfd;		// -1 if not supported
+		QSocketNotifier *notifier;
+		QElapsedTimer timer;
+	};
+
+	void finish(pid_t pid, int status);
+
+	QHash<pid_t, Child> children_;
+	QHash<QString, int> running_;	// application name -> running instances
+	QTimer *reaper_;		// only used without pidfd support
+};
+
+#endif
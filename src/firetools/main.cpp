@@ -28,6 +28,8 @@
 #include "../../firetools_config.h"
 
 int arg_debug = 0;
+int arg_profile = 0;
+int arg_max_apps = 0;
 int svg_not_found = 0;
 
 // desktop file content for autostart
@@ -51,7 +53,10 @@ static void usage() {
 	printf("\t\twhen X11 session is started\n\n");
 	printf("\t--debug - debug mode\n\n");
 	printf("\t--help - this help screen\n\n");
+	printf("\t--max-apps=number - show only the most used applications in the launcher\n\n");
 	printf("\t--minimize - start the program minimized in system tray\n\n");
+	printf("\t--profile-launch - measure the startup latency of the applications\n");
+	printf("\t\tlaunched from firetools\n\n");
 	printf("\t--version - print software version and exit\n\n");
 }
 
@@ -101,6 +106,15 @@ int main(int argc, char *argv[]) {
 		}
 		else if (strcmp(argv[i], "--minimize") == 0)
 			arg_minimize = 1;
+		else if (strcmp(argv[i], "--profile-launch") == 0)
+			arg_profile = 1;
+		else if (strncmp(argv[i], "--max-apps=", 11) == 0) {
+			arg_max_apps = atoi(argv[i] + 11);
+			if (arg_max_apps <= 0) {
+				fprintf(stderr, "Error: invalid --max-apps option\n");
+				return 1;
+			}
+		}
 		else {
 			fprintf(stderr, "Error: invalid option\n");
 			usage();
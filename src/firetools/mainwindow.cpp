@@ -29,8 +29,18 @@
 #include "../../firetools_config.h"
 #include "mainwindow.h"
 #include "../common/utils.h"
+#include "../common/subprocess.h"
 #include "applications.h"
 #include "edit_dialog.h"
+#include "icons.h"
+#include "launcher.h"
+#include "profiler.h"
+#include "latencydialog.h"
+#include "pool.h"
+#include "frecency.h"
+#include <sys/wait.h>
+
+#define LAUNCH_FAIL_MS 3000	// a sandbox exiting with an error this early failed to start
 
 MainWindow::MainWindow(QWidget *parent): QWidget(parent, Qt::FramelessWindowHint | Qt::WindowSystemMenuHint) {
 	active_index_ = -1;
@@ -47,12 +57,15 @@ MainWindow::MainWindow(QWidget *parent): QWidget(parent, Qt::FramelessWindowHint
 	}
 
 	// check if we have permission to run firejail
-	char *testrun = run_program("firejail exit 2>&1");
-	if (!testrun || strstr(testrun, "Error")) {
+	char *testargv[] = { (char *) "firejail", (char *) "exit", NULL };
+	SubprocessResult testrun;
+	if (subprocess_run(testargv, SUBPROCESS_KEEP_OUT | SUBPROCESS_MERGE_ERR, 0, NULL, NULL, NULL, &testrun) == -1 ||
+	    strstr(testrun.out, "Error")) {
 		QMessageBox::warning(this, tr("Firejail Launcher"),
 			tr("<br/>Cannot run <b>Firejail</b> sandbox, you may not have<br/>the correct permissions to access this program.<br/><br/><br/>"));
 		exit(1);
 	}
+	subprocess_free(&testrun);
 
 	// check svg support
 #if QT_VERSION >= 0x050000
@@ -72,6 +85,23 @@ MainWindow::MainWindow(QWidget *parent): QWidget(parent, Qt::FramelessWindowHint
 #endif
 
 	applications_init();
+	applications_sort();
+
+	// icons are loaded from the atlas cache, or in background while placeholders are painted
+	atlas_.load(applist);
+	icon_thread_ = new IconIndexThread(this);
+	connect(icon_thread_, SIGNAL(indexReady()), this, SLOT(loadIcons()));
+	icon_thread_->start();
+
+	launcher_ = new AppLauncher(this);
+	connect(launcher_, SIGNAL(exited(QString, pid_t, int, qint64)), this, SLOT(appExited(QString, pid_t, int, qint64)));
+	profiler_ = new LaunchProfiler(this);
+	profiler_->setEnabled(arg_profile);
+	connect(launcher_, SIGNAL(exited(QString, pid_t, int, qint64)), profiler_, SLOT(appExited(QString, pid_t, int, qint64)));
+	pool_ = new SandboxPool(this);
+	connect(launcher_, SIGNAL(exited(QString, pid_t, int, qint64)), pool_, SLOT(appExited(QString, pid_t, int, qint64)));
+	pool_->refill();
+
 	createTrayActions();
 	createLocalActions();
 //	thread_ = new PidThread();
@@ -99,6 +129,7 @@ void MainWindow::edit() {
 					Application app(edit->getName(), edit->getDescription(), edit->getCommand(), edit->getName());
 					app.saveConfig();
 					applist.append(app);
+					loadIcons();
 					if (arg_debug) {
 						printf("Application added:\n");
 						applist_print();
@@ -115,9 +146,12 @@ void MainWindow::edit() {
 //printf("%s\n", applist[active_index_].exec_.toLocal8Bit().constData());
 			edit = new EditDialog(applist[active_index_].name_, applist[active_index_].description_, applist[active_index_].exec_);
 			if (QDialog::Accepted == edit->exec()) {
+				atlas_.rename(applist[active_index_].name_, edit->getName());
+				launcher_->rename(applist[active_index_].name_, edit->getName());
+				frecency_rename(applist[active_index_].name_, edit->getName());
 				applist[active_index_].name_ = edit->getName();
 				applist[active_index_].description_ = edit->getDescription();
-				applist[active_index_].exec_ = edit->getCommand();
+				applist[active_index_].setExec(edit->getCommand());
 				applist[active_index_].saveConfig();
 			}
 		}
@@ -138,7 +172,10 @@ void MainWindow::remove() {
 	char *fname = get_config_file_name(applist[active_index_].name_.toLocal8Bit().constData());
 	if (fname) {
 		unlink(fname);
+		atlas_.remove(applist[active_index_].name_);
+		frecency_remove(applist[active_index_].name_);
 		applist.removeAt(active_index_);
+		atlas_.save(applist);
 		if (arg_debug) {
 			printf("Application removed:\n");
 			applist_print();
@@ -153,14 +190,121 @@ void MainWindow::remove() {
 }
 
 
+// Start loading the icons not in the atlas yet
+void MainWindow::loadIcons() {
+	// the icon index was rebuilt, the theme or the user icons changed: icons in the atlas
+	// might be out of date
+	long long stamp = icon_source_stamp();
+	if (atlas_.stamp() != stamp) {
+		atlas_.reset(stamp);
+		update();
+	}
+
+	QList<Application>::iterator it;
+	for (it = applist.begin(); it != applist.end(); ++it) {
+		if (!atlas_.contains(it->name_))
+			QThreadPool::globalInstance()->start(new IconLoader(this, it->name_, it->icon_));
+	}
+}
+
+// Icon loaded by a worker thread
+void MainWindow::iconLoaded(QString app, QString icon, QImage image, bool try_theme) {
+	QList<Application>::iterator it;
+	for (it = applist.begin(); it != applist.end(); ++it) {
+		if (it->name_ == app && it->icon_ == icon) {
+			atlas_.insert(app, icon_finish(icon, image, try_theme));
+			update();
+			break;
+		}
+	}
+
+	// save the atlas once all the icons are loaded
+	for (it = applist.begin(); it != applist.end(); ++it) {
+		if (!atlas_.contains(it->name_))
+			return;
+	}
+	atlas_.save(applist);
+}
+
+// Start an application and report the error if it could not be started
+void MainWindow::launch(int index) {
+	QString error;
+	qint64 start = LaunchProfiler::now_us();
+
+	// an idle sandbox from the warm pool is joined if one is ready
+	QList<QByteArray> argv;
+	pid_t sandbox = pool_->take(applist[index], &argv);
+	pid_t pid;
+	if (sandbox != -1) {
+		pid = launcher_->launch(applist[index], argv, &error);
+		pool_->used(pid, sandbox);
+	}
+	else {
+		pid = launcher_->launch(applist[index], &error);
+		argv = applist[index].argv_;
+	}
+
+	if (pid == -1) {
+		QMessageBox::warning(this, tr("Firejail Launcher"),
+			tr("<br/>Cannot start <b>%1</b>:<br/>%2<br/><br/>").arg(applist[index].name_, error));
+		update();
+		return;
+	}
+
+	if (profiler_->enabled())
+		profiler_->track(applist[index].name_, argv, pid, start, LaunchProfiler::now_us());
+	// the new score is used the next time the window is opened
+	frecency_record(applist[index].name_);
+	update();
+}
+
+// Order the applications by usage; only while the window is hidden, the icons
+// do not move under the mouse
+void MainWindow::reorder() {
+	if (isVisible())
+		return;
+	applications_sort();
+	active_index_ = -1;
+	edit_index_ = -1;
+}
+
+void MainWindow::restore() {
+	reorder();
+	showNormal();
+}
+
+// Launch-latency profiling, enabled from the context menu or with --profile-launch
+void MainWindow::profileLaunches(bool enabled) {
+	profiler_->setEnabled(enabled);
+}
+
+void MainWindow::latencyReport() {
+	LatencyDialog dialog(this);
+	dialog.exec();
+}
+
+// Warm sandbox pool statistics
+void MainWindow::poolReport() {
+	QMessageBox::information(this, tr("Warm Sandbox Pool"), pool_->report());
+}
+
+// An application started by the launcher exited
+void MainWindow::appExited(QString name, pid_t pid, int status, qint64 runtime_ms) {
+	(void) pid;
+	update();
+
+	// firejail exits right away with an error if the sandbox cannot be set up
+	if (runtime_ms < LAUNCH_FAIL_MS && WIFEXITED(status) && WEXITSTATUS(status) != 0)
+		QMessageBox::warning(this, tr("Firejail Launcher"),
+			tr("<br/><b>%1</b> exited with status %2 right after the start.<br/>"
+			   "Run the command in a terminal to see the error.<br/><br/>").arg(name).arg(WEXITSTATUS(status)));
+}
+
 // Run application
 void MainWindow::run() {
 	int index = active_index_;
-	if (index != -1) {
-		QString exec = applist[index].exec_ + " &";
-		int rv = system(exec.toStdString().c_str());
-		(void) rv;
-	}
+	if (index != -1)
+		launch(index);
 
 	animation_id_ = AFRAMES;
 	QTimer::singleShot(0, this, SLOT(update()));
@@ -203,7 +347,7 @@ void MainWindow::runAbout() {
 
 // Mouse events: mouse release
 void MainWindow::mouseReleaseEvent(QMouseEvent *event) {
-	int nelem = applist.count();
+	int nelem = applications_visible();
 	int cols = nelem / ROWS + 1;
 
 	if (event->button() == Qt::LeftButton) {
@@ -266,9 +410,7 @@ void MainWindow::mouseDoubleClickEvent(QMouseEvent *event) {
 		QPoint pos = event->pos();
 		int index = applications_get_index(pos);
 		if (index != -1) {
-			QString exec = applist[index].exec_ + " &";
-			int rv = system(exec.toStdString().c_str());
-			(void) rv;
+			launch(index);
 			event->accept();
 			animation_id_ = AFRAMES;
 			active_index_ = index;
@@ -280,7 +422,7 @@ void MainWindow::mouseDoubleClickEvent(QMouseEvent *event) {
 // Main window visual design
 void MainWindow::paintEvent(QPaintEvent *) {
 	// Count the number applications and put the value to the variable
-	int nelem = applist.count();
+	int nelem = applications_visible();
 
 	// Columns is the amount of applications divided by number of rows + 1
 	int cols = nelem / ROWS + 1;
@@ -310,9 +452,6 @@ void MainWindow::paintEvent(QPaintEvent *) {
 		if (j >= ROWS)
 			j = 0;
 
-		// Select icon from the looped items
-		QIcon icon = applist[i].app_icon_;
-
 		int sz = 64 ;
 		if (active_index_ == i)
 			sz -= animation_id_ * 3;
@@ -327,21 +466,23 @@ void MainWindow::paintEvent(QPaintEvent *) {
 
 		QPoint pixmapTarget(pixmapTargetXposition, pixmapTargetYposition);
 
-		// Source
-		int pixmapWidth = sz;
-		int pixmapHeight = sz;
-
-		QSize pixmapSize(pixmapWidth, pixmapHeight);
-
-		// "The QPixmap class is an off-screen image representation that can be used as a paint device."
-		// - https://doc.qt.io/qt-5.10/qpixmap.html
-		// "Returns a pixmap with the requested size, mode, and state,"
-		// - https://doc.qt.io/qt-5.10/qicon.html#pixmap
-		QPixmap pixmap = icon.pixmap(pixmapSize, QIcon::Normal, QIcon::On);
-
+		// Paint the icon from the atlas, or a placeholder until the icon is loaded
+		// - https://doc.qt.io/qt-5.10/qpainter.html#drawPixmap-9
+		if (!atlas_.draw(&painter, applist[i].name_, sz, pixmapTarget)) {
+			QRect placeholder(pixmapTarget, QSize(sz, sz));
+			painter.fillRect(placeholder.adjusted(8, 8, -8, -8), QColor(90, 90, 90));
+		}
 
-		// Paint pixmap items
-		painter.drawPixmap(pixmapTarget, pixmap);
+		// running badge in the bottom right corner of the cell
+		if (launcher_->running(applist[i].name_)) {
+			int x = MARGIN * 2 + (i / ROWS) * 64 + 64 - 12;
+			int y = MARGIN * 2 + j * 64 + TOP + 64 - 12;
+			painter.setPen(QPen(QColor(68, 68, 68), 2));
+			painter.setBrush(QColor(80, 200, 120));
+			painter.drawEllipse(QRect(x, y, 9, 9));
+			painter.setPen(Qt::NoPen);
+			painter.setBrush(Qt::NoBrush);
+		}
 	}
 
 
@@ -370,7 +511,7 @@ void MainWindow::paintEvent(QPaintEvent *) {
 
 // Window resize
 void MainWindow::resizeEvent(QResizeEvent * /* event */) {
-	int nelem = applist.count();
+	int nelem = applications_visible();
 	int cols = nelem / ROWS + 1;
 
 	// margins
@@ -387,7 +528,7 @@ void MainWindow::resizeEvent(QResizeEvent * /* event */) {
 
 // Window size hint
 QSize MainWindow::sizeHint() const {
-	int nelem = applist.count();
+	int nelem = applications_visible();
 	int cols = nelem / ROWS + 1;
 
 	return QSize(64 * cols + MARGIN * 4, ROWS * 64 + MARGIN * 4 + TOP);
@@ -402,7 +543,7 @@ bool MainWindow::event(QEvent *event) {
 		if (index == -1) {
 			int x = helpEvent->pos().x();
 			int y = helpEvent->pos().y();
-			int nelem = applist.count();
+			int nelem = applications_visible();
 			int cols = nelem / ROWS + 1;
 
 			if (x >= MARGIN * 2 + cols * 64 - 8 && x <= MARGIN * 2 + cols * 64 + 4 &&
@@ -420,7 +561,13 @@ bool MainWindow::event(QEvent *event) {
 				QToolTip::hideText();
 		}
 		else {
-			QToolTip::showText(helpEvent->globalPos(), applist[index].description_);
+			QString tip = applist[index].description_;
+			int cnt = launcher_->running(applist[index].name_);
+			if (cnt)
+				tip += QString(" (running") + ((cnt > 1)? QString(", %1 instances)").arg(cnt): QString(")"));
+			if (applist[index].argv_.isEmpty())
+				tip += "\n" + applist[index].error_;
+			QToolTip::showText(helpEvent->globalPos(), tip);
 			return true;
 		}
 	}
@@ -440,6 +587,7 @@ void MainWindow::trayActivated(QSystemTrayIcon::ActivationReason reason) {
 //		stats_->hide();
 	}
 	else {
+		reorder();
 		show();
 //		stats_->hide();
 	}
@@ -452,7 +600,7 @@ void MainWindow::createTrayActions() {
 //	connect(minimizeAction, SIGNAL(triggered()), stats_, SLOT(hide()));
 
 	restoreAction = new QAction(tr("&Restore"), this);
-	connect(restoreAction, SIGNAL(triggered()), this, SLOT(showNormal()));
+	connect(restoreAction, SIGNAL(triggered()), this, SLOT(restore()));
 //	connect(restoreAction, SIGNAL(triggered()), stats_, SLOT(show()));
 
 	quitAction = new QAction(tr("&Quit"), this);
@@ -492,6 +640,24 @@ void MainWindow::createLocalActions() {
 	connect(qhelp_, SIGNAL(triggered()), this, SLOT(help()));
 	addAction(qhelp_);
 
+	QAction *separator3 = new QAction(this);
+	separator3->setSeparator(true);
+	addAction(separator3);
+
+	QAction *qprofile = new QAction(tr("&Profile launches"), this);
+	qprofile->setCheckable(true);
+	qprofile->setChecked(profiler_->enabled());
+	connect(qprofile, SIGNAL(toggled(bool)), this, SLOT(profileLaunches(bool)));
+	addAction(qprofile);
+
+	QAction *qreport = new QAction(tr("Launch &report..."), this);
+	connect(qreport, SIGNAL(triggered()), this, SLOT(latencyReport()));
+	addAction(qreport);
+
+	QAction *qpool = new QAction(tr("&Warm pool..."), this);
+	connect(qpool, SIGNAL(triggered()), this, SLOT(poolReport()));
+	addAction(qpool);
+
 	QAction *separator2 = new QAction(this);
 	separator2->setSeparator(true);
 	addAction(separator2);
@@ -536,6 +702,13 @@ void MainWindow::help() {
 void MainWindow::main_quit() {
 	printf("exiting...\n");
 
+	// idle sandboxes are not left behind
+	pool_->shutdown();
+
+	// wait for background icon loading
+	icon_thread_->wait();
+	QThreadPool::globalInstance()->waitForDone();
+
 	// delete application list
 	QList<Application>::iterator it = applist.begin();
 	while (it !=applist.end())
@@ -21,7 +21,14 @@
 #define MAINWINDOW_H
 #include <QWidget>
 #include <QAction>
+#include <QImage>
 #include <QSystemTrayIcon>
+#include "atlas.h"
+
+class IconIndexThread;
+class AppLauncher;
+class LaunchProfiler;
+class SandboxPool;
 
 class MainWindow : public QWidget {
 Q_OBJECT
@@ -51,6 +58,13 @@ private slots:
 	void main_quit();
 	void newSandbox();
 	void runAbout();
+	void loadIcons();
+	void iconLoaded(QString app, QString icon, QImage image, bool try_theme);
+	void appExited(QString name, pid_t pid, int status, qint64 runtime_ms);
+	void profileLaunches(bool enabled);
+	void latencyReport();
+	void poolReport();
+	void restore();
 
 signals:
 	void cycleReadySignal();
@@ -60,6 +74,8 @@ signals:
 private:
     	void createTrayActions();
    	void createLocalActions();
+	void launch(int index);
+	void reorder();
 	
 private:
 	QPoint dragPosition_;
@@ -70,6 +86,11 @@ private:
 	int active_index_;
 	int animation_id_;
 	int edit_index_;
+	IconIndexThread *icon_thread_;
+	IconAtlas atlas_;
+	AppLauncher *launcher_;
+	LaunchProfiler *profiler_;
+	SandboxPool *pool_;
 	
 public:	
 	// tray
@@ -0,0 +1,530 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "firetools.h"
+#include "pool.h"
+#include "../common/utils.h"
+#include "../common/subprocess.h"
+#include <errno.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QVector>
+
+#define POOL_MEMORY 256		// MB, default memory limit for the idle sandboxes
+#define POOL_MAX 4		// idle sandboxes for one application
+#define POOL_ESTIMATE 16384	// KB, memory of a sandbox before any sandbox was measured
+#define POOL_FAILURES 3		// the application is disabled after this many failed sandboxes
+#define POOL_TIMEOUT 30000	// ms, time allowed to set up an idle sandbox
+#define POOL_FALLBACK_DELAY 2000	// ms, the sandbox is assumed ready if the ready file cannot be checked
+#define POOL_REFILL_DELAY 2000	// ms, the replacement is not started in the middle of a launch
+#define FAST_INTERVAL 100	// ms, sandboxes are being set up
+#define SLOW_INTERVAL 1000	// ms
+
+static qint64 now_ms() {
+	static QElapsedTimer clock;
+	if (!clock.isValid())
+		clock.start();
+	return clock.elapsed();
+}
+
+static char *config_file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/pool.conf", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+// index of the program in a firejail command, -1 if the command does not start firejail
+// or uses options the pool cannot reproduce
+static int program_index(const QList<QByteArray> &argv) {
+	const QByteArray &cmd = argv.first();
+	if (cmd != "firejail" && !cmd.endsWith("/firejail"))
+		return -1;
+	for (int i = 1; i < argv.size(); i++) {
+		const QByteArray &arg = argv.at(i);
+		if (!arg.startsWith('-'))
+			return i;
+		// two sandboxes cannot have the same name, and sleep is missing from private-bin
+		if (arg.startsWith("--name=") || arg.startsWith("--private-bin") || arg.startsWith("--join"))
+			return -1;
+	}
+	return -1;
+}
+
+// the first child of the firejail process is the sandbox init
+static pid_t first_child(pid_t pid) {
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/task/%d/children", pid, pid) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return -1;
+	int child;
+	if (fscanf(fp, "%d", &child) != 1)
+		child = -1;
+	fclose(fp);
+	return child;
+}
+
+static int count_children(pid_t pid) {
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/task/%d/children", pid, pid) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return 0;
+	int cnt = 0;
+	int child;
+	while (fscanf(fp, "%d", &child) == 1)
+		cnt++;
+	fclose(fp);
+	return cnt;
+}
+
+// firejail creates /run/firejail/mnt/ready-for-join in the sandbox when the setup is finished
+// returns 1 if ready, 0 if not yet, -1 if the sandbox root cannot be accessed (EACCES/EPERM)
+static int sandbox_ready(pid_t pid) {
+	pid_t child = first_child(pid);
+	if (child == -1)
+		return 0;
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/root/run/firejail/mnt/ready-for-join", child) == -1)
+		errExit("asprintf");
+	int rv = 0;
+	if (access(fname, F_OK) == 0)
+		rv = 1;
+	else if (errno == EACCES || errno == EPERM)
+		rv = -1;
+	free(fname);
+	return rv;
+}
+
+// firejail picks the profile from the program name; the idle sandbox runs sleep, the profile
+// of the application is passed explicitly. Returns false if the application has no profile
+// of its own, the pool sandbox would not match the sandbox of a normal launch.
+static bool profile_option(const QList<QByteArray> &argv, int prog, QByteArray *option) {
+	option->clear();
+	for (int i = 1; i < prog; i++) {
+		if (argv.at(i).startsWith("--profile") || argv.at(i) == "--noprofile")
+			return true;
+	}
+
+	QByteArray name = argv.at(prog);
+	int index = name.lastIndexOf('/');
+	if (index != -1)
+		name = name.mid(index + 1);
+	char *home = get_home_directory();
+	char *user = NULL;
+	if (home && asprintf(&user, "%s/.config/firejail/%s.profile", home, name.constData()) == -1)
+		errExit("asprintf");
+	free(home);
+	char *sys;
+	if (asprintf(&sys, "/etc/firejail/%s.profile", name.constData()) == -1)
+		errExit("asprintf");
+	bool found = (user && access(user, R_OK) == 0) || access(sys, R_OK) == 0;
+	free(user);
+	free(sys);
+	if (!found)
+		return false;
+	*option = "--profile=" + name;
+	return true;
+}
+
+// resident memory of a process and all its descendants, in KB
+static long tree_rss(pid_t pid, int depth) {
+	long rss = 0;
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/status", pid) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (fp) {
+		char buf[256];
+		while (fgets(buf, sizeof(buf), fp)) {
+			if (sscanf(buf, "VmRSS: %ld", &rss) == 1)
+				break;
+		}
+		fclose(fp);
+	}
+	if (depth == 0)
+		return rss;
+
+	if (asprintf(&fname, "/proc/%d/task/%d/children", pid, pid) == -1)
+		errExit("asprintf");
+	fp = fopen(fname, "re");
+	free(fname);
+	if (fp) {
+		int child;
+		while (fscanf(fp, "%d", &child) == 1)
+			rss += tree_rss(child, depth - 1);
+		fclose(fp);
+	}
+	return rss;
+}
+
+SandboxPool::SandboxPool(QObject *parent): QObject(parent), limit_kb_(POOL_MEMORY * 1024), shutdown_(false) {
+	timer_ = new QTimer(this);
+	timer_->setSingleShot(true);
+	connect(timer_, SIGNAL(timeout()), this, SLOT(check()));
+	loadConfig();
+}
+
+SandboxPool::~SandboxPool() {
+	shutdown();
+}
+
+void SandboxPool::loadConfig() {
+	char *fname = config_file_name();
+	if (!fname)
+		return;
+	FILE *fp = fopen(fname, "re");
+	free(fname);
+	if (!fp)
+		return;
+
+	char *buf = NULL;
+	size_t size = 0;
+	while (getline(&buf, &size, fp) != -1) {
+		char *ptr = strchr(buf, '\n');
+		if (ptr)
+			*ptr = '\0';
+		ptr = buf;
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+		if (*ptr == '\0' || *ptr == '#')
+			continue;
+
+		// the application name can contain spaces, the count is the last word
+		char *last = strrchr(ptr, ' ');
+		int value;
+		if (!last || sscanf(last + 1, "%d", &value) != 1 || value < 0) {
+			fprintf(stderr, "Warning: invalid line in pool.conf: %s\n", ptr);
+			continue;
+		}
+		while (last > ptr && (last[-1] == ' ' || last[-1] == '\t'))
+			last--;
+		*last = '\0';
+
+		if (strcmp(ptr, "memory") == 0)
+			limit_kb_ = (long) value * 1024;
+		else if (value > 0)
+			config_.insert(QString::fromLocal8Bit(ptr), (value > POOL_MAX)? POOL_MAX: value);
+	}
+	free(buf);
+	fclose(fp);
+
+	if (arg_debug && !config_.isEmpty())
+		printf("warm pool: %d applications, %ld KB memory limit\n", config_.size(), limit_kb_);
+}
+
+// the memory of a sandbox not measured yet is estimated from the ones already running,
+// or taken as POOL_ESTIMATE on a cold pool
+long SandboxPool::estimate() const {
+	long avg = 0;
+	int measured = 0;
+	for (int i = 0; i < idle_.size(); i++) {
+		if (idle_.at(i).ready && idle_.at(i).rss_kb) {
+			avg += idle_.at(i).rss_kb;
+			measured++;
+		}
+	}
+	return (measured)? avg / measured: POOL_ESTIMATE;
+}
+
+long SandboxPool::idleMemory() const {
+	long est = estimate();
+	long rv = 0;
+	for (int i = 0; i < idle_.size(); i++)
+		rv += (idle_.at(i).ready && idle_.at(i).rss_kb)? idle_.at(i).rss_kb: est;
+	return rv;
+}
+
+// start an idle sandbox for the application: same options, --quiet, and sleep as the program
+bool SandboxPool::start(const Application &app) {
+	int prog = program_index(app.argv_);
+	if (prog == -1) {
+		stats_[app.name_].disabled = true;
+		if (arg_debug)
+			printf("warm pool: %s cannot be started in a pool sandbox\n", app.name_.toLocal8Bit().constData());
+		return false;
+	}
+
+	QByteArray profile;
+	if (!profile_option(app.argv_, prog, &profile)) {
+		stats_[app.name_].disabled = true;
+		if (arg_debug)
+			printf("warm pool: no profile found for %s, not pooled\n", app.name_.toLocal8Bit().constData());
+		return false;
+	}
+
+	QList<QByteArray> args = app.argv_.mid(0, prog);
+	if (!profile.isEmpty())
+		args.append(profile);
+	args.append("--quiet");
+	args.append("sleep");
+	args.append("inf");
+	QVector<char *> argv;
+	for (int i = 0; i < args.size(); i++)
+		argv.append(args[i].data());
+	argv.append(NULL);
+
+	pid_t pid = subprocess_spawn(argv.data(), NULL);
+	if (pid == -1)
+		return false;
+
+	Sandbox sandbox;
+	sandbox.name = app.name_;
+	sandbox.argv = app.argv_;
+	sandbox.pid = pid;
+	sandbox.ready = false;
+	sandbox.started_ms = now_ms();
+	sandbox.rss_kb = 0;
+	idle_.append(sandbox);
+	children_.append(pid);
+	if (arg_debug)
+		printf("warm pool: sandbox %d started for %s\n", pid, app.name_.toLocal8Bit().constData());
+	return true;
+}
+
+void SandboxPool::refill() {
+	if (shutdown_ || config_.isEmpty())
+		return;
+
+	// sandboxes of applications removed, renamed or edited
+	for (int i = 0; i < idle_.size();) {
+		bool valid = false;
+		if (config_.contains(idle_.at(i).name)) {
+			for (int j = 0; j < applist.size(); j++) {
+				if (applist.at(j).name_ == idle_.at(i).name) {
+					valid = applist.at(j).argv_ == idle_.at(i).argv;
+					break;
+				}
+			}
+		}
+		if (valid)
+			i++;
+		else
+			terminate(idle_.takeAt(i).pid);
+	}
+
+	long est = estimate();
+	for (int i = 0; i < applist.size(); i++) {
+		const Application &app = applist.at(i);
+		int wanted = config_.value(app.name_);
+		if (!wanted || app.argv_.isEmpty() || stats_.value(app.name_).disabled)
+			continue;
+		int cnt = 0;
+		for (int j = 0; j < idle_.size(); j++) {
+			if (idle_.at(j).name == app.name_)
+				cnt++;
+		}
+		for (; cnt < wanted; cnt++) {
+			if (idleMemory() + est > limit_kb_ || !start(app))
+				break;
+		}
+	}
+	scheduleCheck();
+}
+
+pid_t SandboxPool::take(const Application &app, QList<QByteArray> *argv) {
+	if (!config_.contains(app.name_) || stats_.value(app.name_).disabled)
+		return -1;
+
+	Stats &stats = stats_[app.name_];
+	for (int i = 0; i < idle_.size(); i++) {
+		const Sandbox &sandbox = idle_.at(i);
+		if (sandbox.ready && sandbox.name == app.name_ && sandbox.argv == app.argv_) {
+			pid_t pid = sandbox.pid;
+			idle_.removeAt(i);
+			stats.hits++;
+
+			argv->clear();
+			argv->append(app.argv_.first());
+			argv->append("--join=" + QByteArray::number(pid));
+			*argv += app.argv_.mid(program_index(app.argv_));
+			QTimer::singleShot(POOL_REFILL_DELAY, this, SLOT(check()));
+			if (arg_debug)
+				printf("warm pool: %s joins sandbox %d\n", app.name_.toLocal8Bit().constData(), pid);
+			return pid;
+		}
+	}
+
+	stats.misses++;
+	QTimer::singleShot(POOL_REFILL_DELAY, this, SLOT(check()));
+	return -1;
+}
+
+void SandboxPool::used(pid_t pid, pid_t sandbox) {
+	if (pid == -1)
+		terminate(sandbox);
+	else
+		used_.insert(pid, sandbox);
+}
+
+// the joining process exited; the sandbox is shut down once the processes left in it
+// by the program (e.g. a browser detaching from the terminal) are gone
+void SandboxPool::appExited(QString name, pid_t pid, int status, qint64 runtime_ms) {
+	(void) name;
+	(void) status;
+	(void) runtime_ms;
+	if (used_.contains(pid)) {
+		finished_.append(used_.take(pid));
+		scheduleCheck();
+	}
+}
+
+void SandboxPool::terminate(pid_t pid) {
+	// only sandboxes not reaped yet, the pid could have been reused
+	if (children_.contains(pid))
+		kill(pid, SIGTERM);
+}
+
+void SandboxPool::scheduleCheck() {
+	bool fast = !finished_.isEmpty();
+	for (int i = 0; i < idle_.size() && !fast; i++)
+		fast = !idle_.at(i).ready;
+	if (children_.isEmpty())
+		timer_->stop();
+	else
+		timer_->start(fast? FAST_INTERVAL: SLOW_INTERVAL);
+}
+
+void SandboxPool::check() {
+	// reap the sandboxes
+	for (int i = 0; i < children_.size();) {
+		pid_t pid = children_.at(i);
+		int status;
+		if (waitpid(pid, &status, WNOHANG) != pid) {
+			i++;
+			continue;
+		}
+		children_.removeAt(i);
+		finished_.removeAll(pid);
+		for (int j = 0; j < idle_.size(); j++) {
+			if (idle_.at(j).pid != pid)
+				continue;
+			Sandbox sandbox = idle_.takeAt(j);
+			if (!shutdown_ && !sandbox.ready)
+				failed(sandbox.name, "exited");
+			break;
+		}
+	}
+	if (shutdown_)
+		return;
+
+	// sandboxes in use, shut down when only the idle program is left
+	for (int i = 0; i < finished_.size();) {
+		pid_t child = first_child(finished_.at(i));
+		if (child == -1 || count_children(child) <= 1)
+			terminate(finished_.takeAt(i));
+		else
+			i++;
+	}
+
+	// sandboxes being set up, and the memory of the ready ones
+	qint64 now = now_ms();
+	for (int i = 0; i < idle_.size();) {
+		Sandbox &sandbox = idle_[i];
+		if (!sandbox.ready) {
+			// without access to the sandbox root, a firejail still running after
+			// POOL_FALLBACK_DELAY is taken as ready
+			int state = sandbox_ready(sandbox.pid);
+			sandbox.ready = (state == 1) || (state == -1 && now - sandbox.started_ms >= POOL_FALLBACK_DELAY);
+			if (!sandbox.ready && now - sandbox.started_ms > POOL_TIMEOUT) {
+				// removed from the idle list, the failure is not counted again when it is reaped
+				Sandbox expired = idle_.takeAt(i);
+				terminate(expired.pid);
+				failed(expired.name, "timed out");
+				continue;
+			}
+		}
+		if (sandbox.ready)
+			sandbox.rss_kb = tree_rss(sandbox.pid, 3);
+		i++;
+	}
+
+	// the most recent sandboxes are dropped above the memory limit
+	while (idleMemory() > limit_kb_ && !idle_.isEmpty()) {
+		Sandbox sandbox = idle_.takeLast();
+		if (arg_debug)
+			printf("warm pool: memory limit, sandbox %d for %s terminated\n", sandbox.pid,
+				sandbox.name.toLocal8Bit().constData());
+		terminate(sandbox.pid);
+	}
+
+	refill();
+}
+
+// an idle sandbox could not be set up
+void SandboxPool::failed(const QString &name, const char *reason) {
+	Stats &stats = stats_[name];
+	if (++stats.failed >= POOL_FAILURES)
+		stats.disabled = true;
+	fprintf(stderr, "Warning: warm pool sandbox for %s %s%s\n", name.toLocal8Bit().constData(), reason,
+		(stats.disabled)? ", the pool is disabled for this application": "");
+}
+
+void SandboxPool::shutdown() {
+	if (shutdown_)
+		return;
+	shutdown_ = true;
+	timer_->stop();
+
+	// the sandboxes in use stay with their applications
+	for (int i = 0; i < idle_.size(); i++)
+		terminate(idle_.at(i).pid);
+	idle_.clear();
+	for (int i = 0; i < finished_.size(); i++)
+		terminate(finished_.at(i));
+	finished_.clear();
+}
+
+QString SandboxPool::report() const {
+	if (config_.isEmpty())
+		return tr("<br/>The warm pool is not configured. List the applications in "
+			"~/.config/firetools/pool.conf, one per line, followed by the number of idle "
+			"sandboxes to keep, for example \"firefox 1\". A \"memory 256\" line sets the "
+			"memory limit for all the idle sandboxes in MB.<br/><br/>");
+
+	QString rv = tr("<table cellpadding=\"4\"><tr><td><b>Application</b></td><td><b>Idle</b></td>"
+		"<td><b>Hits</b></td><td><b>Misses</b></td><td><b>Failed</b></td></tr>");
+	QHash<QString, int>::const_iterator it;
+	for (it = config_.begin(); it != config_.end(); ++it) {
+		Stats stats = stats_.value(it.key());
+		int ready = 0;
+		for (int i = 0; i < idle_.size(); i++) {
+			if (idle_.at(i).name == it.key() && idle_.at(i).ready)
+				ready++;
+		}
+		rv += QString("<tr><td>%1</td><td>%2/%3</td><td>%4</td><td>%5</td><td>%6</td></tr>")
+			.arg(it.key()).arg(ready).arg(it.value()).arg(stats.hits).arg(stats.misses)
+			.arg((stats.disabled)? tr("%1, disabled").arg(stats.failed): QString::number(stats.failed));
+	}
+	rv += "</table>";
+	rv += tr("<br/>Idle sandbox memory: %1 of %2 MB<br/>").arg(idleMemory() / 1024).arg(limit_kb_ / 1024);
+	return rv;
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef POOL_H
+#define POOL_H
+#include <sys/types.h>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QString>
+#include "applications.h"
+
+class QTimer;
+
+// Warm sandbox pool. For the applications listed in ~/.config/firetools/pool.conf a few
+// idle sandboxes are started in advance, with the same firejail options as the application
+// and "sleep inf" as the program; the profile firejail would pick from the program name is
+// passed with --profile. A launch joins one of them (firejail --join) instead of
+// building a new sandbox, and a replacement is started in background. The idle sandboxes
+// are limited by the memory they use, measured as the RSS of their processes.
+//
+// pool.conf format:
+//	memory <MB>		memory limit for all the idle sandboxes, default 256
+//	<application> <count>	idle sandboxes kept for the application
+class SandboxPool: public QObject {
+Q_OBJECT
+
+public:
+	SandboxPool(QObject *parent = 0);
+	~SandboxPool();
+
+	bool enabled() const {
+		return !config_.isEmpty();
+	}
+
+	// start the missing idle sandboxes of all the configured applications
+	void refill();
+
+	// arguments starting the application in an idle sandbox; returns the sandbox pid,
+	// or -1 if no sandbox is ready and the application has to be started normally
+	pid_t take(const Application &app, QList<QByteArray> *argv);
+	// the joining process was started, or pid is -1 if the start failed; the sandbox
+	// is shut down when the program exits
+	void used(pid_t pid, pid_t sandbox);
+
+	// statistics in html format
+	QString report() const;
+
+	// terminate the idle sandboxes
+	void shutdown();
+
+public slots:
+	void appExited(QString name, pid_t pid, int status, qint64 runtime_ms);
+
+private slots:
+	void check();
+
+private:
+	struct Sandbox {
+		QString name;
+		QList<QByteArray> argv;	// application command the sandbox was started for
+		pid_t pid;		// firejail process
+		bool ready;
+		qint64 started_ms;
+		long rss_kb;
+	};
+	struct Stats {
+		Stats(): hits(0), misses(0), failed(0), disabled(false) {}
+		int hits;
+		int misses;
+		int failed;	// idle sandboxes exited before they were ready
+		bool disabled;	// the sandbox cannot be prepared, e.g. sleep is not in private-bin
+	};
+
+	void loadConfig();
+	bool start(const Application &app);
+	void scheduleCheck();
+	long estimate() const;
+	long idleMemory() const;
+	void terminate(pid_t pid);
+	void failed(const QString &name, const char *reason);
+
+	QHash<QString, int> config_;		// application name -> idle sandboxes
+	long limit_kb_;
+	QList<Sandbox> idle_;
+	QHash<pid_t, pid_t> used_;		// joining process -> sandbox
+	QList<pid_t> finished_;			// sandboxes in use, the joining process exited
+	QList<pid_t> children_;			// all the sandboxes started, not reaped yet
+	QHash<QString, Stats> stats_;
+	QTimer *timer_;
+	bool shutdown_;
+};
+
+#endif
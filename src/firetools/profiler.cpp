@@ -0,0 +1,520 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "firetools.h"
+#include "profiler.h"
+#include "../common/utils.h"
+#include "../common/pathdb.h"
+#include "../common/pid.h"
+#include "../common/subprocess.h"
+#include <dirent.h>
+#include <time.h>
+#include <algorithm>
+#include <QTimer>
+
+#define PROCESS_INTERVAL 10000		// us, process table scan interval
+#define PROFILE_TIMEOUT 30000000	// us, give up waiting for the window
+#define PROCESS_DEPTH 4			// sandbox levels searched for the target program
+#define LATENCY_RUNS 100		// samples kept for each application
+#define LATENCY_MAXLINES 10000		// the log is compacted above this size
+
+qint64 LaunchProfiler::now_us() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (qint64) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static char *log_file_name() {
+	char *cfgdir = get_config_directory();
+	if (!cfgdir)
+		return NULL;
+	char *fname;
+	if (asprintf(&fname, "%s/launch-latency.log", cfgdir) == -1)
+		errExit("asprintf");
+	free(cfgdir);
+	return fname;
+}
+
+static QByteArray base_name(const QByteArray &path) {
+	int index = path.lastIndexOf('/');
+	return (index == -1)? path: path.mid(index + 1);
+}
+
+// the program started in the sandbox, the first firejail argument not starting with '-'
+static QByteArray target_program(const QList<QByteArray> &argv, bool *sandboxed) {
+	*sandboxed = base_name(argv.first()) == "firejail";
+	if (!*sandboxed)
+		return base_name(argv.first());
+	for (int i = 1; i < argv.size(); i++) {
+		if (!argv.at(i).startsWith('-'))
+			return base_name(argv.at(i));
+	}
+	return QByteArray();
+}
+
+static bool match_window(const QByteArray &program, const QString &instance, const QString &wmclass) {
+	QString prog = QString::fromLocal8Bit(program).toLower();
+	QString names[2] = { instance.toLower(), wmclass.toLower() };
+	for (int i = 0; i < 2; i++) {
+		const QString &name = names[i];
+		if (name.isEmpty())
+			continue;
+		if (name == prog || (prog.size() >= 3 && name.contains(prog)) ||
+		    (name.size() >= 3 && prog.contains(name)))
+			return true;
+	}
+	return false;
+}
+
+//*************************************************************
+// profiler
+//*************************************************************
+LaunchProfiler::LaunchProfiler(QObject *parent): QObject(parent), enabled_(false),
+	processes_(NULL), windows_(NULL) {
+	QTimer *timer = new QTimer(this);
+	connect(timer, SIGNAL(timeout()), this, SLOT(checkTimeouts()));
+	timer->start(1000);
+}
+
+LaunchProfiler::~LaunchProfiler() {
+	setEnabled(false);
+}
+
+void LaunchProfiler::setEnabled(bool enabled) {
+	if (enabled == enabled_)
+		return;
+	enabled_ = enabled;
+
+	if (enabled) {
+		processes_ = new ProcessWatcher(this);
+		connect(processes_, SIGNAL(found(int, int, qint64)), this, SLOT(processFound(int, int, qint64)));
+		processes_->start(QThread::LowPriority);
+		if (WindowWatcher::available()) {
+			windows_ = new WindowWatcher(this);
+			connect(windows_, SIGNAL(windowMapped(QString, QString, qint64)),
+				this, SLOT(windowMapped(QString, QString, qint64)));
+			windows_->start(QThread::LowPriority);
+		}
+		else if (arg_debug)
+			printf("launch profiler: window detection not available\n");
+		return;
+	}
+
+	// launches in progress are dropped
+	active_.clear();
+	if (processes_) {
+		processes_->stop();
+		processes_->wait();
+		delete processes_;
+		processes_ = NULL;
+	}
+	if (windows_) {
+		windows_->stop();
+		windows_->wait();
+		delete windows_;
+		windows_ = NULL;
+	}
+}
+
+void LaunchProfiler::track(QString name, const QList<QByteArray> &argv, pid_t pid, qint64 start_us, qint64 spawn_us) {
+	if (!enabled_ || argv.isEmpty())
+		return;
+
+	Measurement m;
+	bool sandboxed;
+	m.program = target_program(argv, &sandboxed);
+	m.start_us = start_us;
+	m.sample.name = name;
+	m.sample.time = ::time(NULL);
+	m.sample.spawn_us = spawn_us - start_us;
+	m.sample.sandbox_us = -1;
+	m.sample.exec_us = -1;
+	m.sample.window_us = -1;
+	active_.insert(pid, m);
+
+	// without a sandbox, the program runs as soon as it is started
+	if (!sandboxed) {
+		active_[pid].sample.exec_us = m.sample.spawn_us;
+		if (!windows_)
+			finish(pid);
+		return;
+	}
+	processes_->add(pid, m.program);
+}
+
+void LaunchProfiler::processFound(int pid, int what, qint64 when_us) {
+	QHash<pid_t, Measurement>::iterator it = active_.find(pid);
+	if (it == active_.end())
+		return;
+
+	if (what == ProcessWatcher::FOUND_SANDBOX)
+		it->sample.sandbox_us = when_us - it->start_us;
+	else {
+		it->sample.exec_us = when_us - it->start_us;
+		if (!windows_)
+			finish(pid);
+	}
+}
+
+void LaunchProfiler::windowMapped(QString instance, QString wmclass, qint64 when_us) {
+	// the oldest launch of a matching program gets the window
+	pid_t best = -1;
+	qint64 best_start = 0;
+	QHash<pid_t, Measurement>::iterator it;
+	for (it = active_.begin(); it != active_.end(); ++it) {
+		if (it->start_us > when_us || !match_window(it->program, instance, wmclass))
+			continue;
+		if (best == -1 || it->start_us < best_start) {
+			best = it.key();
+			best_start = it->start_us;
+		}
+	}
+	if (best == -1)
+		return;
+
+	active_[best].sample.window_us = when_us - best_start;
+	finish(best);
+}
+
+void LaunchProfiler::appExited(QString name, pid_t pid, int status, qint64 runtime_ms) {
+	(void) name;
+	(void) status;
+	(void) runtime_ms;
+	if (active_.contains(pid))
+		finish(pid);
+}
+
+void LaunchProfiler::checkTimeouts() {
+	qint64 now = now_us();
+	QList<pid_t> pids = active_.keys();
+	for (int i = 0; i < pids.size(); i++) {
+		if (now - active_.value(pids[i]).start_us > PROFILE_TIMEOUT)
+			finish(pids[i]);
+	}
+}
+
+void LaunchProfiler::finish(pid_t pid) {
+	if (processes_)
+		processes_->remove(pid);
+	LaunchSample sample = active_.take(pid).sample;
+	if (arg_debug)
+		printf("launch profile %s: spawn %lld us, sandbox %lld us, program %lld us, window %lld us\n",
+			sample.name.toLocal8Bit().constData(), (long long) sample.spawn_us,
+			(long long) sample.sandbox_us, (long long) sample.exec_us, (long long) sample.window_us);
+	save(sample);
+}
+
+// log format, one launch per line: time spawn_us sandbox_us exec_us window_us name
+void LaunchProfiler::save(const LaunchSample &sample) {
+	char *fname = log_file_name();
+	if (!fname)
+		return;
+	FILE *fp = fopen(fname, "ae");
+	free(fname);
+	if (!fp)
+		return;
+	fprintf(fp, "%lld %lld %lld %lld %lld %s\n", (long long) sample.time,
+		(long long) sample.spawn_us, (long long) sample.sandbox_us,
+		(long long) sample.exec_us, (long long) sample.window_us,
+		sample.name.toLocal8Bit().constData());
+	fclose(fp);
+}
+
+static bool sample_older(const LaunchSample &a, const LaunchSample &b) {
+	return a.time < b.time;
+}
+
+QList<LaunchSample> LaunchProfiler::load() {
+	QList<LaunchSample> rv;
+	char *fname = log_file_name();
+	if (!fname)
+		return rv;
+	FILE *fp = fopen(fname, "re");
+	if (!fp) {
+		free(fname);
+		return rv;
+	}
+
+	// the last LATENCY_RUNS samples of each application, in file order
+	QHash<QString, QList<LaunchSample> > apps;
+	QStringList order;
+	int lines = 0;
+	char *buf = NULL;
+	size_t size = 0;
+	while (getline(&buf, &size, fp) != -1) {
+		lines++;
+		char *ptr = strchr(buf, '\n');
+		if (ptr)
+			*ptr = '\0';
+		long long t, spawn, sandbox, exec, window;
+		int offset;
+		if (sscanf(buf, "%lld %lld %lld %lld %lld %n", &t, &spawn, &sandbox, &exec, &window, &offset) != 5 ||
+		    buf[offset] == '\0')
+			continue;
+
+		LaunchSample sample;
+		sample.name = QString::fromLocal8Bit(buf + offset);
+		sample.time = t;
+		sample.spawn_us = spawn;
+		sample.sandbox_us = sandbox;
+		sample.exec_us = exec;
+		sample.window_us = window;
+		QHash<QString, QList<LaunchSample> >::iterator it = apps.find(sample.name);
+		if (it == apps.end()) {
+			order.append(sample.name);
+			it = apps.insert(sample.name, QList<LaunchSample>());
+		}
+		it->append(sample);
+		if (it->size() > LATENCY_RUNS)
+			it->removeFirst();
+	}
+	free(buf);
+	fclose(fp);
+
+	for (int i = 0; i < order.size(); i++)
+		rv += apps.value(order.at(i));
+
+	// drop the old samples from the log
+	if (lines > LATENCY_MAXLINES) {
+		char *tmpname;
+		FILE *out = cache_open(fname, &tmpname);
+		if (out) {
+			// the samples kept are written back in launch order, with their timestamps
+			QList<LaunchSample> kept = rv;
+			std::stable_sort(kept.begin(), kept.end(), sample_older);
+			for (int i = 0; i < kept.size(); i++) {
+				const LaunchSample &s = kept.at(i);
+				fprintf(out, "%lld %lld %lld %lld %lld %s\n", (long long) s.time,
+					(long long) s.spawn_us, (long long) s.sandbox_us,
+					(long long) s.exec_us, (long long) s.window_us,
+					s.name.toLocal8Bit().constData());
+			}
+			cache_close(out, tmpname, fname);
+		}
+	}
+	free(fname);
+	return rv;
+}
+
+void LaunchProfiler::clear() {
+	char *fname = log_file_name();
+	if (fname)
+		unlink(fname);
+	free(fname);
+}
+
+//*************************************************************
+// process table
+//*************************************************************
+void ProcessWatcher::add(pid_t pid, const QByteArray &program) {
+	Entry entry;
+	// /proc/pid/comm is truncated to 15 characters
+	entry.program = program.left(15);
+	entry.sandbox = false;
+	entry.exec = false;
+	QMutexLocker locker(&mutex_);
+	entries_.insert(pid, entry);
+	added_.wakeOne();
+}
+
+void ProcessWatcher::remove(pid_t pid) {
+	QMutexLocker locker(&mutex_);
+	entries_.remove(pid);
+}
+
+void ProcessWatcher::stop() {
+	QMutexLocker locker(&mutex_);
+	stop_ = 1;
+	added_.wakeOne();
+}
+
+// a launch whose program was not found yet; called with the mutex locked
+bool ProcessWatcher::pending() const {
+	QHash<pid_t, Entry>::const_iterator it;
+	for (it = entries_.constBegin(); it != entries_.constEnd(); ++it) {
+		if (!it->exec)
+			return true;
+	}
+	return false;
+}
+
+// children of all the threads of a process
+static void read_children(pid_t pid, QList<pid_t> *children) {
+	char *dname;
+	if (asprintf(&dname, "/proc/%d/task", pid) == -1)
+		errExit("asprintf");
+	DIR *dir = opendir(dname);
+	free(dname);
+	if (!dir)
+		return;
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL) {
+		if (*entry->d_name == '.')
+			continue;
+		char *fname;
+		if (asprintf(&fname, "/proc/%d/task/%s/children", pid, entry->d_name) == -1)
+			errExit("asprintf");
+		FILE *fp = fopen(fname, "re");
+		free(fname);
+		if (!fp)
+			continue;
+		int child;
+		while (fscanf(fp, "%d", &child) == 1)
+			children->append(child);
+		fclose(fp);
+	}
+	closedir(dir);
+}
+
+// the program is searched breadth-first, a few levels under the firejail process
+static bool find_program(pid_t pid, const QByteArray &program, bool *sandbox) {
+	QList<pid_t> level;
+	read_children(pid, &level);
+	*sandbox = !level.isEmpty();
+
+	for (int depth = 0; depth < PROCESS_DEPTH && !level.isEmpty(); depth++) {
+		QList<pid_t> next;
+		for (int i = 0; i < level.size(); i++) {
+			char *comm = pid_proc_comm(level.at(i));
+			bool found = false;
+			if (comm) {
+				char *ptr = strchr(comm, '\n');
+				if (ptr)
+					*ptr = '\0';
+				found = program == comm;
+				free(comm);
+			}
+			if (found)
+				return true;
+			read_children(level.at(i), &next);
+		}
+		level = next;
+	}
+	return false;
+}
+
+void ProcessWatcher::run() {
+	while (!stop_) {
+		// the process table is not scanned while no launch is tracked
+		mutex_.lock();
+		while (!stop_ && !pending())
+			added_.wait(&mutex_);
+		QHash<pid_t, Entry> entries = entries_;
+		mutex_.unlock();
+
+		QHash<pid_t, Entry>::iterator it;
+		for (it = entries.begin(); it != entries.end() && !stop_; ++it) {
+			if (it->exec)
+				continue;
+			bool sandbox;
+			bool exec = find_program(it.key(), it->program, &sandbox);
+			qint64 now = LaunchProfiler::now_us();
+
+			// the sandbox is always reported first
+			if ((sandbox || exec) && !it->sandbox)
+				emit found(it.key(), FOUND_SANDBOX, now);
+			if (exec)
+				emit found(it.key(), FOUND_PROGRAM, now);
+
+			QMutexLocker locker(&mutex_);
+			QHash<pid_t, Entry>::iterator entry = entries_.find(it.key());
+			if (entry != entries_.end()) {
+				entry->sandbox = entry->sandbox || sandbox || exec;
+				entry->exec = exec;
+			}
+		}
+
+		usleep(PROCESS_INTERVAL);
+	}
+}
+
+//*************************************************************
+// X11 windows
+//*************************************************************
+bool WindowWatcher::available() {
+	const char *display = getenv("DISPLAY");
+	return display && *display && pathdb_find("xprop");
+}
+
+void WindowWatcher::run() {
+	initialized_ = false;
+	known_.clear();
+	char *argv[] = { (char *) "xprop", (char *) "-root", (char *) "-spy", (char *) "_NET_CLIENT_LIST", NULL };
+	SubprocessResult res;
+	if (subprocess_run(argv, 0, 0, &cancel_, line, this, &res) == 0)
+		subprocess_free(&res);
+}
+
+int WindowWatcher::line(char *line, int is_stderr, void *arg) {
+	WindowWatcher *self = (WindowWatcher *) arg;
+	if (!is_stderr)
+		self->clientList(line);
+	return self->cancel_;
+}
+
+// _NET_CLIENT_LIST(WINDOW): window id # 0x1e00003, 0x2000007
+void WindowWatcher::clientList(char *line) {
+	qint64 now = LaunchProfiler::now_us();
+	char *ptr = strchr(line, '#');
+	if (!ptr)
+		return;
+
+	QList<QByteArray> ids;
+	char *saveptr;
+	char *tok = strtok_r(ptr + 1, ", ", &saveptr);
+	while (tok) {
+		ids.append(QByteArray(tok));
+		tok = strtok_r(NULL, ", ", &saveptr);
+	}
+
+	// the first line is the current list
+	QList<QByteArray> added;
+	if (initialized_) {
+		for (int i = 0; i < ids.size(); i++) {
+			if (!known_.contains(ids.at(i)))
+				added.append(ids.at(i));
+		}
+	}
+	known_ = ids;
+	initialized_ = true;
+
+	// WM_CLASS(STRING) = "instance", "Class"
+	for (int i = 0; i < added.size() && !cancel_; i++) {
+		char *argv[] = { (char *) "xprop", (char *) "-id", added[i].data(), (char *) "WM_CLASS", NULL };
+		SubprocessResult res;
+		if (subprocess_run(argv, SUBPROCESS_KEEP_OUT, 1000, &cancel_, NULL, NULL, &res) == -1)
+			continue;
+		QString names[2];
+		char *str = res.out;
+		for (int j = 0; j < 2 && str; j++) {
+			char *start = strchr(str, '"');
+			char *end = (start)? strchr(start + 1, '"'): NULL;
+			if (!end)
+				break;
+			names[j] = QString::fromLocal8Bit(start + 1, end - start - 1);
+			str = end + 1;
+		}
+		subprocess_free(&res);
+		if (arg_debug)
+			printf("window %s mapped: %s, %s\n", added[i].constData(),
+				names[0].toLocal8Bit().constData(), names[1].toLocal8Bit().constData());
+		emit windowMapped(names[0], names[1], now);
+	}
+}
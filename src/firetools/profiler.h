@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <sys/types.h>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+// One measured launch; all times are in microseconds from the double-click, -1 if the
+// event was not detected
+struct LaunchSample {
+	QString name;
+	qint64 time;		// unix time of the launch
+	qint64 spawn_us;	// firejail process started
+	qint64 sandbox_us;	// sandbox process found in the process table
+	qint64 exec_us;		// target program running in the sandbox
+	qint64 window_us;	// first window of the program mapped
+};
+
+class ProcessWatcher;
+class WindowWatcher;
+
+// Launch-latency profiler. When enabled, every launch is followed until the program shows
+// its first window: the processes under firejail are scanned in /proc by a background
+// thread for the sandbox and for the target program, and new X11 windows are reported by
+// "xprop -spy" on the root window and matched by WM_CLASS. Windows are not detected on
+// Wayland or without xprop; the measurement ends then at the program start.
+//
+// The samples are appended to ~/.config/firetools/launch-latency.log.
+class LaunchProfiler: public QObject {
+Q_OBJECT
+
+public:
+	LaunchProfiler(QObject *parent = 0);
+	~LaunchProfiler();
+
+	void setEnabled(bool enabled);
+	bool enabled() const {
+		return enabled_;
+	}
+
+	// follow a launch; argv is the command started, start_us the time of the click and
+	// spawn_us the time the process was started, both from now_us()
+	void track(QString name, const QList<QByteArray> &argv, pid_t pid, qint64 start_us, qint64 spawn_us);
+
+	// samples recorded so far, the last LATENCY_RUNS of each application
+	static QList<LaunchSample> load();
+	static void clear();
+	// monotonic clock
+	static qint64 now_us();
+
+public slots:
+	void appExited(QString name, pid_t pid, int status, qint64 runtime_ms);
+
+private slots:
+	void processFound(int pid, int what, qint64 when_us);
+	void windowMapped(QString instance, QString wmclass, qint64 when_us);
+	void checkTimeouts();
+
+private:
+	struct Measurement {
+		LaunchSample sample;
+		QByteArray program;	// basename of the target program, as in /proc/pid/comm
+		qint64 start_us;
+	};
+
+	void finish(pid_t pid);
+	static void save(const LaunchSample &sample);
+
+	bool enabled_;
+	QHash<pid_t, Measurement> active_;
+	ProcessWatcher *processes_;
+	WindowWatcher *windows_;	// NULL if windows cannot be detected
+};
+
+// process table scanner, runs while launches are tracked
+class ProcessWatcher: public QThread {
+Q_OBJECT
+
+public:
+	enum {
+		FOUND_SANDBOX = 0,
+		FOUND_PROGRAM
+	};
+
+	ProcessWatcher(QObject *parent = 0): QThread(parent), stop_(0) {}
+	void add(pid_t pid, const QByteArray &program);
+	void remove(pid_t pid);
+	void stop();
+
+signals:
+	void found(int pid, int what, qint64 when_us);
+
+protected:
+	void run();
+
+private:
+	struct Entry {
+		QByteArray program;
+		bool sandbox;	// already reported
+		bool exec;
+	};
+	bool pending() const;
+
+	QMutex mutex_;
+	QWaitCondition added_;	// the thread sleeps here while there is nothing to look for
+	QHash<pid_t, Entry> entries_;
+	volatile int stop_;
+};
+
+// new top-level X11 windows, from _NET_CLIENT_LIST changes
+class WindowWatcher: public QThread {
+Q_OBJECT
+
+public:
+	WindowWatcher(QObject *parent = 0): QThread(parent), cancel_(0) {}
+	// X11 session with xprop installed
+	static bool available();
+	void stop() {
+		cancel_ = 1;
+	}
+
+signals:
+	void windowMapped(QString instance, QString wmclass, qint64 when_us);
+
+protected:
+	void run();
+
+private:
+	static int line(char *line, int is_stderr, void *arg);
+	void clientList(char *line);
+
+	QList<QByteArray> known_;
+	bool initialized_;
+	volatile int cancel_;
+};
+
+#endif
@@ -25,10 +25,15 @@
 #define MINSIZE 500
 #define BUFSIZE 4096
 
-void config_read_screen_size(int *x, int *y) {
+// ~/.config/firetools/fmgr.config
+//	x <width>
+//	y <height>
+//	threads <number of scanner threads, 0 for the number of CPUs>
+static void read_config(int *x, int *y, int *threads) {
 	// set defaults
 	*x = DEFAULT_X_SIZE;
 	*y = DEFAULT_X_SIZE;
+	*threads = 0;
 
 	// open config file
 	char *cfgdir = get_config_directory();
@@ -64,11 +69,36 @@ void config_read_screen_size(int *x, int *y) {
 				return;
 			}
 		}
+		else if (strncmp(ptr, "threads ", 8) == 0) {
+			ptr += 8;
+			if (sscanf(ptr, "%d", threads) != 1 || *threads < 0) {
+				fprintf(stderr, "Error: invalid number of threads in ~/.config/firetools/fmgr.config\n");
+				*threads = 0;
+				fclose(fp);
+				return;
+			}
+		}
 	}
 	fclose(fp);
 }
 
+void config_read_screen_size(int *x, int *y) {
+	int threads;
+	read_config(x, y, &threads);
+}
+
+int config_read_threads() {
+	int x;
+	int y;
+	int threads;
+	read_config(&x, &y, &threads);
+	return threads;
+}
+
 void config_write_screen_size(int x, int y) {
+	// keep the other settings
+	int threads = config_read_threads();
+
 	x = (x < MINSIZE)? DEFAULT_X_SIZE: x;
 	y = (y < MINSIZE)? DEFAULT_Y_SIZE: y;
 	
@@ -87,5 +117,7 @@ void config_write_screen_size(int x, int y) {
 	// write file
 	fprintf(fp, "x %d\n", x);
 	fprintf(fp, "y %d\n", y);
+	if (threads > 0)
+		fprintf(fp, "threads %d\n", threads);
 	fclose(fp);
 }
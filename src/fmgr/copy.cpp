@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "copy.h"
+#include <errno.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <QMutexLocker>
+
+#define COPY_THREADS 4		// default; copying is limited by the disks, not by the CPUs
+
+// directory listing context
+struct CopyContext {
+	FileCopy *copy;
+	const FileCopy::Job *dir;
+};
+
+FileCopy::FileCopy(const Sandbox *sb, QThreadPool *pool, QObject *parent): QObject(parent), sb_(sb), pool_(pool),
+	cancel_(0), queue_(&cancel_), listing_(0) {
+	memset(&progress_, 0, sizeof(progress_));
+	connect(&queue_, SIGNAL(finished()), this, SLOT(workerDone()));
+}
+
+FileCopy::~FileCopy() {
+	stop();
+}
+
+void FileCopy::start(QString dir, QStringList names, QString dest, int threads) {
+	stop();
+	if (names.isEmpty())
+		return;
+	if (threads <= 0)
+		threads = COPY_THREADS;
+
+	cancel_ = 0;
+	names_.clear();
+	for (int i = 0; i < names.size(); i++)
+		names_.insert(names.at(i).toUtf8());
+	memset(&progress_, 0, sizeof(progress_));
+	errors_.clear();
+	created_.clear();
+
+	// the start directory is listed first, only the selected entries are queued
+	Job job;
+	job.src = dir.toUtf8();
+	while (job.src.size() > 1 && job.src.endsWith('/'))
+		job.src.chop(1);
+	job.dst = dest.toUtf8();
+	job.mode = 0;
+	job.size = 0;
+	listing_.storeRelease(1);
+	queue_.push(job);
+	queue_.start(pool_, threads, work_cb, this);
+}
+
+void FileCopy::cancel() {
+	if (!queue_.active())
+		return;
+	stop();
+	emit finished();
+}
+
+void FileCopy::stop() {
+	cancel_ = 1;
+	queue_.stop();
+	queue_.clear();
+	listing_.storeRelease(0);
+	restoreModes();
+}
+
+static int path_depth(const QByteArray &path) {
+	return path.count('/');
+}
+
+static bool deeper(const QPair<QByteArray, mode_t> &a, const QPair<QByteArray, mode_t> &b) {
+	return path_depth(a.first) > path_depth(b.first);
+}
+
+// the directories created by the copy get their original mode back, the deepest first:
+// a read-only parent must not stop the mode change of its subdirectories
+void FileCopy::restoreModes() {
+	std::stable_sort(created_.begin(), created_.end(), deeper);
+	for (int i = 0; i < created_.size(); i++) {
+		int fd = open(created_.at(i).first.constData(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (fd == -1 || fchmod(fd, created_.at(i).second) == -1)
+			addError(created_.at(i).first, errno);
+		if (fd != -1)
+			close(fd);
+	}
+	created_.clear();
+}
+
+// the last task returned; stale notifications of a cancelled copy are ignored
+void FileCopy::workerDone() {
+	if (!queue_.active() || queue_.busy())
+		return;
+	stop();
+	emit finished();
+}
+
+FileCopy::Progress FileCopy::progress() {
+	QMutexLocker locker(&progress_mutex_);
+	Progress rv = progress_;
+	rv.scanning = listing_.loadAcquire() != 0;
+	return rv;
+}
+
+QStringList FileCopy::errors() {
+	QMutexLocker locker(&progress_mutex_);
+	return errors_;
+}
+
+void FileCopy::addError(const QByteArray &path, int err) {
+	QMutexLocker locker(&progress_mutex_);
+	errors_.append(QString::fromUtf8(path) + ": " + QString::fromLocal8Bit(strerror(err)));
+}
+
+int FileCopy::progress_cb(uint64_t bytes, void *arg) {
+	FileCopy *copy = (FileCopy *) arg;
+	QMutexLocker locker(&copy->progress_mutex_);
+	copy->progress_.bytes += bytes;
+	return copy->cancel_;
+}
+
+int FileCopy::entry_cb(const SandboxEntry *entry, void *arg) {
+	CopyContext *ctx = (CopyContext *) arg;
+	FileCopy *copy = ctx->copy;
+	if (copy->cancel_)
+		return 1;
+	if (ctx->dir->mode == 0 && !copy->names_.contains(QByteArray(entry->name)))
+		return 0;
+	// devices, sockets and pipes are not copied
+	if (!S_ISREG(entry->mode) && !S_ISDIR(entry->mode) && !S_ISLNK(entry->mode))
+		return 0;
+
+	Job job;
+	job.src = ctx->dir->src;
+	if (!job.src.endsWith('/'))
+		job.src += '/';
+	job.src += entry->name;
+	job.dst = ctx->dir->dst + '/' + entry->name;
+	job.mode = entry->mode;
+	job.size = entry->size;
+	if (S_ISLNK(entry->mode) && entry->target)
+		job.target = entry->target;
+	if (S_ISDIR(entry->mode)) {
+		if (sandbox_virtual_dir(job.src.constData()))
+			return 0;
+		copy->listing_.ref();
+	}
+	else {
+		QMutexLocker locker(&copy->progress_mutex_);
+		copy->progress_.total_files++;
+		if (S_ISREG(entry->mode))
+			copy->progress_.total += entry->size;
+	}
+
+	// the files found early keep the threads busy while listing
+	copy->queue_.push(job, !S_ISDIR(entry->mode));
+	return 0;
+}
+
+void FileCopy::run(const Job &job) {
+	if (S_ISLNK(job.mode)) {
+		if (job.target.isEmpty())
+			addError(job.src, EINVAL);
+		else if (symlink(job.target.constData(), job.dst.constData()) == -1)
+			addError(job.dst, errno);
+	}
+	else if (S_ISREG(job.mode)) {
+		if (sandbox_copy(sb_, job.src.constData(), job.dst.constData(), progress_cb, this, &cancel_) == -1) {
+			if (errno != ECANCELED)
+				addError(job.src, errno);
+			return;
+		}
+	}
+	else {
+		// the directory must stay writable until the files are copied, the mode is
+		// restored at the end, see restoreModes()
+		if (job.mode) {
+			if (mkdir(job.dst.constData(), (job.mode & 0777) | 0700) == 0) {
+				QMutexLocker locker(&progress_mutex_);
+				created_.append(qMakePair(job.dst, (mode_t) (job.mode & 07777)));
+			}
+			else if (errno != EEXIST) {
+				addError(job.dst, errno);
+				listing_.deref();
+				return;
+			}
+		}
+		CopyContext ctx;
+		ctx.copy = this;
+		ctx.dir = &job;
+		if (sandbox_list(sb_, job.src.constData(), entry_cb, &ctx, &cancel_) == -1 && !cancel_)
+			addError(job.src, errno);
+		listing_.deref();
+		return;
+	}
+
+	QMutexLocker locker(&progress_mutex_);
+	progress_.files++;
+}
+
+void FileCopy::work_cb(void *arg) {
+	((FileCopy *) arg)->work();
+}
+
+void FileCopy::work() {
+	Job job;
+	// the files are queued in front of the directories
+	while (queue_.pop(&job, true)) {
+		run(job);
+		queue_.done();
+	}
+}
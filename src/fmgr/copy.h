@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef COPY_H
+#define COPY_H
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include "sandbox.h"
+#include "workqueue.h"
+
+class QThreadPool;
+
+// Copy files and directories out of the sandbox. The selected entries are walked by a few
+// tasks in the scan thread pool, sharing one queue: directories are created on the host and listed, files are
+// copied with sandbox_copy as soon as they are found. Existing files are never replaced.
+// The progress can be read at any time while the copy is running.
+class FileCopy: public QObject {
+Q_OBJECT
+
+public:
+	FileCopy(const Sandbox *sb, QThreadPool *pool, QObject *parent = 0);
+	~FileCopy();
+
+	// copy dir + names[i] into the host directory dest; threads <= 0 selects the default
+	void start(QString dir, QStringList names, QString dest, int threads);
+	// stop the copy and wait for the threads
+	void cancel();
+	bool running() const {
+		return queue_.active();
+	}
+
+	struct Progress {
+		quint64 bytes;		// copied so far, the holes of sparse files included
+		quint64 total;		// size of the files found so far
+		int files;
+		int total_files;
+		bool scanning;		// some directories are not listed yet
+	};
+	Progress progress();
+	QStringList errors();
+
+signals:
+	// all the files were copied, or the copy was cancelled
+	void finished();
+
+private slots:
+	void workerDone();
+
+private:
+	struct Job {
+		QByteArray src;		// sandbox path
+		QByteArray dst;		// host path
+		mode_t mode;		// 0 for the directory passed to start()
+		quint64 size;
+		QByteArray target;	// symlink target
+	};
+
+	void stop();
+	void work();
+	void run(const Job &job);
+	void addError(const QByteArray &path, int err);
+	void restoreModes();
+	static void work_cb(void *arg);
+	static int entry_cb(const SandboxEntry *entry, void *arg);
+	static int progress_cb(uint64_t bytes, void *arg);
+
+	const Sandbox *sb_;
+	QThreadPool *pool_;
+	volatile int cancel_;
+	WorkQueue<Job> queue_;		// files in front, directories at the back
+	QSet<QByteArray> names_;	// selected entries in the start directory
+
+	QAtomicInt listing_;		// directories queued or being listed
+
+	QMutex progress_mutex_;
+	Progress progress_;
+	QStringList errors_;
+	QList<QPair<QByteArray, mode_t> > created_;	// directories created, with the original mode
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "copydialog.h"
+#include "copy.h"
+#include "../common/utils.h"
+
+#include <QtGlobal>
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
+
+#define COPY_UPDATE 250		// progress update, ms
+
+CopyDialog::CopyDialog(const Sandbox *sb, QThreadPool *pool, QWidget *parent): QDialog(parent), last_bytes_(0),
+	last_ms_(0), rate_(0) {
+	copy_ = new FileCopy(sb, pool, this);
+	connect(copy_, SIGNAL(finished()), this, SLOT(copyDone()));
+	timer_ = new QTimer(this);
+	connect(timer_, SIGNAL(timeout()), this, SLOT(showProgress()));
+
+	label_ = new QLabel(this);
+	bar_ = new QProgressBar(this);
+	bar_->setRange(0, 1000);
+	errors_ = new QPlainTextEdit(this);
+	errors_->setReadOnly(true);
+	errors_->hide();
+	button_ = new QPushButton(tr("Cancel"), this);
+	connect(button_, SIGNAL(clicked()), this, SLOT(handleButton()));
+
+	QVBoxLayout *layout = new QVBoxLayout;
+	layout->addWidget(label_);
+	layout->addWidget(bar_);
+	layout->addWidget(errors_);
+	layout->addWidget(button_, 0, Qt::AlignRight);
+	setLayout(layout);
+	setMinimumWidth(450);
+	setWindowTitle(tr("Copy to host"));
+}
+
+CopyDialog::~CopyDialog() {
+	stop();
+}
+
+void CopyDialog::start(QString dir, QStringList names, QString dest) {
+	elapsed_.start();
+	last_bytes_ = 0;
+	last_ms_ = 0;
+	rate_ = 0;
+	copy_->start(dir, names, dest, config_read_threads());
+	label_->setText(tr("Copying to %1").arg(dest));
+	timer_->start(COPY_UPDATE);
+}
+
+// the copy threads read the sandbox filesystem, stop them before closing the sandbox
+void CopyDialog::stop() {
+	copy_->cancel();
+}
+
+void CopyDialog::showProgress() {
+	FileCopy::Progress p = copy_->progress();
+	qint64 ms = elapsed_.elapsed();
+	if (ms > last_ms_) {
+		double rate = (double) (p.bytes - last_bytes_) * 1000 / (ms - last_ms_);
+		rate_ = (rate_ == 0)? rate: rate_ * 0.7 + rate * 0.3;
+		last_bytes_ = p.bytes;
+		last_ms_ = ms;
+	}
+
+	// the total keeps growing while directories are listed
+	if (p.total)
+		bar_->setValue((int) (p.bytes * 1000 / p.total));
+	char bytes[HUMAN_SIZE_MAX];
+	char total[HUMAN_SIZE_MAX];
+	char rate[HUMAN_SIZE_MAX];
+	QString txt = tr("%1 of %2%3, %4 of %5 files, %6/s")
+		.arg(human_size(p.bytes, bytes))
+		.arg(human_size(p.total, total))
+		.arg(p.scanning ? "+" : "")
+		.arg(p.files)
+		.arg(p.total_files)
+		.arg(human_size(rate_, rate));
+	label_->setText(txt);
+}
+
+void CopyDialog::copyDone() {
+	timer_->stop();
+	FileCopy::Progress p = copy_->progress();
+	double seconds = elapsed_.elapsed() / 1000.0;
+	char buf[HUMAN_SIZE_MAX];
+	QString txt = tr("%1 in %2 files copied in %3 s").arg(human_size(p.bytes, buf)).arg(p.files).arg(seconds, 0, 'f', 1);
+	if (seconds > 0)
+		txt += QString(", %1/s").arg(human_size(p.bytes / seconds, buf));
+	label_->setText(txt);
+	if (p.bytes == p.total)
+		bar_->setValue(1000);
+
+	QStringList errors = copy_->errors();
+	if (!errors.isEmpty()) {
+		errors_->setPlainText(errors.join("\n"));
+		errors_->show();
+	}
+	button_->setText(tr("Close"));
+}
+
+void CopyDialog::handleButton() {
+	if (copy_->running())
+		copy_->cancel();
+	else
+		close();
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef COPYDIALOG_H
+#define COPYDIALOG_H
+#include <QDialog>
+#include <QElapsedTimer>
+#include <QStringList>
+#include "sandbox.h"
+
+class QLabel;
+class QProgressBar;
+class QPushButton;
+class QPlainTextEdit;
+class QTimer;
+class QThreadPool;
+class FileCopy;
+
+// progress of a copy out of the sandbox: bytes, files, throughput; the errors are listed
+// when the copy is done
+class CopyDialog: public QDialog {
+Q_OBJECT
+
+public:
+	CopyDialog(const Sandbox *sb, QThreadPool *pool, QWidget *parent = 0);
+	~CopyDialog();
+	void start(QString dir, QStringList names, QString dest);
+	void stop();
+
+private slots:
+	void showProgress();
+	void copyDone();
+	void handleButton();
+
+private:
+	FileCopy *copy_;
+	QLabel *label_;
+	QProgressBar *bar_;
+	QPlainTextEdit *errors_;
+	QPushButton *button_;
+	QTimer *timer_;
+	QElapsedTimer elapsed_;
+	quint64 last_bytes_;
+	qint64 last_ms_;
+	double rate_;		// bytes per second, smoothed
+};
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "diff.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <QHash>
+#include <QMutexLocker>
+#include <QSet>
+#include <QVector>
+
+#define HASH_BUFSIZE (1024 * 1024)
+
+// XXH64 constants
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+	acc += input * PRIME2;
+	acc = rotl(acc, 31);
+	return acc * PRIME1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t val) {
+	acc ^= xxh_round(0, val);
+	return acc * PRIME1 + PRIME4;
+}
+
+// XXH64 of one buffer; files are hashed one buffer at a time, the hash of the previous
+// buffer is the seed of the next one
+static uint64_t xxh64(const unsigned char *p, size_t len, uint64_t seed) {
+	const unsigned char *end = p + len;
+	uint64_t h;
+	if (len >= 32) {
+		uint64_t v1 = seed + PRIME1 + PRIME2;
+		uint64_t v2 = seed + PRIME2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME1;
+		do {
+			v1 = xxh_round(v1, read64(p));
+			v2 = xxh_round(v2, read64(p + 8));
+			v3 = xxh_round(v3, read64(p + 16));
+			v4 = xxh_round(v4, read64(p + 24));
+			p += 32;
+		} while (p <= end - 32);
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = xxh_merge(h, v1);
+		h = xxh_merge(h, v2);
+		h = xxh_merge(h, v3);
+		h = xxh_merge(h, v4);
+	}
+	else
+		h = seed + PRIME5;
+
+	h += len;
+	for (; p + 8 <= end; p += 8) {
+		h ^= xxh_round(0, read64(p));
+		h = rotl(h, 27) * PRIME1 + PRIME4;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t) read32(p) * PRIME1;
+		h = rotl(h, 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * PRIME5;
+		h = rotl(h, 11) * PRIME1;
+	}
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+// hash an open file; returns 0, or -1 with errno set if the file cannot be read
+// the buffer is filled before it is hashed: the blocks, and the hash, don't depend on
+// how the reads are split
+static int hash_fd(int fd, volatile int *cancel, quint64 *hash) {
+	unsigned char *buf = (unsigned char *) malloc(HASH_BUFSIZE);
+	if (!buf)
+		errExit("malloc");
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	uint64_t h = 0;
+	int rv = 0;
+	int err = 0;
+	bool eof = false;
+	while (!eof && rv == 0) {
+		size_t fill = 0;
+		while (fill < HASH_BUFSIZE) {
+			ssize_t len = read(fd, buf + fill, HASH_BUFSIZE - fill);
+			if (len == 0) {
+				eof = true;
+				break;
+			}
+			if (len == -1) {
+				if (errno == EINTR)
+					continue;
+				err = errno;
+				rv = -1;
+				break;
+			}
+			fill += len;
+		}
+		if (rv == 0 && *cancel) {
+			err = ECANCELED;
+			rv = -1;
+		}
+		if (rv == 0 && fill)
+			h = xxh64(buf, fill, h);
+	}
+	free(buf);
+	close(fd);
+	*hash = h;
+	if (rv == -1)
+		errno = err;
+	return rv;
+}
+
+// sandbox side listing
+struct DiffContext {
+	DirDiff *diff;
+	QVector<DirDiff::Entry> *entries;
+};
+
+DirDiff::DirDiff(const Sandbox *sb, QThreadPool *pool, QObject *parent): QObject(parent), sb_(sb), pool_(pool),
+	cancel_(0), queue_(&cancel_), hash_(false), compared_(0) {
+	connect(&queue_, SIGNAL(finished()), this, SLOT(workerDone()));
+}
+
+DirDiff::~DirDiff() {
+	stop();
+}
+
+void DirDiff::start(QString dir, bool hash, int threads) {
+	stop();
+	cancel_ = 0;
+	// the contents can be read only with direct access
+	hash_ = hash && sandbox_direct(sb_);
+	results_.clear();
+	compared_.storeRelease(0);
+
+	Job job;
+	job.path = dir.toUtf8();
+	while (job.path.size() > 1 && job.path.endsWith('/'))
+		job.path.chop(1);
+	job.hash = false;
+	queue_.push(job);
+	queue_.start(pool_, threads, work_cb, this);
+}
+
+void DirDiff::cancel() {
+	if (!queue_.active())
+		return;
+	stop();
+	emit finished();
+}
+
+void DirDiff::stop() {
+	cancel_ = 1;
+	queue_.stop();
+	queue_.clear();
+}
+
+// the last task returned; stale notifications of a cancelled scan are ignored
+void DirDiff::workerDone() {
+	if (!queue_.active() || queue_.busy())
+		return;
+	stop();
+	emit finished();
+}
+
+QList<DirDiff::Result> DirDiff::take() {
+	QMutexLocker locker(&results_mutex_);
+	QList<Result> rv;
+	rv.swap(results_);
+	return rv;
+}
+
+void DirDiff::addResult(const QByteArray &path, int status, int changes, const Info *sandbox, const Info *host) {
+	Result result;
+	result.path = QString::fromUtf8(path);
+	result.status = status;
+	result.changes = changes;
+	result.error = 0;
+	memset(&result.sandbox, 0, sizeof(Info));
+	memset(&result.host, 0, sizeof(Info));
+	if (sandbox)
+		result.sandbox = *sandbox;
+	if (host)
+		result.host = *host;
+
+	QMutexLocker locker(&results_mutex_);
+	results_.append(result);
+}
+
+void DirDiff::addError(const QByteArray &path, int err, const Info *sandbox, const Info *host) {
+	Result result;
+	result.path = QString::fromUtf8(path);
+	result.status = DIFF_ERROR;
+	result.changes = 0;
+	result.error = err;
+	memset(&result.sandbox, 0, sizeof(Info));
+	memset(&result.host, 0, sizeof(Info));
+	if (sandbox)
+		result.sandbox = *sandbox;
+	if (host)
+		result.host = *host;
+
+	QMutexLocker locker(&results_mutex_);
+	results_.append(result);
+}
+
+// the directories are listed before the contents are hashed, the differences
+// found by metadata show up first
+void DirDiff::queue(const Job &job) {
+	queue_.push(job, job.hash);
+}
+
+int DirDiff::entry_cb(const SandboxEntry *entry, void *arg) {
+	DiffContext *ctx = (DiffContext *) arg;
+	if (ctx->diff->cancel_)
+		return 1;
+	Entry e;
+	e.name = entry->name;
+	e.info.mode = entry->mode;
+	e.info.size = entry->size;
+	e.info.mtime = entry->mtime;
+	e.dev = entry->dev;
+	e.ino = entry->ino;
+	ctx->entries->append(e);
+	return 0;
+}
+
+void DirDiff::compareDir(const QByteArray &path) {
+	QByteArray prefix = path;
+	if (!prefix.endsWith('/'))
+		prefix += '/';
+
+	// sandbox
+	QVector<Entry> sandbox;
+	DiffContext ctx;
+	ctx.diff = this;
+	ctx.entries = &sandbox;
+	int rv = sandbox_list(sb_, path.constData(), entry_cb, &ctx, &cancel_);
+	if (cancel_)
+		return;
+	// a directory that cannot be read is reported as such, its entries are not
+	// missing from the sandbox
+	if (rv == -1) {
+		addError(path, errno, NULL, NULL);
+		return;
+	}
+
+	// host
+	QVector<Entry> host;
+	QHash<QByteArray, int> lookup;
+	QSet<QByteArray> unreadable;		// host entries that cannot be compared
+	DIR *dir = opendir(path.constData());
+	if (!dir && errno != ENOENT) {
+		addError(path, errno, NULL, NULL);
+		return;
+	}
+	if (dir) {
+		struct dirent *d;
+		while ((d = readdir(dir))) {
+			if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+				continue;
+			struct stat s;
+			if (fstatat(dirfd(dir), d->d_name, &s, AT_SYMLINK_NOFOLLOW) == -1) {
+				// the entry exists, it is not reported as missing on the host
+				addError(prefix + d->d_name, errno, NULL, NULL);
+				unreadable.insert(QByteArray(d->d_name));
+				continue;
+			}
+			Entry e;
+			e.name = d->d_name;
+			e.info.mode = s.st_mode;
+			e.info.size = s.st_size;
+			e.info.mtime = s.st_mtim.tv_sec;
+			e.dev = s.st_dev;
+			e.ino = s.st_ino;
+			lookup.insert(e.name, host.size());
+			host.append(e);
+		}
+		closedir(dir);
+	}
+
+	QVector<bool> seen(host.size(), false);
+	for (int i = 0; i < sandbox.size() && !cancel_; i++) {
+		const Entry &sb = sandbox.at(i);
+		QByteArray fname = prefix + sb.name;
+		QHash<QByteArray, int>::const_iterator it = lookup.constFind(sb.name);
+		if (it == lookup.constEnd()) {
+			if (unreadable.contains(sb.name))
+				continue;
+			addResult(fname, DIFF_ADDED, 0, &sb.info, NULL);
+			continue;
+		}
+		seen[it.value()] = true;
+		const Entry &h = host.at(it.value());
+
+		// the same file, for example a directory mounted from the host
+		if (sb.dev && sb.ino && sb.dev == h.dev && sb.ino == h.ino)
+			continue;
+
+		int changes = 0;
+		if ((sb.info.mode & S_IFMT) != (h.info.mode & S_IFMT))
+			changes = CHANGE_TYPE;
+		else if (S_ISDIR(sb.info.mode)) {
+			if (!sandbox_virtual_dir(fname.constData())) {
+				Job job;
+				job.path = fname;
+				job.hash = false;
+				queue(job);
+			}
+			continue;
+		}
+		else if (S_ISREG(sb.info.mode) || S_ISLNK(sb.info.mode)) {
+			if (sb.info.size != h.info.size)
+				changes = CHANGE_SIZE;
+			else if (sb.info.mtime && sb.info.mtime != h.info.mtime) {
+				if (hash_ && S_ISREG(sb.info.mode)) {
+					if (sb.info.size == 0)
+						continue;
+					Job job;
+					job.path = fname;
+					job.hash = true;
+					job.result.status = DIFF_MODIFIED;
+					job.result.changes = CHANGE_MTIME | CHANGE_CONTENT;
+					job.result.sandbox = sb.info;
+					job.result.host = h.info;
+					queue(job);
+					continue;
+				}
+				changes = CHANGE_MTIME;
+			}
+		}
+		if (changes)
+			addResult(fname, DIFF_MODIFIED, changes, &sb.info, &h.info);
+	}
+
+	for (int i = 0; i < host.size() && !cancel_; i++) {
+		if (!seen.at(i))
+			addResult(prefix + host.at(i).name, DIFF_REMOVED, 0, NULL, &host.at(i).info);
+	}
+	compared_.fetchAndAddRelaxed(sandbox.size() + host.size());
+}
+
+int DirDiff::hashSandbox(const QByteArray &path, quint64 *hash) {
+	int fd = sandbox_openat(sb_, path.constData(), O_RDONLY | O_NOFOLLOW);
+	if (fd == -1)
+		return -1;
+	return hash_fd(fd, &cancel_, hash);
+}
+
+int DirDiff::hashHost(const QByteArray &path, quint64 *hash) {
+	int fd = open(path.constData(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1)
+		return -1;
+	return hash_fd(fd, &cancel_, hash);
+}
+
+// files with the same size and a different modification time
+void DirDiff::compareContent(const Job &job) {
+	quint64 sandbox;
+	quint64 host;
+	if (hashSandbox(job.path, &sandbox) == -1 || hashHost(job.path, &host) == -1) {
+		// a file that cannot be read is not reported as modified
+		if (!cancel_)
+			addError(job.path, errno, &job.result.sandbox, &job.result.host);
+		return;
+	}
+	if (sandbox == host || cancel_)
+		return;
+	addResult(job.path, DIFF_MODIFIED, job.result.changes, &job.result.sandbox, &job.result.host);
+}
+
+void DirDiff::work_cb(void *arg) {
+	((DirDiff *) arg)->work();
+}
+
+void DirDiff::work() {
+	Job job;
+	while (queue_.pop(&job)) {
+		if (job.hash)
+			compareContent(job);
+		else
+			compareDir(job.path);
+		queue_.done();
+	}
+}
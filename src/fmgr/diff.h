@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DIFF_H
+#define DIFF_H
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include "sandbox.h"
+#include "workqueue.h"
+
+class QThreadPool;
+
+// Compare a directory tree as seen in the sandbox with the same tree on the host. Both sides
+// are listed together, one directory at a time, by a few tasks in the scan thread pool
+// sharing one queue. Entries
+// are compared by (dev, ino), size and modification time; when the metadata is not enough,
+// the contents can be compared with a fast non-cryptographic hash. Only the differences are
+// reported, the GUI takes them while the scan is running.
+class DirDiff: public QObject {
+Q_OBJECT
+
+public:
+	enum {
+		DIFF_ADDED = 0,		// only in the sandbox
+		DIFF_REMOVED,		// only on the host
+		DIFF_MODIFIED,
+		DIFF_ERROR		// a directory could not be listed or a file could not be read
+	};
+
+	// what is different in a modified entry, bitmask
+	enum {
+		CHANGE_TYPE = 0x01,
+		CHANGE_SIZE = 0x02,
+		CHANGE_MTIME = 0x04,
+		CHANGE_CONTENT = 0x08
+	};
+
+	struct Info {
+		mode_t mode;		// 0 if the entry doesn't exist
+		quint64 size;
+		qint64 mtime;		// 0 if not known
+	};
+
+	struct Result {
+		QString path;
+		int status;
+		int changes;
+		int error;		// DIFF_ERROR: errno
+		Info sandbox;
+		Info host;
+	};
+
+	DirDiff(const Sandbox *sb, QThreadPool *pool, QObject *parent = 0);
+	~DirDiff();
+
+	// compare dir recursively; with hash, files with the same size and a different
+	// modification time are compared by content
+	void start(QString dir, bool hash, int threads);
+	void cancel();
+	bool running() const {
+		return queue_.active();
+	}
+
+	// differences found since the last call
+	QList<Result> take();
+	// entries compared so far
+	int compared() const {
+		return compared_.loadAcquire();
+	}
+
+signals:
+	void finished();
+
+private slots:
+	void workerDone();
+
+private:
+	struct Entry {
+		QByteArray name;
+		Info info;
+		quint64 dev;
+		quint64 ino;
+	};
+
+	struct Job {
+		QByteArray path;
+		bool hash;		// compare the contents of a file, otherwise list a directory
+		Result result;		// hash jobs: the result reported if the contents are different
+	};
+
+	void stop();
+	void work();
+	void compareDir(const QByteArray &path);
+	void compareContent(const Job &job);
+	void addResult(const QByteArray &path, int status, int changes, const Info *sandbox, const Info *host);
+	void addError(const QByteArray &path, int err, const Info *sandbox, const Info *host);
+	void queue(const Job &job);
+	static void work_cb(void *arg);
+	int hashSandbox(const QByteArray &path, quint64 *hash);
+	int hashHost(const QByteArray &path, quint64 *hash);
+	static int entry_cb(const SandboxEntry *entry, void *arg);
+
+	const Sandbox *sb_;
+	QThreadPool *pool_;
+	volatile int cancel_;
+	WorkQueue<Job> queue_;		// hash jobs in front, directories at the back
+	bool hash_;
+
+	QAtomicInt compared_;
+
+	QMutex results_mutex_;
+	QList<Result> results_;
+};
+
+#endif
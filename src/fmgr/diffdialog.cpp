@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "diffdialog.h"
+#include "diff.h"
+#include <sys/stat.h>
+
+#include <QtGlobal>
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
+
+#define DIFF_UPDATE 250		// result table update, ms
+
+// differences found so far; rows are only appended while the scan is running
+class DiffModel: public QAbstractTableModel {
+public:
+	enum {
+		COL_STATUS = 0,
+		COL_PATH,
+		COL_SANDBOX,
+		COL_HOST,
+		COL_MAX
+	};
+
+	DiffModel(QObject *parent): QAbstractTableModel(parent) {}
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const {
+		return (parent.isValid())? 0: rows_.size();
+	}
+	int columnCount(const QModelIndex &parent = QModelIndex()) const {
+		return (parent.isValid())? 0: COL_MAX;
+	}
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+	void clear() {
+		beginResetModel();
+		rows_.clear();
+		endResetModel();
+	}
+	void append(const QList<DirDiff::Result> &results) {
+		if (results.isEmpty())
+			return;
+		beginInsertRows(QModelIndex(), rows_.size(), rows_.size() + results.size() - 1);
+		rows_ += results;
+		endInsertRows();
+	}
+
+private:
+	static QString describe(const DirDiff::Info &info);
+	QList<DirDiff::Result> rows_;
+};
+
+QString DiffModel::describe(const DirDiff::Info &info) {
+	if (info.mode == 0)
+		return QString();
+	QString rv;
+	if (S_ISDIR(info.mode))
+		rv = QObject::tr("directory");
+	else if (S_ISLNK(info.mode))
+		rv = QObject::tr("link");
+	else
+		rv = QString::number(info.size);
+	if (info.mtime)
+		rv += "  " + QDateTime::fromTime_t(info.mtime).toString("yyyy-MM-dd hh:mm:ss");
+	return rv;
+}
+
+QVariant DiffModel::data(const QModelIndex &index, int role) const {
+	if (!index.isValid() || index.row() >= rows_.size())
+		return QVariant();
+	const DirDiff::Result &r = rows_.at(index.row());
+
+	if (role == Qt::ForegroundRole) {
+		if (r.status == DirDiff::DIFF_ADDED)
+			return QColor(Qt::darkGreen);
+		if (r.status == DirDiff::DIFF_REMOVED)
+			return QColor(Qt::darkRed);
+		if (r.status == DirDiff::DIFF_ERROR)
+			return QColor(Qt::darkYellow);
+		return QVariant();
+	}
+	if (role != Qt::DisplayRole)
+		return QVariant();
+
+	switch (index.column()) {
+		case COL_STATUS: {
+			if (r.status == DirDiff::DIFF_ADDED)
+				return QObject::tr("Sandbox only");
+			if (r.status == DirDiff::DIFF_REMOVED)
+				return QObject::tr("Host only");
+			if (r.status == DirDiff::DIFF_ERROR)
+				return QObject::tr("Error") + " (" + QString::fromLocal8Bit(strerror(r.error)) + ")";
+			QStringList changes;
+			if (r.changes & DirDiff::CHANGE_TYPE)
+				changes << QObject::tr("type");
+			if (r.changes & DirDiff::CHANGE_SIZE)
+				changes << QObject::tr("size");
+			if (r.changes & DirDiff::CHANGE_MTIME)
+				changes << QObject::tr("time");
+			if (r.changes & DirDiff::CHANGE_CONTENT)
+				changes << QObject::tr("content");
+			return QObject::tr("Modified") + " (" + changes.join(", ") + ")";
+		}
+		case COL_PATH:
+			return r.path;
+		case COL_SANDBOX:
+			return describe(r.sandbox);
+		case COL_HOST:
+			return describe(r.host);
+	}
+	return QVariant();
+}
+
+QVariant DiffModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant();
+	switch (section) {
+		case COL_STATUS:
+			return QObject::tr("Status");
+		case COL_PATH:
+			return QObject::tr("Path");
+		case COL_SANDBOX:
+			return QObject::tr("Sandbox");
+		case COL_HOST:
+			return QObject::tr("Host");
+	}
+	return QVariant();
+}
+
+DiffDialog::DiffDialog(const Sandbox *sb, QThreadPool *pool, QString dir, QWidget *parent): QDialog(parent),
+	sb_(sb), dir_(dir) {
+	diff_ = new DirDiff(sb, pool, this);
+	connect(diff_, SIGNAL(finished()), this, SLOT(diffDone()));
+	timer_ = new QTimer(this);
+	connect(timer_, SIGNAL(timeout()), this, SLOT(showResults()));
+
+	model_ = new DiffModel(this);
+	table_ = new QTableView(this);
+	table_->setModel(model_);
+	table_->verticalHeader()->setVisible(false);
+	table_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	table_->verticalHeader()->setDefaultSectionSize(table_->fontMetrics().height() + 8);
+	table_->setColumnWidth(DiffModel::COL_STATUS, 160);
+	table_->setColumnWidth(DiffModel::COL_PATH, 350);
+	table_->setColumnWidth(DiffModel::COL_SANDBOX, 200);
+	table_->horizontalHeader()->setStretchLastSection(true);
+	table_->setShowGrid(false);
+	table_->setSelectionBehavior(QAbstractItemView::SelectRows);
+	table_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+	hash_ = new QCheckBox(tr("Compare contents"), this);
+	hash_->setToolTip(tr("Files with the same size and a different time are compared by content"));
+	hash_->setEnabled(sandbox_direct(sb));
+	status_ = new QLabel(this);
+	button_ = new QPushButton(tr("Compare"), this);
+	connect(button_, SIGNAL(clicked()), this, SLOT(handleCompare()));
+
+	QGridLayout *layout = new QGridLayout;
+	layout->addWidget(table_, 0, 0, 1, 3);
+	layout->addWidget(status_, 1, 0);
+	layout->addWidget(hash_, 1, 1);
+	layout->addWidget(button_, 1, 2);
+	layout->setColumnStretch(0, 10);
+	setLayout(layout);
+	resize(900, 500);
+	setWindowTitle(tr("Sandbox and host: %1").arg(dir));
+}
+
+DiffDialog::~DiffDialog() {
+	stop();
+}
+
+// the scan threads read the sandbox filesystem, stop them before closing the sandbox
+void DiffDialog::stop() {
+	diff_->cancel();
+}
+
+// start comparing, or stop the scan in progress
+void DiffDialog::handleCompare() {
+	if (diff_->running()) {
+		diff_->cancel();
+		return;
+	}
+	model_->clear();
+	diff_->start(dir_, hash_->isChecked(), config_read_threads());
+	button_->setText(tr("Stop"));
+	hash_->setEnabled(false);
+	timer_->start(DIFF_UPDATE);
+}
+
+void DiffDialog::showResults() {
+	model_->append(diff_->take());
+	status_->setText(tr("%1 entries compared, %2 differences").arg(diff_->compared()).arg(model_->rowCount()));
+}
+
+void DiffDialog::diffDone() {
+	timer_->stop();
+	showResults();
+	button_->setText(tr("Compare"));
+	hash_->setEnabled(sandbox_direct(sb_));
+}
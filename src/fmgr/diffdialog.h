@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DIFFDIALOG_H
+#define DIFFDIALOG_H
+#include <QDialog>
+#include <QString>
+#include "sandbox.h"
+
+class QCheckBox;
+class QLabel;
+class QPushButton;
+class QTableView;
+class QTimer;
+class QThreadPool;
+class DirDiff;
+class DiffModel;
+
+// differences between a sandbox directory and the same directory on the host
+class DiffDialog: public QDialog {
+Q_OBJECT
+
+public:
+	DiffDialog(const Sandbox *sb, QThreadPool *pool, QString dir, QWidget *parent = 0);
+	~DiffDialog();
+	void stop();
+
+public slots:
+	void handleCompare();
+
+private slots:
+	void showResults();
+	void diffDone();
+
+private:
+	const Sandbox *sb_;
+	QString dir_;
+	DirDiff *diff_;
+	DiffModel *model_;
+	QTableView *table_;
+	QCheckBox *hash_;
+	QLabel *status_;
+	QPushButton *button_;
+	QTimer *timer_;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "du.h"
+#include <QMutexLocker>
+
+// directory listing context for one worker
+struct DuContext {
+	DiskUsage *du;
+	int root;
+	QByteArray dir;
+	quint64 bytes;
+	volatile int *cancel;
+};
+
+DiskUsage::DiskUsage(const Sandbox *sb, QThreadPool *pool, QObject *parent): QObject(parent), sb_(sb), pool_(pool),
+	cancel_(0), queue_(&cancel_), complete_(false) {
+	connect(&queue_, SIGNAL(finished()), this, SLOT(workerDone()));
+}
+
+DiskUsage::~DiskUsage() {
+	stop();
+}
+
+void DiskUsage::start(QString dir, QList<QByteArray> names, int threads) {
+	stop();
+	cancel_ = 0;
+	complete_ = false;
+	{
+		QMutexLocker locker(&totals_mutex_);
+		totals_.fill(0, names.size());
+	}
+	for (int i = 0; i < INODE_SHARDS; i++)
+		inodes_[i].clear();
+
+	QByteArray base = dir.toUtf8();
+	if (!base.endsWith('/'))
+		base += '/';
+	int pushed = 0;
+	for (int i = 0; i < names.size(); i++) {
+		Item item;
+		item.path = base + names[i];
+		item.root = i;
+		if (!sandbox_virtual_dir(item.path.constData())) {
+			queue_.push(item);
+			pushed++;
+		}
+	}
+	if (pushed == 0) {
+		complete_ = true;
+		emit finished();
+		return;
+	}
+
+	// the scan pool runs below the GUI and the listings
+	queue_.start(pool_, threads, work_cb, this);
+}
+
+void DiskUsage::cancel() {
+	if (!queue_.active())
+		return;
+	stop();
+	emit finished();
+}
+
+// stop the tasks and drop the directories left
+void DiskUsage::stop() {
+	cancel_ = 1;
+	queue_.stop();
+	queue_.clear();
+}
+
+// the last task returned; stale notifications of a cancelled scan are ignored
+void DiskUsage::workerDone() {
+	if (!queue_.active() || queue_.busy())
+		return;
+	stop();
+	complete_ = true;
+	emit finished();
+}
+
+QVector<quint64> DiskUsage::totals() {
+	QMutexLocker locker(&totals_mutex_);
+	return totals_;
+}
+
+// returns true the first time a (dev, ino) pair is seen
+bool DiskUsage::firstLink(dev_t dev, ino_t ino) {
+	QPair<quint64, quint64> key((quint64) dev, (quint64) ino);
+	int shard = (int) (ino % INODE_SHARDS);
+	QMutexLocker locker(&inode_mutex_[shard]);
+	if (inodes_[shard].contains(key))
+		return false;
+	inodes_[shard].insert(key);
+	return true;
+}
+
+int DiskUsage::entry_cb(const SandboxEntry *entry, void *arg) {
+	DuContext *ctx = (DuContext *) arg;
+	if (*ctx->cancel)
+		return 1;
+
+	if (S_ISDIR(entry->mode)) {
+		Item item;
+		item.path = ctx->dir + '/' + entry->name;
+		item.root = ctx->root;
+		if (!sandbox_virtual_dir(item.path.constData()))
+			ctx->du->queue_.push(item);
+	}
+	else if (S_ISREG(entry->mode) || S_ISLNK(entry->mode)) {
+		if (entry->nlink > 1 && entry->ino && !ctx->du->firstLink(entry->dev, entry->ino))
+			return 0;
+		ctx->bytes += entry->size;
+	}
+	return 0;
+}
+
+void DiskUsage::work_cb(void *arg) {
+	((DiskUsage *) arg)->work();
+}
+
+void DiskUsage::work() {
+	DuContext ctx;
+	ctx.du = this;
+	ctx.cancel = &cancel_;
+
+	Item item;
+	// depth first, the queue stays short
+	while (queue_.pop(&item)) {
+		ctx.root = item.root;
+		ctx.dir = item.path;
+		ctx.bytes = 0;
+		sandbox_list(sb_, item.path.constData(), entry_cb, &ctx, &cancel_);
+		if (ctx.bytes) {
+			QMutexLocker locker(&totals_mutex_);
+			totals_[item.root] += ctx.bytes;
+		}
+		queue_.done();
+	}
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef DU_H
+#define DU_H
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QVector>
+#include "sandbox.h"
+#include "workqueue.h"
+
+class QThreadPool;
+
+// Parallel disk usage scanner. Each directory passed to start() is walked recursively
+// by a few tasks in the scan thread pool, sharing one queue of directories. Hardlinked
+// files are counted once, by (dev, ino). The totals can be read at any time while the
+// scan is running.
+class DiskUsage: public QObject {
+Q_OBJECT
+
+public:
+	DiskUsage(const Sandbox *sb, QThreadPool *pool, QObject *parent = 0);
+	~DiskUsage();
+
+	// scan dir + names[i] for every i; threads <= 0 selects half of the scan pool
+	void start(QString dir, QList<QByteArray> names, int threads);
+	// stop the scan and wait for the threads
+	void cancel();
+	bool running() const {
+		return queue_.active();
+	}
+	// the last scan went through all the directories
+	bool complete() const {
+		return complete_;
+	}
+
+	// current totals in bytes, in the order of the names passed to start()
+	QVector<quint64> totals();
+
+signals:
+	// all the directories were scanned, or the scan was cancelled
+	void finished();
+
+private slots:
+	void workerDone();
+
+private:
+	struct Item {
+		QByteArray path;
+		int root;		// index in names
+	};
+
+	enum {
+		INODE_SHARDS = 16
+	};
+
+	void stop();
+	void work();
+	bool firstLink(dev_t dev, ino_t ino);
+	static void work_cb(void *arg);
+	static int entry_cb(const SandboxEntry *entry, void *arg);
+
+	const Sandbox *sb_;
+	QThreadPool *pool_;
+	volatile int cancel_;
+	WorkQueue<Item> queue_;		// directories, the tasks work at the back
+	bool complete_;
+
+	QMutex totals_mutex_;
+	QVector<quint64> totals_;
+
+	QMutex inode_mutex_[INODE_SHARDS];
+	QSet<QPair<quint64, quint64> > inodes_[INODE_SHARDS];
+};
+
+#endif
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "filemodel.h"
+#include "fs.h"
+#include "workqueue.h"
+#include <algorithm>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QPixmapCache>
+
+// mount labels, index 0 is an ordinary file
+static const char *mount_labels[] = {
+	"",
+	"Blacklist",
+	"Temporary-RO",
+	"Temporary",
+	"Generated-RO",
+	"Generated",
+	"Clone-RO",
+	"Clone",
+	"Read-only"
+};
+
+// convert the FS operations for a file to an index in mount_labels
+static quint8 mount_label(int ops) {
+	if (ops & FS_BLACKLIST)
+		return 1;
+	else if ((ops & FS_TMPFS) && (ops & FS_READONLY))
+		return 2;
+	else if (ops & FS_TMPFS)
+		return 3;
+	else if (ops & FS_CREATE)
+		return (ops & FS_READONLY)? 4: 5;
+	else if (ops & FS_CLONE)
+		return (ops & FS_READONLY)? 6: 7;
+	else if (ops & FS_READONLY)
+		return 8;
+	return 0;
+}
+
+// resource pixmaps are decoded once in the process
+static QPixmap shared_pixmap(const char *name) {
+	QPixmap pixmap;
+	if (!QPixmapCache::find(name, &pixmap)) {
+		pixmap = QPixmap(name);
+		QPixmapCache::insert(name, pixmap);
+	}
+	return pixmap;
+}
+
+FileModel::FileModel(FS *fs, QObject *parent): QAbstractTableModel(parent), fs_(fs),
+	sort_column_(COL_NAME), sort_order_(Qt::AscendingOrder), sorted_(true), listing_(false),
+	generation_(0), flush_queued_(false), done_(false), status_(0) {
+
+	// the same three pixmaps are used for all the rows, and by all the models
+	icon_dir_ = shared_pixmap(":resources/gnome-fs-directory.png");
+	icon_link_ = shared_pixmap(":resources/emblem-symbolic-link.png");
+	icon_file_ = shared_pixmap(":resources/empty.png");
+}
+
+int FileModel::rowCount(const QModelIndex &parent) const {
+	return (parent.isValid())? 0: rows_.size();
+}
+
+int FileModel::columnCount(const QModelIndex &parent) const {
+	return (parent.isValid())? 0: COL_MAX;
+}
+
+QVariant FileModel::data(const QModelIndex &index, int role) const {
+	if (!index.isValid() || index.row() >= rows_.size())
+		return QVariant();
+	const Row &row = rows_[index.row()];
+
+	if (role == Qt::DecorationRole && index.column() == COL_ICON) {
+		if ((row.type & TYPE_MASK) == TYPE_DIR)
+			return icon_dir_;
+		else if ((row.type & TYPE_MASK) == TYPE_LINK)
+			return icon_link_;
+		return icon_file_;
+	}
+	else if (role == Qt::DisplayRole) {
+		switch (index.column()) {
+			case COL_MOUNT:
+				return QString(mount_labels[row.mount]);
+			case COL_OWNER:
+				return owners_.at(row.owner);
+			case COL_SIZE:
+				if (row.type & SIZE_PARTIAL)
+					return QString::number(row.size) + "+";
+				return QString::number(row.size);
+			case COL_NAME:
+				return QString("  ") + QString::fromUtf8(rowName(row));
+		}
+	}
+	else if (role == Qt::TextAlignmentRole && index.column() != COL_NAME)
+		return (int) Qt::AlignCenter;
+
+	return QVariant();
+}
+
+QVariant FileModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant();
+
+	switch (section) {
+		case COL_MOUNT:
+			return QString("Mount");
+		case COL_OWNER:
+			return QString("Owner");
+		case COL_SIZE:
+			return QString("Size");
+		case COL_NAME:
+			return QString("Name");
+	}
+	return QString(" ");
+}
+
+bool FileModel::isDir(int row) const {
+	return row >= 0 && row < rows_.size() && (rows_[row].type & TYPE_MASK) == TYPE_DIR;
+}
+
+QString FileModel::name(int row) const {
+	if (row < 0 || row >= rows_.size())
+		return QString();
+	return QString::fromUtf8(rowName(rows_[row]));
+}
+
+QList<QByteArray> FileModel::dirNames() const {
+	QList<QByteArray> names;
+	for (int i = 0; i < rows_.size(); i++) {
+		if ((rows_[i].type & TYPE_MASK) == TYPE_DIR)
+			names.append(QByteArray(rowName(rows_[i])));
+	}
+	return names;
+}
+
+void FileModel::setDirSizes(const QList<QByteArray> &names, const QVector<quint64> &sizes, bool partial) {
+	if (rows_.isEmpty())
+		return;
+
+	QHash<QByteArray, int> lookup;
+	for (int i = 0; i < names.size() && i < sizes.size(); i++)
+		lookup.insert(names[i], i);
+
+	for (int i = 0; i < rows_.size(); i++) {
+		Row &row = rows_[i];
+		if ((row.type & TYPE_MASK) != TYPE_DIR)
+			continue;
+		const char *name = rowName(row);
+		QHash<QByteArray, int>::const_iterator it = lookup.constFind(QByteArray::fromRawData(name, strlen(name)));
+		if (it == lookup.constEnd())
+			continue;
+		row.size = sizes[it.value()];
+		row.type = (row.type & TYPE_MASK) | SIZE_TOTAL | ((partial)? SIZE_PARTIAL: 0);
+	}
+	emit dataChanged(index(0, COL_SIZE), index(rows_.size() - 1, COL_SIZE));
+}
+
+bool FileModel::lessThan(const Row &a, const Row &b) const {
+	switch (sort_column_) {
+		case COL_ICON:
+			if ((a.type & TYPE_MASK) != (b.type & TYPE_MASK))
+				return (a.type & TYPE_MASK) == TYPE_DIR;	// directories first
+			break;
+		case COL_MOUNT:
+			if (a.mount != b.mount)
+				return a.mount < b.mount;
+			break;
+		case COL_OWNER:
+			if (a.owner != b.owner)
+				return owners_.at(a.owner) < owners_.at(b.owner);
+			break;
+		case COL_SIZE:
+			if (a.size != b.size)
+				return a.size < b.size;
+			break;
+	}
+
+	// names are unique in a directory
+	return strcmp(rowName(a), rowName(b)) < 0;
+}
+
+struct RowCompare {
+	const FileModel *model;
+	const QVector<FileModel::Row> *rows;
+	bool descending;
+	bool operator()(int a, int b) const {
+		if (descending)
+			return model->lessThan(rows->at(b), rows->at(a));
+		return model->lessThan(rows->at(a), rows->at(b));
+	}
+};
+
+void FileModel::sort(int column, Qt::SortOrder order) {
+	sort_column_ = column;
+	sort_order_ = order;
+	sorted_ = false;
+
+	// a listing in progress is sorted once it's complete
+	if (!listing_)
+		applySort();
+}
+
+void FileModel::applySort() {
+	if (sorted_)
+		return;
+	sorted_ = true;
+	if (rows_.size() < 2)
+		return;
+
+	emit layoutAboutToBeChanged();
+
+	QVector<int> order(rows_.size());
+	for (int i = 0; i < order.size(); i++)
+		order[i] = i;
+	RowCompare cmp;
+	cmp.model = this;
+	cmp.rows = &rows_;
+	cmp.descending = (sort_order_ == Qt::DescendingOrder);
+	std::sort(order.begin(), order.end(), cmp);
+
+	QVector<Row> rows(rows_.size());
+	QVector<int> position(rows_.size());
+	for (int i = 0; i < order.size(); i++) {
+		rows[i] = rows_[order[i]];
+		position[order[i]] = i;
+	}
+	rows_.swap(rows);
+
+	// keep the selection on the same entries
+	QModelIndexList from = persistentIndexList();
+	QModelIndexList to;
+	for (int i = 0; i < from.size(); i++)
+		to.append(index(position[from[i].row()], from[i].column()));
+	changePersistentIndexList(from, to);
+
+	emit layoutChanged();
+}
+
+int FileModel::beginListing() {
+	int generation;
+	{
+		QMutexLocker locker(&mutex_);
+		generation = generation_.fetchAndAddOrdered(1) + 1;
+		pending_.clear();
+		done_ = false;
+	}
+
+	beginResetModel();
+	rows_.clear();
+	names_.clear();
+	owners_.clear();
+	owner_index_.clear();
+	sorted_ = false;
+	listing_ = true;
+	endResetModel();
+	return generation;
+}
+
+FileEntry FileModel::toEntry(const SandboxEntry *entry) {
+	FileEntry e;
+	e.name = QByteArray(entry->name);
+	e.owner = QString(entry->owner);
+	if (S_ISDIR(entry->mode))
+		e.type = TYPE_DIR;
+	else if (S_ISLNK(entry->mode))
+		e.type = TYPE_LINK;
+	else
+		e.type = TYPE_FILE;
+	e.size = entry->size;
+	e.mtime = entry->mtime;
+	return e;
+}
+
+void FileModel::load(const QVector<FileEntry> &entries) {
+	beginListing();
+	insertEntries(entries);
+	listing_ = false;
+	applySort();
+	emit listingDone(0);
+}
+
+int FileModel::post(int generation, const FileEntry &entry) {
+	if (generation != generation_.loadAcquire())
+		return 1;
+
+	QMutexLocker locker(&mutex_);
+	if (generation != generation_.loadAcquire())
+		return 1;
+	pending_.append(entry);
+	if (!flush_queued_) {
+		flush_queued_ = true;
+		QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+	}
+	return 0;
+}
+
+void FileModel::finish(int generation, int status) {
+	QMutexLocker locker(&mutex_);
+	if (generation != generation_.loadAcquire())
+		return;
+	done_ = true;
+	status_ = status;
+	if (!flush_queued_) {
+		flush_queued_ = true;
+		QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+	}
+}
+
+// insert the entries received so far; GUI thread
+void FileModel::flush() {
+	QVector<FileEntry> batch;
+	bool done;
+	int status;
+	{
+		QMutexLocker locker(&mutex_);
+		batch.swap(pending_);
+		flush_queued_ = false;
+		done = done_;
+		done_ = false;
+		status = status_;
+	}
+
+	insertEntries(batch);
+	if (done) {
+		listing_ = false;
+		applySort();
+		emit listingDone(status);
+	}
+}
+
+void FileModel::insertEntries(const QVector<FileEntry> &entries) {
+	if (entries.isEmpty())
+		return;
+
+	int first = rows_.size();
+	beginInsertRows(QModelIndex(), first, first + entries.size() - 1);
+	rows_.reserve(first + entries.size());
+	for (int i = 0; i < entries.size(); i++) {
+		const FileEntry &e = entries[i];
+		Row row;
+		row.name = names_.size();
+		names_.append(e.name.constData(), e.name.size() + 1);
+
+		QHash<QString, int>::const_iterator it = owner_index_.constFind(e.owner);
+		if (it != owner_index_.constEnd())
+			row.owner = it.value();
+		else {
+			row.owner = owners_.size();
+			owners_.append(e.owner);
+			owner_index_.insert(e.owner, row.owner);
+		}
+
+		row.type = e.type;
+		row.mount = mount_label(fs_->checkFile(QString::fromUtf8(e.name)));
+		row.size = e.size;
+		row.mtime = e.mtime;
+		rows_.append(row);
+	}
+	endInsertRows();
+}
+
+int DirLister::entry_cb(const SandboxEntry *entry, void *arg) {
+	DirLister *lister = (DirLister *) arg;
+	if (*lister->group_->cancel()) {
+		lister->cancelled_ = true;
+		return 1;
+	}
+	if (lister->current_ && lister->current_->loadAcquire() != lister->generation_) {
+		lister->cancelled_ = true;
+		return 1;
+	}
+
+	FileEntry e = FileModel::toEntry(entry);
+	lister->entries_.append(e);
+	if (lister->model_ && lister->model_->post(lister->generation_, e)) {
+		lister->cancelled_ = true;
+		return 1;
+	}
+	return 0;
+}
+
+void DirLister::run() {
+	group_->started(this);
+	list();
+	// the view can be gone after this
+	group_->finished();
+}
+
+void DirLister::list() {
+	if (*group_->cancel() || (current_ && current_->loadAcquire() != generation_))
+		return;
+
+	int wd = (cache_)? cache_->watch(sb_, path_): -1;
+	int status = sandbox_list(sb_, path_.toUtf8().constData(), entry_cb, this, group_->cancel());
+	if (*group_->cancel())
+		cancelled_ = true;
+	if (cache_) {
+		if (status == 0 && !cancelled_)
+			cache_->insert(sb_, path_, entries_, wd);
+		else
+			cache_->release(wd);
+	}
+	if (model_)
+		model_->finish(generation_, status);
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef FILEMODEL_H
+#define FILEMODEL_H
+#include <QAbstractTableModel>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPixmap>
+#include <QRunnable>
+#include <QStringList>
+#include <QVector>
+#include "sandbox.h"
+#include "listcache.h"
+
+class FS;
+class TaskGroup;
+
+// Directory listing shown in the main table. The rows are kept in a compact array,
+// with the names in a single UTF-8 pool and the owners interned. Entries arrive from a
+// DirLister running in the thread pool and are inserted in batches; sorting is deferred
+// until the listing is complete.
+class FileModel: public QAbstractTableModel {
+Q_OBJECT
+
+public:
+	enum {
+		COL_ICON = 0,
+		COL_MOUNT,
+		COL_OWNER,
+		COL_SIZE,
+		COL_NAME,
+		COL_MAX
+	};
+
+	enum {
+		TYPE_FILE = 0,
+		TYPE_DIR,
+		TYPE_LINK,
+		TYPE_MASK = 0x0f,
+		SIZE_PARTIAL = 0x40,	// disk usage scan in progress
+		SIZE_TOTAL = 0x80	// recursive directory size
+	};
+
+	FileModel(FS *fs, QObject *parent = 0);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+	void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+	bool isDir(int row) const;
+	QString name(int row) const;
+
+	// names of all the directories in the listing
+	QList<QByteArray> dirNames() const;
+	// replace the size of the directories with the recursive totals; partial totals
+	// are marked while the scan is running
+	void setDirSizes(const QList<QByteArray> &names, const QVector<quint64> &sizes, bool partial);
+
+	// drop the rows and cancel the listing in progress; returns the new listing generation
+	int beginListing();
+	int generation() const {
+		return generation_.loadAcquire();
+	}
+
+	// show a complete listing, for example from the listing cache
+	void load(const QVector<FileEntry> &entries);
+
+	// called by DirLister from a worker thread; return non-zero if the listing was cancelled
+	int post(int generation, const FileEntry &entry);
+	void finish(int generation, int status);
+
+	static FileEntry toEntry(const SandboxEntry *entry);
+
+signals:
+	// the listing is complete; status is 0, or -1 if the directory cannot be read
+	void listingDone(int status);
+
+private slots:
+	void flush();
+
+private:
+	struct Row {
+		quint32 name;		// offset in names_
+		quint16 owner;		// index in owners_
+		quint8 type;		// TYPE_* and SIZE_* flags
+		quint8 mount;		// index in the mount label table
+		quint64 size;
+		qint64 mtime;
+	};
+
+	const char *rowName(const Row &row) const {
+		return names_.constData() + row.name;
+	}
+	void insertEntries(const QVector<FileEntry> &entries);
+	void applySort();
+	bool lessThan(const Row &a, const Row &b) const;
+	friend struct RowCompare;
+
+	FS *fs_;
+	QVector<Row> rows_;
+	QByteArray names_;
+	QStringList owners_;
+	QHash<QString, int> owner_index_;
+
+	QPixmap icon_dir_;
+	QPixmap icon_link_;
+	QPixmap icon_file_;
+
+	int sort_column_;
+	Qt::SortOrder sort_order_;
+	bool sorted_;
+	bool listing_;
+
+	// shared with the worker thread
+	QAtomicInt generation_;
+	QMutex mutex_;
+	QVector<FileEntry> pending_;	// received from the worker thread, not inserted yet
+	bool flush_queued_;
+	bool done_;
+	int status_;
+};
+
+// thread pool task listing one directory into a FileModel and into the listing cache;
+// model can be NULL when the directory is only read into the cache, the listing is then
+// cancelled as soon as *current is different from generation. The task belongs to the
+// group of its view and it is cancelled when the view stops the group.
+class DirLister: public QRunnable {
+public:
+	DirLister(const Sandbox *sb, QString path, FileModel *model, int generation, ListingCache *cache,
+		TaskGroup *group, const QAtomicInt *current = NULL):
+		sb_(sb), path_(path), model_(model), generation_(generation), cache_(cache), group_(group),
+		current_(current), cancelled_(false) {}
+	void run();
+
+private:
+	void list();
+	static int entry_cb(const SandboxEntry *entry, void *arg);
+
+	const Sandbox *sb_;
+	QString path_;
+	FileModel *model_;
+	int generation_;
+	ListingCache *cache_;
+	TaskGroup *group_;
+	const QAtomicInt *current_;
+	QVector<FileEntry> entries_;
+	bool cancelled_;
+};
+
+#endif
@@ -32,5 +32,6 @@ extern int arg_debug;
 // config.cpp
 void config_read_screen_size(int *x, int *y);
 void config_write_screen_size(int x, int y);
+int config_read_threads();
 
 #endif
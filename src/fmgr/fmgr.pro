@@ -2,9 +2,9 @@ QMAKE_CXXFLAGS += $$(CXXFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -
 QMAKE_CFLAGS += $$(CFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -pie -Wformat -Wformat-security
 QMAKE_LFLAGS += $$(LDFLAGS) -Wl,-z,relro -Wl,-z,now
 QT += widgets
- HEADERS       = fmgr.h mainwindow.h topwidget.h fs.h
- SOURCES       = mainwindow.cpp topwidget.cpp main.cpp \
-		  ../common/utils.cpp fs.cpp config.cpp
+ HEADERS       = fmgr.h mainwindow.h sandboxview.h sandboxpicker.h topwidget.h fs.h sandbox.h filemodel.h du.h listcache.h search.h searchpanel.h copy.h copydialog.h diff.h diffdialog.h workqueue.h ../common/pathdb.h ../common/subprocess.h ../common/pid.h
+ SOURCES       = mainwindow.cpp sandboxview.cpp sandboxpicker.cpp topwidget.cpp main.cpp \
+		  ../common/utils.cpp ../common/pathdb.cpp ../common/subprocess.cpp ../common/pid.cpp fs.cpp sandbox.cpp filemodel.cpp du.cpp listcache.cpp search.cpp searchpanel.cpp copy.cpp copydialog.cpp diff.cpp diffdialog.cpp workqueue.cpp config.cpp
 	
                  
 RESOURCES = fmgr.qrc
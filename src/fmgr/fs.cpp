@@ -19,75 +19,163 @@
 */
 #include "fs.h"
 #include "fmgr.h"
+#include "../common/subprocess.h"
 #include <string.h>
+#include <QStringList>
 
-FS::FS(pid_t pid): pid_(pid) {
+#define FS_TIMEOUT 30000	// ms
+
+// FSRule.seq index -> operation
+static const int inherited_ops[FS_NINHERITED] = { FS_BLACKLIST, FS_READONLY, FS_TMPFS };
+
+static void rule_apply(FSRule *rule, int seq, int set, int clear) {
+	for (int i = 0; i < FS_NINHERITED; i++) {
+		if (set & inherited_ops[i])
+			rule->seq[i] = seq;
+		else if (clear & inherited_ops[i])
+			rule->seq[i] = -seq;
+	}
+	rule->ops |= set & ~FS_INHERITED;
+}
+
+// keep the latest rule for each operation
+static void rule_merge(int *seq, const FSRule &rule) {
+	for (int i = 0; i < FS_NINHERITED; i++) {
+		if (abs(rule.seq[i]) > abs(seq[i]))
+			seq[i] = rule.seq[i];
+	}
+}
+
+static int rule_ops(const int *seq) {
+	int ops = 0;
+	for (int i = 0; i < FS_NINHERITED; i++) {
+		if (seq[i] > 0)
+			ops |= inherited_ops[i];
+	}
+	return ops;
+}
+
+FS::FS(pid_t pid): pid_(pid), nrules_(0), node_(NULL) {
+	memset(seq_, 0, sizeof(seq_));
 	initialize(pid);
 }
 
+// fs.print line callback
+static int fs_line(char *line, int is_stderr, void *arg) {
+	(void) is_stderr;
+	FS *fs = (FS *) arg;
+	fs->parseLine(line);
+	return 0;
+}
+
 void FS::initialize(pid_t pid) {
-	char *cmd;
-	if (asprintf(&cmd, "firejail --fs.print=%d", (int) pid) == -1)
+	char *arg;
+	if (asprintf(&arg, "--fs.print=%d", (int) pid) == -1)
 		errExit("asprintf");
-		
-	char *str = run_program(cmd);
-	if (str == NULL)
+	char *argv[] = { (char *) "firejail", arg, NULL };
+
+	SubprocessResult res;
+	subprocess_run(argv, 0, FS_TIMEOUT, NULL, fs_line, this, &res);
+	subprocess_free(&res);
+	free(arg);
+}
+
+QString FS::normalize(QString path) {
+	QStringList parts = path.split('/', QString::SkipEmptyParts);
+	return QString("/") + parts.join("/");
+}
+
+// set: operations added to the path, clear: inherited operations removed from it
+void FS::addRule(QString path, int set, int clear) {
+	path = normalize(path);
+	int seq = ++nrules_;
+	rule_apply(&rules_[path], seq, set, clear);
+
+	int index = path.lastIndexOf('/');
+	if (index == -1 || path == "/")
 		return;
-	char *ptr = strtok(str, "\n");
-	while (ptr) {
-		if (arg_debug)
-			printf("fs.print: %s\n", ptr);
-
-		if (strncmp(ptr, "tmpfs ", 6) == 0) {
-			paths_.append(QString(ptr + 6));
-			ops_.append(QString("T"));
-		}
-		else if (strncmp(ptr, "blacklist ", 10) == 0 ) {
-			paths_.append(QString(ptr + 10));
-			ops_.append(QString("B"));
-		}
-		else if (strncmp(ptr, "blacklist-nolog ", 16) == 0 ) {
-			paths_.append(QString(ptr + 16));
-			ops_.append(QString("B"));
-		}
-		else if (strncmp(ptr, "read-only ", 10) == 0 ) {
-			paths_.append(QString(ptr + 10));
-			ops_.append(QString("R"));
-		}
-		else if (strncmp(ptr, "clone ", 6) == 0 ) {
-			paths_.append(QString(ptr + 6));
-			ops_.append(QString("C"));
-		}
-		else if (strncmp(ptr, "create ", 7) == 0 ) {
-			paths_.append(QString(ptr + 7));
-			ops_.append(QString("G")); // generated
-		}
+	QString parent = (index == 0)? QString("/"): path.left(index);
+	rule_apply(&dirs_[parent][path.mid(index + 1)], seq, set, clear);
+}
 
-		ptr = strtok(NULL, "\n");
-	}
-	paths_.replaceInStrings(" ", "\\ ");
+void FS::parseLine(const char *ptr) {
+	if (arg_debug)
+		printf("fs.print: %s\n", ptr);
+
+	if (strncmp(ptr, "tmpfs ", 6) == 0)
+		addRule(QString(ptr + 6), FS_TMPFS, 0);
+	else if (strncmp(ptr, "blacklist ", 10) == 0 )
+		addRule(QString(ptr + 10), FS_BLACKLIST, 0);
+	else if (strncmp(ptr, "blacklist-nolog ", 16) == 0 )
+		addRule(QString(ptr + 16), FS_BLACKLIST, 0);
+	else if (strncmp(ptr, "noblacklist ", 12) == 0 )
+		addRule(QString(ptr + 12), 0, FS_BLACKLIST);
+	else if (strncmp(ptr, "read-only ", 10) == 0 )
+		addRule(QString(ptr + 10), FS_READONLY, 0);
+	else if (strncmp(ptr, "read-write ", 11) == 0 )
+		addRule(QString(ptr + 11), 0, FS_READONLY);
+	// a whitelisted path is mounted from the host over the tmpfs of its parent directory
+	else if (strncmp(ptr, "whitelist ", 10) == 0 )
+		addRule(QString(ptr + 10), 0, FS_BLACKLIST | FS_TMPFS);
+	else if (strncmp(ptr, "clone ", 6) == 0 )
+		addRule(QString(ptr + 6), FS_CLONE, 0);
+	else if (strncmp(ptr, "create ", 7) == 0 )
+		addRule(QString(ptr + 7), FS_CREATE, 0);
 }
- 
+
 void FS::checkPath(QString path) {
 	if (arg_debug)
 		printf("checkPath %s\n", path.toUtf8().constData());
-	path_ = path;
+	path = normalize(path);
+	inherited(path, seq_);
+
+	QHash<QString, QHash<QString, FSRule> >::const_iterator it = dirs_.constFind(path);
+	node_ = (it == dirs_.constEnd())? NULL: &it.value();
 }
 
-QString FS::checkFile(QString file) {
-	file = file.replace(" ", "\\ ");
-	QString full_path = path_ + file;
-	if (arg_debug) 
-		printf("checkFile full path %s\n", full_path.toUtf8().constData());
+// the latest inherited rules on a normalized path and all its ancestors
+void FS::inherited(QString path, int *seq) const {
+	for (int i = 0; i < FS_NINHERITED; i++)
+		seq[i] = 0;
+	QHash<QString, FSRule>::const_iterator it = rules_.constFind("/");
+	if (it != rules_.constEnd())
+		rule_merge(seq, it.value());
+	int index = 0;
+	while ((index = path.indexOf('/', index + 1)) != -1) {
+		it = rules_.constFind(path.left(index));
+		if (it != rules_.constEnd())
+			rule_merge(seq, it.value());
+	}
+	if (path != "/") {
+		it = rules_.constFind(path);
+		if (it != rules_.constEnd())
+			rule_merge(seq, it.value());
+	}
+}
+
+int FS::lookup(QString path) const {
+	path = normalize(path);
+	int seq[FS_NINHERITED];
+	inherited(path, seq);
+	QHash<QString, FSRule>::const_iterator it = rules_.constFind(path);
+	int ops = (it == rules_.constEnd())? 0: it.value().ops;
+	return ops | rule_ops(seq);
+}
 
-	QString str = "";
-	for (int i = 0; i < paths_.size(); ++i) {
-		if (full_path == paths_.at(i)) {
-			str += ops_.at(i);
+int FS::checkFile(QString file) {
+	int seq[FS_NINHERITED];
+	memcpy(seq, seq_, sizeof(seq));
+	int ops = 0;
+	if (node_) {
+		QHash<QString, FSRule>::const_iterator it = node_->constFind(file);
+		if (it != node_->constEnd()) {
+			rule_merge(seq, it.value());
+			ops = it.value().ops;
 		}
 	}
+	ops |= rule_ops(seq);
 
-	if (arg_debug) 
-		printf("checkFile database %s, result %s\n", full_path.toUtf8().constData(), str.toUtf8().constData());
-	return str;
+	if (arg_debug)
+		printf("checkFile %s, result 0x%x\n", file.toUtf8().constData(), ops);
+	return ops;
 }
@@ -21,23 +21,64 @@
 #define FS_H
 #include <unistd.h>
 #include <sys/types.h>
-#include <QStringList>
+#include <QHash>
+#include <QString>
 
+// mount operations from --fs.print, bitmask
+enum {
+	FS_BLACKLIST = 0x01,
+	FS_READONLY = 0x02,
+	FS_TMPFS = 0x04,
+	FS_CLONE = 0x08,
+	FS_CREATE = 0x10
+};
+
+// operations applied to a directory that also apply to everything below it
+#define FS_INHERITED (FS_BLACKLIST | FS_READONLY | FS_TMPFS)
+#define FS_NINHERITED 3
+
+// The last rule for each inherited operation on one path: the rule number, negative if
+// the rule removes the operation (read-write, whitelist, noblacklist), 0 if none.
+// Clone and create apply only to the exact path.
+struct FSRule {
+	int seq[FS_NINHERITED];
+	int ops;
+
+	FSRule(): ops(0) {
+		for (int i = 0; i < FS_NINHERITED; i++)
+			seq[i] = 0;
+	}
+};
+
+// Sandbox mount table. The rules are indexed by parent directory: checkPath looks up
+// the directory node and the inherited operations once, checkFile is a single hash
+// lookup in that node. For an inherited operation the last rule in --fs.print order on
+// the path or on one of its ancestors wins.
 class FS {
 public:
 	FS(pid_t pid);
-	QString getType(QString path, QString file);
 	void checkPath(QString path);
-	QString checkFile(QString file);
-	
+	int checkFile(QString file);
+	// operations for a full path, including the inherited ones; safe to call from any thread
+	int lookup(QString path) const;
+	void parseLine(const char *line);
+
+	// normalized absolute path: no trailing '/', no empty components; "/" for the root
+	static QString normalize(QString path);
+
 private:
 	void initialize(pid_t pid);
+	void addRule(QString path, int set, int clear);
+	void inherited(QString path, int *seq) const;
 
 	pid_t pid_;
-	QStringList paths_;
-	QStringList ops_;
-	
-	QString path_;
+	int nrules_;
+	QHash<QString, FSRule> rules_;			// path -> rule
+	QHash<QString, QHash<QString, FSRule> > dirs_;	// parent directory -> file name -> rule
+
+	// current directory
+	const QHash<QString, FSRule> *node_;
+	int seq_[FS_NINHERITED];
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "listcache.h"
+#include <errno.h>
+#include <sys/inotify.h>
+#include <QMutexLocker>
+#include <QSocketNotifier>
+
+#define LISTCACHE_BUDGET (32 * 1024 * 1024)	// bytes
+#define LISTCACHE_TTL 10			// seconds, without inotify
+#define INOTIFY_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB | \
+	IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+ListingCache::ListingCache(QObject *parent): QObject(parent),
+	ifd_(-1), notifier_(NULL), head_(NULL), tail_(NULL), bytes_(0) {
+
+	// inotify works on the sandbox directories only if they can be opened directly,
+	// the listings of the other sandboxes expire after LISTCACHE_TTL
+	ifd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (ifd_ != -1) {
+		notifier_ = new QSocketNotifier(ifd_, QSocketNotifier::Read, this);
+		connect(notifier_, SIGNAL(activated(int)), this, SLOT(inotifyEvent()));
+	}
+	if (arg_debug)
+		printf("listing cache: %s\n", (ifd_ == -1)? "TTL": "inotify");
+}
+
+ListingCache::~ListingCache() {
+	while (head_)
+		remove(head_);
+	if (ifd_ != -1)
+		close(ifd_);
+}
+
+size_t ListingCache::entriesSize(const QVector<FileEntry> &entries) {
+	size_t bytes = entries.size() * sizeof(FileEntry);
+	for (int i = 0; i < entries.size(); i++)
+		bytes += entries[i].name.size() + entries[i].owner.size() * sizeof(QChar);
+	return bytes;
+}
+
+void ListingCache::unlink(Node *node) {
+	if (node->prev)
+		node->prev->next = node->next;
+	else
+		head_ = node->next;
+	if (node->next)
+		node->next->prev = node->prev;
+	else
+		tail_ = node->prev;
+	node->prev = NULL;
+	node->next = NULL;
+}
+
+void ListingCache::pushFront(Node *node) {
+	node->prev = NULL;
+	node->next = head_;
+	if (head_)
+		head_->prev = node;
+	head_ = node;
+	if (!tail_)
+		tail_ = node;
+}
+
+// called with the mutex locked
+void ListingCache::remove(Node *node) {
+	unlink(node);
+	nodes_.remove(node->path);
+	if (node->wd != -1) {
+		watches_.remove(node->wd);
+		dropWatch(node->wd);
+	}
+	bytes_ -= node->bytes;
+	delete node;
+}
+
+// remove an inotify watch no longer used by a node or by a listing in progress;
+// called with the mutex locked
+void ListingCache::dropWatch(int wd) {
+	if (!watches_.contains(wd) && !pending_.contains(wd))
+		inotify_rm_watch(ifd_, wd);
+}
+
+// the listing started with watch() is done; returns true if the directory changed
+// in the meantime; called with the mutex locked
+bool ListingCache::unpend(int wd) {
+	drain();
+	bool dirty = dirty_.contains(wd);
+	if (--pending_[wd] <= 0) {
+		pending_.remove(wd);
+		dirty_.remove(wd);
+	}
+	return dirty;
+}
+
+bool ListingCache::lookup(const Sandbox *sb, QString path, QVector<FileEntry> *entries) {
+	QMutexLocker locker(&mutex_);
+	Node *node = nodes_.value(key(sb, path), NULL);
+	if (!node)
+		return false;
+	if (node->wd == -1 && node->expires < QDateTime::currentDateTimeUtc()) {
+		remove(node);
+		return false;
+	}
+
+	unlink(node);
+	pushFront(node);
+	*entries = node->entries;
+	return true;
+}
+
+bool ListingCache::contains(const Sandbox *sb, QString path) {
+	QMutexLocker locker(&mutex_);
+	Node *node = nodes_.value(key(sb, path), NULL);
+	return node && (node->wd != -1 || node->expires >= QDateTime::currentDateTimeUtc());
+}
+
+int ListingCache::watch(const Sandbox *sb, QString path) {
+	if (!watching(sb))
+		return -1;
+
+	// watch the directory through a file descriptor opened inside the sandbox;
+	// the watch is set before the directory is read, changes during the listing are not lost
+	int fd = sandbox_openat(sb, path.toUtf8().constData(), O_RDONLY | O_DIRECTORY);
+	if (fd == -1)
+		return -1;
+	char fdpath[64];
+	snprintf(fdpath, sizeof(fdpath), "/proc/self/fd/%d", fd);
+	int wd = inotify_add_watch(ifd_, fdpath, INOTIFY_MASK);
+	close(fd);
+	if (wd == -1)
+		return -1;
+
+	QMutexLocker locker(&mutex_);
+	pending_[wd]++;
+	return wd;
+}
+
+void ListingCache::release(int wd) {
+	if (wd == -1)
+		return;
+	QMutexLocker locker(&mutex_);
+	unpend(wd);
+	dropWatch(wd);
+}
+
+void ListingCache::insert(const Sandbox *sb, QString path, const QVector<FileEntry> &entries, int wd) {
+	size_t bytes = entriesSize(entries);
+	path = key(sb, path);
+
+	QMutexLocker locker(&mutex_);
+	bool dirty = (wd != -1)? unpend(wd): false;
+
+	// replace the old listing, and the listing of the same directory reached through a different path
+	Node *node = nodes_.value(path, NULL);
+	if (node)
+		remove(node);
+	node = (wd != -1)? watches_.value(wd, NULL): NULL;
+	if (node)
+		remove(node);
+
+	if (dirty || bytes > LISTCACHE_BUDGET / 4) {
+		if (arg_debug && dirty)
+			printf("listing cache: %s changed while listing\n", path.toUtf8().constData());
+		if (wd != -1)
+			dropWatch(wd);
+		return;
+	}
+
+	node = new Node;
+	node->path = path;
+	node->entries = entries;
+	node->bytes = bytes;
+	node->wd = wd;
+	node->expires = QDateTime::currentDateTimeUtc().addSecs(LISTCACHE_TTL);
+	pushFront(node);
+	nodes_.insert(path, node);
+	if (wd != -1)
+		watches_.insert(wd, node);
+	bytes_ += bytes;
+
+	// evict the least recently used listings
+	while (bytes_ > LISTCACHE_BUDGET && tail_ && tail_ != node)
+		remove(tail_);
+}
+
+void ListingCache::invalidate(const Sandbox *sb, QString path) {
+	QMutexLocker locker(&mutex_);
+	Node *node = nodes_.value(key(sb, path), NULL);
+	if (node)
+		remove(node);
+}
+
+void ListingCache::removeSandbox(const Sandbox *sb) {
+	QString prefix = key(sb, QString());
+	QMutexLocker locker(&mutex_);
+	for (Node *node = head_; node;) {
+		Node *next = node->next;
+		if (node->path.startsWith(prefix))
+			remove(node);
+		node = next;
+	}
+}
+
+// read the pending inotify events; called with the mutex locked
+void ListingCache::drain() {
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(ifd_, buf, sizeof(buf))) > 0) {
+		for (char *ptr = buf; ptr < buf + len;) {
+			struct inotify_event *event = (struct inotify_event *) ptr;
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			if (pending_.contains(event->wd))
+				dirty_.insert(event->wd);
+
+			Node *node = watches_.value(event->wd, NULL);
+			if (!node)
+				continue;
+			if (arg_debug)
+				printf("listing cache: %s changed\n", node->path.toUtf8().constData());
+			if (event->mask & IN_IGNORED) {
+				// the kernel removed the watch already
+				watches_.remove(node->wd);
+				node->wd = -1;
+			}
+			remove(node);
+		}
+	}
+}
+
+void ListingCache::inotifyEvent() {
+	QMutexLocker locker(&mutex_);
+	drain();
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef LISTCACHE_H
+#define LISTCACHE_H
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include "sandbox.h"
+
+class QSocketNotifier;
+
+// directory entry as stored in the listing cache and in FileModel
+struct FileEntry {
+	QByteArray name;
+	QString owner;
+	quint8 type;		// FileModel TYPE_*
+	quint64 size;
+	qint64 mtime;
+};
+
+// LRU cache of directory listings, keyed by sandbox and path, bounded by an approximate
+// memory budget shared by all the sandboxes open in the process. With direct access to the
+// sandbox filesystem every cached directory is watched with inotify and dropped as soon as
+// it changes; otherwise the listings expire after LISTCACHE_TTL seconds. The functions can
+// be called from any thread, the inotify events are processed in the thread owning the object.
+class ListingCache: public QObject {
+Q_OBJECT
+
+public:
+	ListingCache(QObject *parent = 0);
+	~ListingCache();
+
+	// returns true and fills in entries if a valid listing is cached
+	bool lookup(const Sandbox *sb, QString path, QVector<FileEntry> *entries);
+	bool contains(const Sandbox *sb, QString path);
+	void invalidate(const Sandbox *sb, QString path);
+	// drop all the listings of a sandbox about to be closed
+	void removeSandbox(const Sandbox *sb);
+
+	// A listing is stored in three steps: watch() is called before reading the directory,
+	// then the result is passed to insert(), or release() is called if the listing failed.
+	// The listing is not stored if the directory changed in the meantime.
+	int watch(const Sandbox *sb, QString path);
+	void insert(const Sandbox *sb, QString path, const QVector<FileEntry> &entries, int wd);
+	void release(int wd);
+
+	// true if the cached listings of this sandbox are kept up to date by inotify
+	bool watching(const Sandbox *sb) const {
+		return ifd_ != -1 && sandbox_direct(sb);
+	}
+
+private slots:
+	void inotifyEvent();
+
+private:
+	struct Node {
+		QString path;		// pid:path
+		QVector<FileEntry> entries;
+		size_t bytes;
+		int wd;			// inotify watch, -1 if none
+		QDateTime expires;	// TTL mode
+		Node *prev;		// LRU list, most recently used first
+		Node *next;
+	};
+
+	void unlink(Node *node);
+	void pushFront(Node *node);
+	void remove(Node *node);
+	void dropWatch(int wd);
+	bool unpend(int wd);
+	void drain();
+	static size_t entriesSize(const QVector<FileEntry> &entries);
+	static QString key(const Sandbox *sb, QString path) {
+		return QString::number(sb->pid) + ":" + path;
+	}
+
+	int ifd_;
+	QSocketNotifier *notifier_;
+
+	QMutex mutex_;
+	QHash<QString, Node *> nodes_;
+	QHash<int, Node *> watches_;
+	QHash<int, int> pending_;	// watch -> listings in progress
+	QSet<int> dirty_;		// watches with events during a listing
+	Node *head_;
+	Node *tail_;
+	size_t bytes_;
+};
+
+#endif
@@ -23,6 +23,7 @@
 
 #include "fmgr.h"
 #include "mainwindow.h"
+#include "sandboxpicker.h"
 //#include "../common/utils.h"
 #include "../../firetools_config.h"
 
@@ -30,30 +31,15 @@ int arg_debug = 0;
 
 static void usage() {
 	printf("firemgr - Firejail file manager\n\n");
-	printf("Usage: firemgr [options] sandbox-pid\n\n");
+	printf("Usage: firemgr [options] [sandbox-pid|sandbox-name...]\n\n");
+	printf("Every sandbox is opened in a separate tab. Without arguments, a running\n");
+	printf("sandbox is selected from a list.\n\n");
 	printf("Options:\n");
 	printf("\t--debug - debug mode\n\n");
 	printf("\t--help - this help screen\n\n");
 	printf("\t--version - print software version and exit\n\n");
 }
 
-static bool is_pid(const char *str) {
-	assert(str != NULL);
-	const char *ptr = str;
-	
-	while (*ptr != '\0') {
-		if (!isdigit(*ptr))
-			return false;
-		ptr++;
-	}
-	
-	int pid = atoi(str);
-	if (pid <= 0)
-		return false;
-	return true;	
-}
-
-
 int main(int argc, char *argv[]) {
 	int i;
 	
@@ -78,20 +64,25 @@ int main(int argc, char *argv[]) {
 			break;
 	}
 	
-	// in this moment we should have a pid
-	if (i == argc || i != (argc - 1) || !is_pid(argv[i])) {
-		fprintf(stderr, "Error: process ID expected\n");
-		usage();
-		return 1;
+	// the rest of the arguments are sandboxes, by pid or by name
+	QList<pid_t> pids;
+	for (; i < argc; i++) {
+		pid_t pid = SandboxPicker::resolve(argv[i]);
+		if (pid == 0) {
+			fprintf(stderr, "Error: sandbox %s not found\n", argv[i]);
+			usage();
+			return 1;
+		}
+		pids.append(pid);
 	}
-	pid_t pid = (pid_t) atoi(argv[i]);
 
 	// initialize resources
 	Q_INIT_RESOURCE(fmgr);
 
 	QApplication app(argc, argv);
-	MainWindow fm(pid);
+	MainWindow fm(pids);
+	if (pids.isEmpty())
+		fm.openSandbox();
 	fm.show();
 	return app.exec();
 }
-
@@ -20,37 +20,37 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 #include <QMainWindow>
+#include <QList>
+#include <sys/types.h>
 
-class QLineEdit;
-class QTableWidget;
-class TopWidget;
-class FS;
+class QTabWidget;
+class QThreadPool;
+class ListingCache;
+class SandboxView;
 
+// one tab for every sandbox; the listing thread pool, the prefetch pool, the scan pool and
+// the listing cache are shared by the tabs
 class MainWindow : public QMainWindow {
 Q_OBJECT
 
 public:
-	MainWindow(pid_t pid, QWidget *parent = 0);
+	MainWindow(QList<pid_t> pids, QWidget *parent = 0);
 	~MainWindow();
 
-private slots:
-	void handleUp();
-	void handleHome();
-	void handleRoot();
-	void handleRefresh();
-	void cellClicked(int row, int column);
+	// verify the sandbox and open it in a new tab; returns false if not found
+	bool addSandbox(pid_t pid);
 
-private:
-	void print_files(const char *path);
-	QString build_path();
-	QString build_line();
+public slots:
+	void openSandbox();
+
+private slots:
+	void closeTab(int index);
+	void tabChanged(int index);
 
 private:
-	pid_t pid_;
-	TopWidget *top_;
-	QLineEdit *line_;
-	QTableWidget *table_;
-	QStringList path_;
-	FS *fs_;
+	QTabWidget *tabs_;
+	ListingCache *cache_;
+	QThreadPool *prefetch_pool_;
+	QThreadPool *scan_pool_;
 };
 #endif
@@ -0,0 +1,670 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "sandbox.h"
+#include "../common/subprocess.h"
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <pwd.h>
+#include <signal.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/wait.h>
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
+
+#define LS_TIMEOUT 30000	// ms
+#define DENTS_BUFSIZE (32 * 1024)
+#define MAX_DEPTH 3		// firejail -> sandbox init -> application
+#define COPY_CHUNK (8 * 1024 * 1024)	// progress is reported after every chunk
+#define COPY_BUFSIZE (1024 * 1024)	// read/write fallback
+
+struct SandboxUser {
+	uid_t uid;
+	char *name;
+};
+
+struct linux_dirent64 {
+	ino64_t d_ino;
+	off64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+// first child of a process, -1 if none
+static pid_t first_child(pid_t parent) {
+	char *fname;
+	if (asprintf(&fname, "/proc/%d/task/%d/children", parent, parent) == -1)
+		errExit("asprintf");
+	FILE *fp = fopen(fname, "r");
+	free(fname);
+	if (fp) {
+		int child;
+		int rv = fscanf(fp, "%d", &child);
+		fclose(fp);
+		return (rv == 1)? child: -1;
+	}
+
+	// kernels without CONFIG_PROC_CHILDREN: look for the parent pid in /proc/<pid>/stat
+	DIR *dir = opendir("/proc");
+	if (!dir)
+		return -1;
+	pid_t child = -1;
+	struct dirent *entry;
+	while (child == -1 && (entry = readdir(dir))) {
+		char *end;
+		pid_t pid = strtol(entry->d_name, &end, 10);
+		if (end == entry->d_name || *end)
+			continue;
+		if (asprintf(&fname, "/proc/%d/stat", pid) == -1)
+			errExit("asprintf");
+		fp = fopen(fname, "r");
+		free(fname);
+		if (!fp)
+			continue;
+		char buf[512];
+		if (fgets(buf, sizeof(buf), fp)) {
+			// the command name can contain spaces and parentheses
+			char *ptr = strrchr(buf, ')');
+			int ppid;
+			if (ptr && sscanf(ptr + 1, " %*c %d", &ppid) == 1 && ppid == parent)
+				child = pid;
+		}
+		fclose(fp);
+	}
+	closedir(dir);
+	return child;
+}
+
+static void load_users(Sandbox *sb) {
+	int fd = sandbox_openat(sb, "/etc/passwd", O_RDONLY);
+	if (fd == -1)
+		return;
+	FILE *fp = fdopen(fd, "r");
+	if (!fp) {
+		close(fd);
+		return;
+	}
+
+	struct passwd *pw;
+	int size = 0;
+	while ((pw = fgetpwent(fp))) {
+		if (sb->nusers == size) {
+			size = (size)? size * 2: 32;
+			sb->users = (SandboxUser *) realloc(sb->users, size * sizeof(SandboxUser));
+			if (!sb->users)
+				errExit("realloc");
+		}
+		sb->users[sb->nusers].uid = pw->pw_uid;
+		sb->users[sb->nusers].name = strdup(pw->pw_name);
+		if (!sb->users[sb->nusers].name)
+			errExit("strdup");
+		sb->nusers++;
+	}
+	fclose(fp);
+}
+
+int sandbox_open(Sandbox *sb, pid_t pid) {
+	assert(sb);
+	memset(sb, 0, sizeof(Sandbox));
+	sb->pid = pid;
+	sb->child = -1;
+	sb->rootfd = -1;
+
+	if (kill(pid, 0) == -1 && errno == ESRCH)
+		return -1;
+
+	// the sandbox init process might not be accessible, try its descendants
+	pid_t child = pid;
+	for (int depth = 0; depth < MAX_DEPTH; depth++) {
+		child = first_child(child);
+		if (child == -1)
+			break;
+
+		char *fname;
+		if (asprintf(&fname, "/proc/%d/root", child) == -1)
+			errExit("asprintf");
+		sb->rootfd = open(fname, O_PATH | O_DIRECTORY | O_CLOEXEC);
+		free(fname);
+		if (sb->rootfd == -1)
+			continue;
+
+		// check openat2 is supported by the kernel
+		int fd = sandbox_openat(sb, "/", O_RDONLY | O_DIRECTORY);
+		if (fd != -1) {
+			close(fd);
+			sb->child = child;
+			break;
+		}
+		close(sb->rootfd);
+		sb->rootfd = -1;
+	}
+
+	if (sandbox_direct(sb))
+		load_users(sb);
+	if (arg_debug)
+		printf("sandbox %d: %s access\n", pid, (sandbox_direct(sb))? "direct": "firejail --ls");
+	return 0;
+}
+
+void sandbox_close(Sandbox *sb) {
+	assert(sb);
+	if (sb->rootfd != -1)
+		close(sb->rootfd);
+	sb->rootfd = -1;
+	for (int i = 0; i < sb->nusers; i++)
+		free(sb->users[i].name);
+	free(sb->users);
+	sb->users = NULL;
+	sb->nusers = 0;
+}
+
+int sandbox_openat(const Sandbox *sb, const char *path, int flags) {
+	assert(sb);
+	assert(path);
+	if (sb->rootfd == -1) {
+		errno = ENOSYS;
+		return -1;
+	}
+
+#ifdef SYS_openat2
+	// absolute symlinks inside the sandbox are resolved against the sandbox root,
+	// ".." stops at the root
+	struct open_how how;
+	memset(&how, 0, sizeof(how));
+	how.flags = flags | O_CLOEXEC;
+	how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+	while (*path == '/')
+		path++;
+	if (*path == '\0')
+		path = ".";
+	return syscall(SYS_openat2, sb->rootfd, path, &how, sizeof(how));
+#else
+	(void) flags;
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+const char *sandbox_user_name(const Sandbox *sb, uid_t uid, char *buf, size_t len) {
+	for (int i = 0; i < sb->nusers; i++) {
+		if (sb->users[i].uid == uid)
+			return sb->users[i].name;
+	}
+	snprintf(buf, len, "%u", (unsigned) uid);
+	return buf;
+}
+
+// virtual filesystems
+static const char *virtual_dirs[] = {
+	"/proc",
+	"/sys",
+	"/dev",
+	"/run/firejail",
+	NULL
+};
+
+int sandbox_virtual_dir(const char *path) {
+	for (int i = 0; virtual_dirs[i]; i++) {
+		if (strcmp(path, virtual_dirs[i]) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+// read the directory with getdents64 and statx
+// returns 0 if listed, -1 with errno set if the directory doesn't exist or the listing failed
+// part way, 1 if the fallback should be used
+static int list_direct(const Sandbox *sb, const char *path, SandboxEntryCb cb, void *arg, volatile int *cancel) {
+	int fd = sandbox_openat(sb, path, O_RDONLY | O_DIRECTORY);
+	if (fd == -1)
+		return (errno == ENOENT || errno == ENOTDIR)? -1: 1;
+
+	char *buf = (char *) malloc(DENTS_BUFSIZE);
+	if (!buf)
+		errExit("malloc");
+	char target[PATH_MAX];
+	char uidbuf[16];
+	int stop = 0;
+	long nread;
+	while (!stop && (nread = syscall(SYS_getdents64, fd, buf, DENTS_BUFSIZE)) > 0) {
+		for (long pos = 0; pos < nread && !stop;) {
+			struct linux_dirent64 *d = (struct linux_dirent64 *) (buf + pos);
+			pos += d->d_reclen;
+			if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+				continue;
+			if (cancel && *cancel) {
+				stop = 1;
+				break;
+			}
+
+			SandboxEntry entry;
+			memset(&entry, 0, sizeof(entry));
+			entry.name = d->d_name;
+			entry.uid = (uid_t) -1;
+			entry.gid = (gid_t) -1;
+			entry.ino = d->d_ino;
+
+			struct statx s;
+			if (statx(fd, d->d_name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT, STATX_BASIC_STATS, &s) == 0) {
+				entry.mode = s.stx_mode;
+				entry.uid = s.stx_uid;
+				entry.gid = s.stx_gid;
+				entry.size = s.stx_size;
+				entry.mtime = s.stx_mtime.tv_sec;
+				entry.dev = makedev(s.stx_dev_major, s.stx_dev_minor);
+				entry.ino = s.stx_ino;
+				entry.nlink = s.stx_nlink;
+			}
+			else if (d->d_type == DT_DIR)
+				entry.mode = S_IFDIR;
+			else if (d->d_type == DT_LNK)
+				entry.mode = S_IFLNK;
+			else
+				entry.mode = S_IFREG;
+
+			if (S_ISLNK(entry.mode)) {
+				ssize_t len = readlinkat(fd, d->d_name, target, sizeof(target) - 1);
+				if (len != -1) {
+					target[len] = '\0';
+					entry.target = target;
+				}
+			}
+			entry.owner = (entry.uid == (uid_t) -1)? "": sandbox_user_name(sb, entry.uid, uidbuf, sizeof(uidbuf));
+			stop = cb(&entry, arg);
+		}
+	}
+	// the entries read so far were passed to the callback already, the listing is not
+	// started again with firejail --ls
+	int err = errno;
+	free(buf);
+	close(fd);
+	if (!stop && nread < 0) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
+
+// --ls output parser state
+typedef struct {
+	SandboxEntryCb cb;
+	void *arg;
+	int lines;
+	int error;		// errno reported by firejail, 0 if none
+} LsState;
+
+// file type and permissions from a "drwxr-xr-x" string
+static mode_t parse_mode(const char *str) {
+	mode_t mode;
+	switch (*str) {
+		case 'd': mode = S_IFDIR; break;
+		case 'l': mode = S_IFLNK; break;
+		case 'c': mode = S_IFCHR; break;
+		case 'b': mode = S_IFBLK; break;
+		case 'p': mode = S_IFIFO; break;
+		case 's': mode = S_IFSOCK; break;
+		default: mode = S_IFREG; break;
+	}
+	if (strlen(str) < 10)
+		return mode;
+	for (int i = 0; i < 9; i++) {
+		if (str[i + 1] != '-' && str[i + 1] != 'S' && str[i + 1] != 'T')
+			mode |= 0400 >> i;
+	}
+	if (str[3] == 's' || str[3] == 'S')
+		mode |= S_ISUID;
+	if (str[6] == 's' || str[6] == 'S')
+		mode |= S_ISGID;
+	if (str[9] == 't' || str[9] == 'T')
+		mode |= S_ISVTX;
+	return mode;
+}
+
+// one line of --ls output: mode owner group size name
+static int ls_line(char *line, int is_stderr, void *arg) {
+	(void) is_stderr;
+	LsState *st = (LsState *) arg;
+
+	// an error at the start of the output means the directory cannot be listed
+	if (st->lines++ == 0 && strncmp(line, "Error", 5) == 0) {
+		if (strstr(line, "ermission denied"))
+			st->error = EACCES;
+		else if (strstr(line, "ot a directory"))
+			st->error = ENOTDIR;
+		else
+			st->error = ENOENT;
+		return 1;
+	}
+
+	// skip warnings and errors
+	if (strncmp(line, "Warning:", 8) == 0 ||
+	    strncmp(line, "Error:", 6) == 0)
+		return 0;
+
+	// the file name is the rest of the line and it can contain spaces
+	char *tokens[4];
+	char *ptr = line;
+	for (int i = 0; i < 4; i++) {
+		while (*ptr == ' ' || *ptr == '\t')
+			ptr++;
+		if (*ptr == '\0')
+			return 0;
+		tokens[i] = ptr;
+		while (*ptr != '\0' && *ptr != ' ' && *ptr != '\t')
+			ptr++;
+		if (*ptr == '\0')
+			return 0;
+		*ptr++ = '\0';
+	}
+	while (*ptr == ' ' || *ptr == '\t')
+		ptr++;
+	if (*ptr == '\0' || strcmp(ptr, ".") == 0 || strcmp(ptr, "..") == 0)
+		return 0;
+
+	SandboxEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.name = ptr;
+	entry.owner = tokens[1];
+	entry.mode = parse_mode(tokens[0]);
+	entry.uid = (uid_t) -1;
+	entry.gid = (gid_t) -1;
+	entry.size = strtoull(tokens[3], NULL, 10);
+	return st->cb(&entry, st->arg);
+}
+
+static int list_firejail(const Sandbox *sb, const char *path, SandboxEntryCb cb, void *arg, volatile int *cancel) {
+	char *pidarg;
+	if (asprintf(&pidarg, "--ls=%d", sb->pid) == -1)
+		errExit("asprintf");
+	char *argv[] = { (char *) "firejail", (char *) "--quiet", pidarg, (char *) path, NULL };
+
+	LsState st;
+	st.cb = cb;
+	st.arg = arg;
+	st.lines = 0;
+	st.error = 0;
+	SubprocessResult res;
+	int rv = subprocess_run(argv, SUBPROCESS_MERGE_ERR, LS_TIMEOUT, cancel, ls_line, &st, &res);
+	int err = errno;	// set if the process could not be started
+	if (rv == 0) {
+		if (st.error)
+			err = st.error;
+		else if (res.timedout)
+			err = ETIMEDOUT;
+	}
+	if (rv == 0 && (st.error || res.timedout))
+		rv = -1;
+	subprocess_free(&res);
+	free(pidarg);
+
+	if (rv == -1)
+		errno = err;
+	return rv;
+}
+
+int sandbox_list(const Sandbox *sb, const char *path, SandboxEntryCb cb, void *arg, volatile int *cancel) {
+	assert(sb);
+	assert(path);
+	assert(cb);
+
+	if (sandbox_direct(sb)) {
+		int rv = list_direct(sb, path, cb, arg, cancel);
+		if (rv <= 0)
+			return rv;
+		if (arg_debug)
+			printf("sandbox %d: cannot open %s directly, using firejail --ls\n", sb->pid, path);
+	}
+	return list_firejail(sb, path, cb, arg, cancel);
+}
+
+// data transfer methods, from the fastest one
+enum {
+	COPY_RANGE = 0,		// copy_file_range, can share the extents on the same filesystem
+	COPY_SENDFILE,		// sendfile, in kernel copy across filesystems
+	COPY_RW			// pread/pwrite
+};
+
+// copy bytes [start, end) at the same offset in out; method is downgraded when the kernel
+// doesn't support it for this pair of files
+static int copy_range(int in, int out, off_t start, off_t end, int *method, char **buf,
+	SandboxCopyCb cb, void *arg, volatile int *cancel) {
+	off_t pos = start;
+	while (pos < end) {
+		if (cancel && *cancel) {
+			errno = ECANCELED;
+			return -1;
+		}
+
+		size_t len = (end - pos < COPY_CHUNK)? end - pos: COPY_CHUNK;
+		ssize_t n;
+		if (*method == COPY_RANGE) {
+			loff_t off_in = pos;
+			loff_t off_out = pos;
+			n = copy_file_range(in, &off_in, out, &off_out, len, 0);
+			if (n == -1 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP)) {
+				*method = COPY_SENDFILE;
+				continue;
+			}
+		}
+		else if (*method == COPY_SENDFILE) {
+			if (lseek(out, pos, SEEK_SET) == -1)
+				return -1;
+			off_t off = pos;
+			n = sendfile(out, in, &off, len);
+			if (n == -1 && (errno == EINVAL || errno == ENOSYS)) {
+				*method = COPY_RW;
+				continue;
+			}
+		}
+		else {
+			if (!*buf) {
+				*buf = (char *) malloc(COPY_BUFSIZE);
+				if (!*buf)
+					errExit("malloc");
+			}
+			if (len > COPY_BUFSIZE)
+				len = COPY_BUFSIZE;
+			n = pread(in, *buf, len, pos);
+			for (ssize_t done = 0; n > 0 && done < n;) {
+				ssize_t w = pwrite(out, *buf + done, n - done, pos + done);
+				if (w == -1) {
+					if (errno == EINTR)
+						continue;
+					return -1;
+				}
+				done += w;
+			}
+		}
+
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (n == 0)	// the file was truncated while copying
+			break;
+		pos += n;
+		if (cb && cb(n, arg)) {
+			errno = ECANCELED;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// copy the data segments of the file, the holes are skipped and left unallocated in out
+static int copy_data(int in, int out, off_t size, SandboxCopyCb cb, void *arg, volatile int *cancel) {
+	int method = COPY_RANGE;
+	char *buf = NULL;
+	int rv = 0;
+	off_t pos = 0;
+	while (pos < size) {
+		off_t data = lseek(in, pos, SEEK_DATA);
+		off_t hole = size;
+		if (data == -1) {
+			if (errno == ENXIO)	// only a hole up to the end of the file
+				break;
+			data = pos;		// SEEK_DATA not supported, copy everything
+		}
+		else {
+			hole = lseek(in, data, SEEK_HOLE);
+			if (hole == -1 || hole > size)
+				hole = size;
+		}
+		if (data >= size)
+			break;
+
+		// holes count as copied
+		if (data > pos && cb && cb(data - pos, arg)) {
+			errno = ECANCELED;
+			rv = -1;
+			break;
+		}
+		if (copy_range(in, out, data, hole, &method, &buf, cb, arg, cancel) == -1) {
+			rv = -1;
+			break;
+		}
+		pos = hole;
+	}
+	free(buf);
+	if (rv == 0) {
+		if (pos < size && cb)
+			cb(size - pos, arg);
+		// a hole at the end of the file
+		rv = ftruncate(out, size);
+	}
+	return rv;
+}
+
+// returns 1 if the file cannot be opened directly
+static int copy_direct(const Sandbox *sb, const char *path, const char *dest, SandboxCopyCb cb, void *arg,
+	volatile int *cancel) {
+	int in = sandbox_openat(sb, path, O_RDONLY | O_NOFOLLOW);
+	if (in == -1)
+		return (errno == EACCES || errno == EPERM || errno == ENOSYS)? 1: -1;
+	struct stat s;
+	if (fstat(in, &s) == -1) {
+		close(in);
+		return -1;
+	}
+	if (!S_ISREG(s.st_mode)) {
+		close(in);
+		errno = EINVAL;
+		return -1;
+	}
+	int out = open(dest, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (out == -1) {
+		close(in);
+		return -1;
+	}
+	posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	int rv = copy_data(in, out, s.st_size, cb, arg, cancel);
+	if (rv == 0) {
+		// permissions without setuid/setgid, and the modification time
+		fchmod(out, s.st_mode & 0777);
+		struct timespec times[2];
+		times[0] = s.st_atim;
+		times[1] = s.st_mtim;
+		futimens(out, times);
+	}
+	int err = errno;
+	if (close(out) == -1 && rv == 0) {
+		rv = -1;
+		err = errno;
+	}
+	close(in);
+	if (rv == -1) {
+		unlink(dest);
+		errno = err;
+	}
+	return rv;
+}
+
+// firejail --get copies the file in the current directory, under its own name; it runs in
+// a temporary directory next to dest and the file is moved into place
+static int copy_firejail(const Sandbox *sb, const char *path, const char *dest, SandboxCopyCb cb, void *arg,
+	volatile int *cancel) {
+	char *dir;
+	if (asprintf(&dir, "%s.fmgr-XXXXXX", dest) == -1)
+		errExit("asprintf");
+	if (!mkdtemp(dir)) {
+		free(dir);
+		return -1;
+	}
+
+	char *pidarg;
+	if (asprintf(&pidarg, "--get=%d", sb->pid) == -1)
+		errExit("asprintf");
+	char *argv[] = { (char *) "firejail", (char *) "--quiet", pidarg, (char *) path, NULL };
+	SubprocessResult res;
+	int rv = subprocess_run_dir(dir, argv, SUBPROCESS_MERGE_ERR, 0, cancel, NULL, NULL, &res);
+	int err = EIO;
+	if (rv == 0 && res.cancelled)
+		err = ECANCELED;
+	if (rv == -1 || res.cancelled || !WIFEXITED(res.status) || WEXITSTATUS(res.status) != 0)
+		rv = -1;
+	subprocess_free(&res);
+	free(pidarg);
+
+	const char *base = strrchr(path, '/');
+	base = (base)? base + 1: path;
+	char *tmp;
+	if (asprintf(&tmp, "%s/%s", dir, base) == -1)
+		errExit("asprintf");
+	struct stat s;
+	if (rv == 0) {
+		// link doesn't replace an existing file
+		if (stat(tmp, &s) == -1 || link(tmp, dest) == -1) {
+			err = errno;
+			rv = -1;
+		}
+		else if (cb)
+			cb(s.st_size, arg);
+	}
+	unlink(tmp);
+	rmdir(dir);
+	free(tmp);
+	free(dir);
+	if (rv == -1)
+		errno = err;
+	return rv;
+}
+
+int sandbox_copy(const Sandbox *sb, const char *path, const char *dest, SandboxCopyCb cb, void *arg,
+	volatile int *cancel) {
+	assert(sb);
+	assert(path);
+	assert(dest);
+
+	if (sandbox_direct(sb)) {
+		int rv = copy_direct(sb, path, dest, cb, arg, cancel);
+		if (rv <= 0)
+			return rv;
+		if (arg_debug)
+			printf("sandbox %d: cannot copy %s directly, using firejail --get\n", sb->pid, path);
+	}
+	return copy_firejail(sb, path, dest, cb, arg, cancel);
+}
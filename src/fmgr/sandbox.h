@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SANDBOX_H
+#define SANDBOX_H
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+// Access to the filesystem of a running sandbox. When the kernel allows it, the mount
+// namespace of the sandbox is reached directly through /proc/<child>/root: paths are
+// resolved with openat2(RESOLVE_IN_ROOT), directories are read with getdents64 and the
+// entries are described with statx, without starting any process. Otherwise the functions
+// fall back to parsing "firejail --ls" output. No static memory is modified after
+// sandbox_open, the functions can be called from multiple threads.
+
+struct SandboxUser;
+
+typedef struct {
+	pid_t pid;		// firejail process
+	pid_t child;		// sandbox process used for direct access, -1 if none
+	int rootfd;		// /proc/<child>/root, -1 if direct access is not available
+	struct SandboxUser *users;	// /etc/passwd in the sandbox
+	int nusers;
+} Sandbox;
+
+// one directory entry
+typedef struct {
+	const char *name;
+	const char *target;	// symlink target, NULL if not a symlink or not known
+	const char *owner;	// user name as seen in the sandbox, or the numeric uid
+	mode_t mode;		// file type and permissions
+	uid_t uid;		// (uid_t) -1 if not known
+	gid_t gid;		// (gid_t) -1 if not known
+	uint64_t size;
+	int64_t mtime;		// seconds, 0 if not known
+	dev_t dev;		// 0 if not known
+	ino_t ino;		// 0 if not known
+	nlink_t nlink;		// 0 if not known
+} SandboxEntry;
+
+// entry callback; the strings are valid only during the call
+// return 0 to continue, or non-zero to stop the listing
+typedef int (*SandboxEntryCb)(const SandboxEntry *entry, void *arg);
+
+// find the sandbox process and open its root directory; returns 0 if the sandbox exists
+int sandbox_open(Sandbox *sb, pid_t pid);
+void sandbox_close(Sandbox *sb);
+
+// true if the sandbox filesystem can be accessed directly
+static inline int sandbox_direct(const Sandbox *sb) {
+	return sb->rootfd != -1;
+}
+
+// open a path inside the sandbox; symbolic links are resolved inside the sandbox
+// returns a file descriptor, or -1 with errno set (ENOSYS if direct access is not available)
+int sandbox_openat(const Sandbox *sb, const char *path, int flags);
+
+// list a directory, "." and ".." are skipped
+// cancel: optional flag checked between entries
+// returns 0 if the directory was listed, -1 with errno set if it doesn't exist or it cannot be read
+int sandbox_list(const Sandbox *sb, const char *path, SandboxEntryCb cb, void *arg, volatile int *cancel);
+
+// copy progress callback: bytes copied since the last call; return non-zero to stop the copy
+typedef int (*SandboxCopyCb)(uint64_t bytes, void *arg);
+
+// copy a regular file out of the sandbox into a new file dest on the host; dest must not exist
+// the data is moved in the kernel (copy_file_range, sendfile), the holes of sparse files are
+// preserved; without direct access the file is extracted with firejail --get
+// returns 0, or -1 with errno set (ECANCELED if stopped); dest is removed if the copy failed
+int sandbox_copy(const Sandbox *sb, const char *path, const char *dest, SandboxCopyCb cb, void *arg,
+	volatile int *cancel);
+
+// true for the kernel filesystems (/proc, /sys, /dev) not worth walking recursively
+int sandbox_virtual_dir(const char *path);
+
+// user name for a uid in the sandbox; if not found, the numeric uid is printed in buf
+const char *sandbox_user_name(const Sandbox *sb, uid_t uid, char *buf, size_t len);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "sandboxpicker.h"
+#include "../common/pid.h"
+
+#include <QtGlobal>
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
+
+SandboxPicker::SandboxPicker(QWidget *parent): QDialog(parent), pid_(0) {
+	list_ = new QListWidget(this);
+	connect(list_, SIGNAL(itemClicked(QListWidgetItem *)), this, SLOT(itemSelected(QListWidgetItem *)));
+	connect(list_, SIGNAL(itemDoubleClicked(QListWidgetItem *)), this, SLOT(handleOk()));
+	line_ = new QLineEdit(this);
+	line_->setPlaceholderText(tr("Sandbox PID or name"));
+	connect(line_, SIGNAL(returnPressed()), this, SLOT(handleOk()));
+
+	QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+	connect(buttons, SIGNAL(accepted()), this, SLOT(handleOk()));
+	connect(buttons, SIGNAL(rejected()), this, SLOT(reject()));
+
+	QVBoxLayout *layout = new QVBoxLayout;
+	layout->addWidget(list_);
+	layout->addWidget(line_);
+	layout->addWidget(buttons);
+	setLayout(layout);
+	resize(500, 300);
+	setWindowTitle(tr("Open sandbox"));
+	fill();
+}
+
+// running sandboxes, from the process table
+void SandboxPicker::fill() {
+	pid_read(0);
+	for (int i = pids_first; i <= pids_last; i++) {
+		if (pids[i].level != 1 || pids[i].zombie)
+			continue;
+		char *cmd = pid_proc_cmdline(i);
+		QString txt = QString::number(i) + "  " + ((cmd)? QString(cmd): QString());
+		free(cmd);
+		QListWidgetItem *item = new QListWidgetItem(txt, list_);
+		item->setData(Qt::UserRole, i);
+	}
+}
+
+void SandboxPicker::itemSelected(QListWidgetItem *item) {
+	line_->setText(QString::number(item->data(Qt::UserRole).toInt()));
+}
+
+void SandboxPicker::handleOk() {
+	if (list_->currentItem() && line_->text().isEmpty())
+		itemSelected(list_->currentItem());
+	pid_ = resolve(line_->text().trimmed().toUtf8().constData());
+	if (pid_ == 0) {
+		QMessageBox::warning(this, tr("Firejail File Manager"), tr("<br/><b>Sandbox not found.</b><br/><br/><br/>"));
+		return;
+	}
+	accept();
+}
+
+pid_t SandboxPicker::resolve(const char *str) {
+	if (*str == '\0')
+		return 0;
+	const char *ptr = str;
+	while (isdigit(*ptr))
+		ptr++;
+	if (*ptr == '\0') {
+		int pid = atoi(str);
+		return (pid > 0)? (pid_t) pid: 0;
+	}
+
+	pid_t pid;
+	if (name2pid(str, &pid))
+		return 0;
+	return pid;
+}
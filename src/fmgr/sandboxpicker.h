@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SANDBOXPICKER_H
+#define SANDBOXPICKER_H
+#include <QDialog>
+#include <sys/types.h>
+
+class QLineEdit;
+class QListWidget;
+class QListWidgetItem;
+
+// choose a running sandbox from a list, or by pid or --name
+class SandboxPicker: public QDialog {
+Q_OBJECT
+
+public:
+	SandboxPicker(QWidget *parent = 0);
+	// the selected sandbox, 0 if none
+	pid_t pid() const {
+		return pid_;
+	}
+
+	// pid or sandbox name; returns 0 if not found
+	static pid_t resolve(const char *str);
+
+private slots:
+	void itemSelected(QListWidgetItem *item);
+	void handleOk();
+
+private:
+	void fill();
+
+	QListWidget *list_;
+	QLineEdit *line_;
+	pid_t pid_;
+};
+
+#endif
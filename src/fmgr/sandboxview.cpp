@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "fs.h"
+#include "filemodel.h"
+#include "du.h"
+#include "searchpanel.h"
+#include "copydialog.h"
+#include "diffdialog.h"
+
+#include <QtGlobal>
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
+
+#include "sandboxview.h"
+#include "topwidget.h"
+#include <QtGui>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define DU_UPDATE 250		// disk usage table update, ms
+#define PREFETCH_DIRS 32	// directories queued for prefetch
+#define PREFETCH_NICE 10
+
+// prefetch task, the directory is read into the listing cache at a lower scheduling priority;
+// the prefetch thread pool is not used for anything else
+class PrefetchTask: public DirLister {
+public:
+	PrefetchTask(const Sandbox *sb, QString path, ListingCache *cache, TaskGroup *group, const QAtomicInt *current):
+		DirLister(sb, path, NULL, current->loadAcquire(), cache, group, current) {}
+	void run() {
+		setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), PREFETCH_NICE);
+		DirLister::run();
+	}
+};
+
+SandboxView::SandboxView(const Sandbox &sb, ListingCache *cache, QThreadPool *prefetch_pool, QThreadPool *scan_pool,
+	QWidget *parent): QWidget(parent), pid_(sb.pid), cache_(cache), sb_(sb), prefetch_pool_(prefetch_pool),
+	scan_pool_(scan_pool) {
+	// initialize FS
+	fs_ = new FS(pid_);
+
+	top_ = new TopWidget(this);
+	connect(top_, SIGNAL(upClicked()), this, SLOT(handleUp()));
+	connect(top_, SIGNAL(rootClicked()), this, SLOT(handleRoot()));
+	connect(top_, SIGNAL(refreshClicked()), this, SLOT(handleRefresh()));
+	connect(top_, SIGNAL(homeClicked()), this, SLOT(handleHome()));
+
+	line_ = new QLineEdit(this);
+	QString txt = build_line();
+	line_->setText(txt);
+	line_->setReadOnly(true);
+
+	model_ = new FileModel(fs_, this);
+	connect(model_, SIGNAL(listingDone(int)), this, SLOT(listingDone(int)));
+	table_ = new QTableView(this);
+	table_->setModel(model_);
+	table_->verticalHeader()->setVisible(false);
+	// uniform rows, the view doesn't need to measure them
+	table_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	table_->verticalHeader()->setDefaultSectionSize(table_->fontMetrics().height() + 8);
+	table_->setColumnWidth(FileModel::COL_ICON, 26);
+	table_->setColumnWidth(FileModel::COL_MOUNT, 100);
+	table_->setColumnWidth(FileModel::COL_OWNER, 100);
+	table_->setColumnWidth(FileModel::COL_SIZE, 100);
+	table_->setColumnWidth(FileModel::COL_NAME, 500);
+	table_->horizontalHeader()->setStretchLastSection(true);
+	table_->horizontalHeader()->setSortIndicator(FileModel::COL_NAME, Qt::AscendingOrder);
+	table_->setSortingEnabled(true);
+	table_->setShowGrid(false);
+	table_->setSelectionBehavior(QAbstractItemView::SelectRows);
+	table_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	connect(table_, SIGNAL(clicked(const QModelIndex &)), this, SLOT(cellClicked(const QModelIndex &)));
+	table_->setContextMenuPolicy(Qt::CustomContextMenu);
+	connect(table_, SIGNAL(customContextMenuRequested(const QPoint &)), this, SLOT(tableMenu(const QPoint &)));
+	QShortcut *copy = new QShortcut(QKeySequence::Copy, table_);
+	copy->setContext(Qt::WidgetWithChildrenShortcut);
+	connect(copy, SIGNAL(activated()), this, SLOT(copyOut()));
+	connect(table_->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(prefetch()));
+
+	// disk usage
+	du_ = new DiskUsage(&sb_, scan_pool_, this);
+	connect(du_, SIGNAL(finished()), this, SLOT(sizesDone()));
+	du_timer_ = new QTimer(this);
+	connect(du_timer_, SIGNAL(timeout()), this, SLOT(sizesUpdate()));
+	du_button_ = new QPushButton(tr("Sizes"), this);
+	du_button_->setToolTip(tr("Compute the size of the directories"));
+	connect(du_button_, SIGNAL(clicked()), this, SLOT(computeSizes()));
+
+	// file search, at the bottom and hidden until needed
+	search_ = new SearchPanel(&sb_, fs_, scan_pool_, this);
+	connect(search_, SIGNAL(openDirectory(QString)), this, SLOT(openDirectory(QString)));
+	search_->hide();
+	QShortcut *find = new QShortcut(QKeySequence::Find, this);
+	find->setContext(Qt::WidgetWithChildrenShortcut);
+	connect(find, SIGNAL(activated()), this, SLOT(toggleSearch()));
+	QPushButton *search_button = new QPushButton(tr("Search"), this);
+	search_button->setToolTip(tr("Search files (Ctrl+F)"));
+	connect(search_button, SIGNAL(clicked()), this, SLOT(toggleSearch()));
+
+	print_files("/");
+
+	QWidget *empty1 = new QWidget(this);
+	empty1->setMinimumWidth(30);
+	QWidget *empty2 = new QWidget(this);
+	empty2->setMinimumWidth(10);
+
+	QGridLayout *mainLayout = new QGridLayout;
+	mainLayout->addWidget(top_, 0, 0);
+	mainLayout->addWidget(empty1, 0, 1);
+	mainLayout->addWidget(line_, 0, 2);
+	mainLayout->addWidget(empty2, 0, 3);
+	mainLayout->addWidget(du_button_, 0, 4);
+	mainLayout->addWidget(search_button, 0, 5);
+	mainLayout->addWidget(table_, 1, 0, 1, 6);
+	mainLayout->setColumnStretch(0, 1);
+	mainLayout->setColumnStretch(1, 1);
+	mainLayout->setColumnStretch(2, 200);
+	mainLayout->setColumnStretch(3, 1);
+	mainLayout->setColumnStretch(4, 1);
+	mainLayout->setColumnStretch(5, 1);
+	mainLayout->addWidget(search_, 2, 0, 1, 6);
+	mainLayout->setRowStretch(1, 3);
+	mainLayout->setRowStretch(2, 1);
+	setLayout(mainLayout);
+}
+
+SandboxView::~SandboxView() {
+	// stop the scanners in progress before closing the sandbox
+	du_->cancel();
+	search_->stop();
+	QList<CopyDialog *> copies = findChildren<CopyDialog *>();
+	for (int i = 0; i < copies.size(); i++)
+		copies[i]->stop();
+	QList<DiffDialog *> diffs = findChildren<DiffDialog *>();
+	for (int i = 0; i < diffs.size(); i++)
+		diffs[i]->stop();
+	// the pools are shared with the other tabs, only the tasks of this view are cancelled
+	// and waited for
+	stopPrefetch();
+	model_->beginListing();
+	tasks_.stop();
+	cache_->removeSandbox(&sb_);
+	sandbox_close(&sb_);
+	delete fs_;
+}
+
+void SandboxView::print_files(const char *path, bool refresh) {
+	if (arg_debug)
+		printf("print_files path %s\n", path);
+
+	// sizes are computed for one directory at a time
+	du_->cancel();
+	stopPrefetch();
+
+	// fs flags
+	fs_->checkPath(QString(path));
+	search_->setDirectory(QString(path));
+
+	// cached listings watched by inotify are always up to date, the others are read again on refresh
+	listing_path_ = QString(path);
+	if (refresh && !cache_->watching(&sb_))
+		cache_->invalidate(&sb_, listing_path_);
+	QVector<FileEntry> entries;
+	if (cache_->lookup(&sb_, listing_path_, &entries)) {
+		model_->load(entries);
+		return;
+	}
+
+	// the table is cleared and filled in from the thread pool while the directory is read
+	int generation = model_->beginListing();
+	DirLister *lister = new DirLister(&sb_, listing_path_, model_, generation, cache_, &tasks_);
+	tasks_.start(QThreadPool::globalInstance(), lister);
+}
+
+void SandboxView::listingDone(int status) {
+	if (status == 0)
+		prefetch();
+	else if (status == -1) {
+		char *msg;
+		if (asprintf(&msg, "<br/><b>Directory %s not found.<br/><br/><br/>", listing_path_.toUtf8().constData()) == -1)
+			errExit("asprintf");
+		QMessageBox::warning(this, tr("Firejail File Manager"), tr(msg));
+		free(msg);
+	}
+}
+
+// queue the visible subdirectories not in the listing cache yet
+void SandboxView::prefetch() {
+	int rows = model_->rowCount();
+	if (rows == 0)
+		return;
+	int first = table_->rowAt(0);
+	int last = table_->rowAt(table_->viewport()->height() - 1);
+	if (first == -1)
+		first = 0;
+	if (last == -1)
+		last = rows - 1;
+
+	for (int row = first; row <= last && prefetch_queued_.size() < PREFETCH_DIRS; row++) {
+		if (!model_->isDir(row))
+			continue;
+		QString path = listing_path_ + model_->name(row) + "/";
+		if (prefetch_queued_.contains(path) || cache_->contains(&sb_, path))
+			continue;
+		prefetch_queued_.insert(path);
+		tasks_.start(prefetch_pool_, new PrefetchTask(&sb_, path, cache_, &tasks_, &prefetch_generation_));
+	}
+}
+
+// cancel the prefetch tasks of this view; the pool is shared with the other tabs, the queued
+// tasks are not removed, they see the new generation and return without reading anything
+void SandboxView::stopPrefetch() {
+	prefetch_generation_.ref();
+	prefetch_queued_.clear();
+}
+
+// start or stop the disk usage scan of the directories in the table
+void SandboxView::computeSizes() {
+	if (du_->running()) {
+		du_->cancel();
+		return;
+	}
+
+	du_names_ = model_->dirNames();
+	if (du_names_.isEmpty())
+		return;
+	du_->start(build_path(), du_names_, config_read_threads());
+	if (du_->running()) {
+		du_button_->setText(tr("Stop"));
+		du_timer_->start(DU_UPDATE);
+	}
+}
+
+// partial totals
+void SandboxView::sizesUpdate() {
+	model_->setDirSizes(du_names_, du_->totals(), true);
+}
+
+// the scan is complete or cancelled; cancelled totals stay marked as partial
+void SandboxView::sizesDone() {
+	du_timer_->stop();
+	du_button_->setText(tr("Sizes"));
+	if (!du_names_.isEmpty()) {
+		bool complete = du_->complete();
+		model_->setDirSizes(du_names_, du_->totals(), !complete);
+	}
+	du_names_.clear();
+}
+
+// show the search panel, or hide it and stop the search in progress
+void SandboxView::toggleSearch() {
+	if (search_->isVisible()) {
+		search_->stop();
+		search_->hide();
+	}
+	else
+		search_->show();
+}
+
+// open a directory selected in the search results
+void SandboxView::openDirectory(QString dir) {
+	path_ = dir.split('/', QString::SkipEmptyParts);
+	QString full_path = build_path();
+	print_files(full_path.toUtf8().constData());
+	QString txt = build_line();
+	line_->setText(txt);
+}
+
+void SandboxView::tableMenu(const QPoint &pos) {
+	QMenu menu(this);
+	QAction *copy = NULL;
+	if (table_->indexAt(pos).isValid())
+		copy = menu.addAction(tr("Copy to host..."));
+	QAction *compare = menu.addAction(tr("Compare with host..."));
+	QAction *action = menu.exec(table_->viewport()->mapToGlobal(pos));
+	if (action && action == copy)
+		copyOut();
+	else if (action == compare)
+		compareHost();
+}
+
+// list the differences between the current directory and the same directory on the host
+void SandboxView::compareHost() {
+	DiffDialog *dialog = new DiffDialog(&sb_, scan_pool_, build_path(), this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->show();
+	dialog->handleCompare();
+}
+
+// copy the selected files and directories to a host directory
+void SandboxView::copyOut() {
+	QModelIndexList rows = table_->selectionModel()->selectedRows(FileModel::COL_NAME);
+	if (rows.isEmpty())
+		return;
+	QStringList names;
+	for (int i = 0; i < rows.size(); i++)
+		names.append(model_->name(rows.at(i).row()));
+
+	QString dest = QFileDialog::getExistingDirectory(this, tr("Copy to host"), QDir::homePath());
+	if (dest.isEmpty())
+		return;
+
+	CopyDialog *dialog = new CopyDialog(&sb_, scan_pool_, this);
+	dialog->setAttribute(Qt::WA_DeleteOnClose);
+	dialog->show();
+	dialog->start(build_path(), names, dest);
+}
+
+void SandboxView::handleUp() {
+	if (path_.size() == 0)
+		return handleRefresh();
+
+	path_.takeLast();
+	QString full_path = build_path();
+	print_files(full_path.toUtf8().constData());
+	QString txt = build_line();
+	line_->setText(txt);
+}
+
+void SandboxView::handleRefresh() {
+	QString full_path = build_path();
+	print_files(full_path.toUtf8().constData(), true);
+	QString txt = build_line();
+	line_->setText(txt);
+}
+
+void SandboxView::handleHome() {
+	const char* username = getenv("USER");
+	path_.clear();
+	path_.append(QString("home"));
+	if (username)
+		path_.append(QString(username));
+	QString full_path = build_path();
+	print_files(full_path.toUtf8().constData());
+	QString txt = build_line();
+	line_->setText(txt);
+}
+
+void SandboxView::handleRoot() {
+	path_.clear();
+	print_files("/");
+	QString txt = build_line();
+	line_->setText(txt);
+}
+
+QString  SandboxView::build_path() {
+	QString retval = QString("/");
+
+	for (int i = 0; i < path_.size(); ++i) {
+		retval += path_.at(i);
+		retval += QString("/");
+	}
+
+	return retval;
+}
+
+QString  SandboxView::build_line() {
+	QString retval = "/";
+//	retval.sprintf("%d:///", pid_);
+
+	for (int i = 0; i < path_.size(); ++i) {
+		retval += path_.at(i);
+		retval += QString("/");
+	}
+
+	return retval;
+}
+
+void SandboxView::cellClicked(const QModelIndex &index) {
+	// Ctrl and Shift clicks extend the selection
+	if (QApplication::keyboardModifiers() & (Qt::ControlModifier | Qt::ShiftModifier))
+		return;
+	if (!model_->isDir(index.row()))
+		return;
+	path_.append(model_->name(index.row()));
+
+	QString full_path = build_path();
+	print_files(full_path.toUtf8().constData());
+	QString txt = build_line();
+	line_->setText(txt);
+}
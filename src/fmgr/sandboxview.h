@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SANDBOXVIEW_H
+#define SANDBOXVIEW_H
+#include <QWidget>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QList>
+#include <QSet>
+#include "sandbox.h"
+#include "workqueue.h"
+
+class QLineEdit;
+class QTableView;
+class QModelIndex;
+class QPoint;
+class TopWidget;
+class FS;
+class FileModel;
+class DiskUsage;
+class ListingCache;
+class QPushButton;
+class QTimer;
+class QThreadPool;
+class SearchPanel;
+
+// File manager for one sandbox, shown in a MainWindow tab. The listing thread pool,
+// the prefetch pool, the scan pool and the listing cache are shared by all the tabs.
+class SandboxView: public QWidget {
+Q_OBJECT
+
+public:
+	// the view takes ownership of sb, already opened and verified
+	SandboxView(const Sandbox &sb, ListingCache *cache, QThreadPool *prefetch_pool, QThreadPool *scan_pool,
+		QWidget *parent = 0);
+	~SandboxView();
+	pid_t pid() const {
+		return pid_;
+	}
+
+private slots:
+	void handleUp();
+	void handleHome();
+	void handleRoot();
+	void handleRefresh();
+	void cellClicked(const QModelIndex &index);
+	void listingDone(int status);
+	void computeSizes();
+	void sizesUpdate();
+	void sizesDone();
+	void prefetch();
+	void toggleSearch();
+	void openDirectory(QString dir);
+	void copyOut();
+	void compareHost();
+	void tableMenu(const QPoint &pos);
+
+private:
+	void print_files(const char *path, bool refresh = false);
+	void stopPrefetch();
+	QString build_path();
+	QString build_line();
+
+private:
+	pid_t pid_;
+	TopWidget *top_;
+	QLineEdit *line_;
+	QTableView *table_;
+	FileModel *model_;
+	ListingCache *cache_;
+	QStringList path_;
+	FS *fs_;
+	Sandbox sb_;
+
+	QString listing_path_;
+	// listing and prefetch tasks of this view in the shared pools
+	TaskGroup tasks_;
+
+	// disk usage
+	DiskUsage *du_;
+	QTimer *du_timer_;
+	QPushButton *du_button_;
+	QList<QByteArray> du_names_;
+
+	// prefetch
+	QThreadPool *prefetch_pool_;
+	QAtomicInt prefetch_generation_;
+	QSet<QString> prefetch_queued_;
+
+	// disk usage, search, copy and compare
+	QThreadPool *scan_pool_;
+
+	// search
+	SearchPanel *search_;
+};
+#endif
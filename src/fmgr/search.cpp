@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "search.h"
+#include "fs.h"
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <QMutexLocker>
+
+#define SEARCH_MAX_RESULTS 10000
+
+// directory listing context for one worker
+struct SearchContext {
+	FileSearch *search;
+	QByteArray dir;
+	QRegularExpression re;	// per thread copy
+};
+
+FileSearch::FileSearch(const Sandbox *sb, const FS *fs, QThreadPool *pool, QObject *parent): QObject(parent),
+	sb_(sb), fs_(fs), pool_(pool), cancel_(0), queue_(&cancel_), mode_(MODE_NAME), nresults_(0), truncated_(false) {
+	connect(&queue_, SIGNAL(finished()), this, SLOT(workerDone()));
+}
+
+FileSearch::~FileSearch() {
+	stop();
+}
+
+bool FileSearch::start(QString dir, QString pattern, int mode, int threads) {
+	stop();
+	if (pattern.isEmpty())
+		return false;
+
+	mode_ = mode;
+	if (mode == MODE_REGEX) {
+		re_ = QRegularExpression(pattern);
+		if (!re_.isValid())
+			return false;
+		re_.optimize();
+	}
+	else if (mode == MODE_GLOB)
+		pattern_ = pattern.toUtf8();
+	else
+		pattern_ = pattern.toLower().toUtf8();
+
+	cancel_ = 0;
+	results_.clear();
+	nresults_ = 0;
+	truncated_ = false;
+	QByteArray base = dir.toUtf8();
+	while (base.size() > 1 && base.endsWith('/'))
+		base.chop(1);
+	queue_.push(base);
+	queue_.start(pool_, threads, work_cb, this);
+	return true;
+}
+
+void FileSearch::cancel() {
+	if (!queue_.active())
+		return;
+	stop();
+	emit finished();
+}
+
+void FileSearch::stop() {
+	cancel_ = 1;
+	queue_.stop();
+	queue_.clear();
+}
+
+// the last task returned; stale notifications of a cancelled search are ignored
+void FileSearch::workerDone() {
+	if (!queue_.active() || queue_.busy())
+		return;
+	stop();
+	emit finished();
+}
+
+QList<SearchResult> FileSearch::take() {
+	QMutexLocker locker(&results_mutex_);
+	QList<SearchResult> rv;
+	rv.swap(results_);
+	return rv;
+}
+
+bool FileSearch::match(const char *name, const QRegularExpression &re) const {
+	if (mode_ == MODE_REGEX)
+		return re.match(QString::fromUtf8(name)).hasMatch();
+	else if (mode_ == MODE_GLOB)
+		return fnmatch(pattern_.constData(), name, FNM_PERIOD) == 0;
+	return QString::fromUtf8(name).toLower().contains(QString::fromUtf8(pattern_));
+}
+
+void FileSearch::addResult(const QByteArray &path, bool dir, bool blacklisted) {
+	SearchResult result;
+	result.path = QString::fromUtf8(path);
+	result.dir = dir;
+	result.blacklisted = blacklisted;
+
+	QMutexLocker locker(&results_mutex_);
+	if (nresults_ >= SEARCH_MAX_RESULTS)
+		return;
+	results_.append(result);
+	if (++nresults_ >= SEARCH_MAX_RESULTS) {
+		truncated_ = true;
+		cancel_ = 1;
+		queue_.wakeAll();
+	}
+}
+
+int FileSearch::entry_cb(const SandboxEntry *entry, void *arg) {
+	SearchContext *ctx = (SearchContext *) arg;
+	FileSearch *search = ctx->search;
+	if (search->cancel_)
+		return 1;
+
+	QByteArray path = ctx->dir;
+	if (!path.endsWith('/'))
+		path += '/';
+	path += entry->name;
+
+	bool dir = S_ISDIR(entry->mode);
+	bool blacklisted = false;
+	if (dir) {
+		// blacklisted directories are not entered, there is nothing to see inside
+		blacklisted = (search->fs_->lookup(QString::fromUtf8(path)) & FS_BLACKLIST) != 0;
+		if (!blacklisted && !sandbox_virtual_dir(path.constData()))
+			search->queue_.push(path);
+	}
+
+	if (search->match(entry->name, ctx->re))
+		search->addResult(path, dir, blacklisted);
+	return 0;
+}
+
+void FileSearch::work_cb(void *arg) {
+	((FileSearch *) arg)->work();
+}
+
+void FileSearch::work() {
+	SearchContext ctx;
+	ctx.search = this;
+	ctx.re = re_;
+
+	QByteArray dir;
+	while (queue_.pop(&dir)) {
+		ctx.dir = dir;
+		sandbox_list(sb_, dir.constData(), entry_cb, &ctx, &cancel_);
+		queue_.done();
+	}
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SEARCH_H
+#define SEARCH_H
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QRegularExpression>
+#include <QString>
+#include "sandbox.h"
+#include "workqueue.h"
+
+class FS;
+class QThreadPool;
+
+struct SearchResult {
+	QString path;
+	bool dir;
+	bool blacklisted;	// blacklisted directory, not searched
+};
+
+// Parallel file name search in the sandbox filesystem. The directories are read by a
+// few tasks in the scan thread pool, sharing one queue; blacklisted directories are not entered, they are reported
+// when they match the pattern.
+// The results are collected until the GUI takes them.
+class FileSearch: public QObject {
+Q_OBJECT
+
+public:
+	enum {
+		MODE_NAME = 0,	// case insensitive substring
+		MODE_GLOB,	// shell wildcards
+		MODE_REGEX	// Perl compatible regular expression
+	};
+
+	FileSearch(const Sandbox *sb, const FS *fs, QThreadPool *pool, QObject *parent = 0);
+	~FileSearch();
+
+	// start searching dir recursively; returns false if the pattern is not valid
+	bool start(QString dir, QString pattern, int mode, int threads);
+	void cancel();
+	bool running() const {
+		return queue_.active();
+	}
+
+	// results found since the last call
+	QList<SearchResult> take();
+	// the search stopped at the maximum number of results
+	bool truncated() const {
+		return truncated_;
+	}
+
+signals:
+	void finished();
+
+private slots:
+	void workerDone();
+
+private:
+	void stop();
+	void work();
+	bool match(const char *name, const QRegularExpression &re) const;
+	void addResult(const QByteArray &path, bool dir, bool blacklisted);
+	static void work_cb(void *arg);
+	static int entry_cb(const SandboxEntry *entry, void *arg);
+
+	const Sandbox *sb_;
+	const FS *fs_;
+	QThreadPool *pool_;
+	volatile int cancel_;
+	WorkQueue<QByteArray> queue_;	// directories
+
+	int mode_;
+	QByteArray pattern_;		// name and glob modes
+	QRegularExpression re_;
+
+	QMutex results_mutex_;
+	QList<SearchResult> results_;
+	int nresults_;
+	volatile bool truncated_;
+};
+
+#endif
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "searchpanel.h"
+#include "search.h"
+
+#include <QtGlobal>
+#if QT_VERSION >= 0x050000
+	#include <QtWidgets>
+#else
+	#include <QtGui>
+#endif
+
+#define SEARCH_UPDATE 200	// result list update, ms
+
+SearchPanel::SearchPanel(const Sandbox *sb, const FS *fs, QThreadPool *pool, QWidget *parent): QWidget(parent),
+	dir_("/") {
+	search_ = new FileSearch(sb, fs, pool, this);
+	connect(search_, SIGNAL(finished()), this, SLOT(searchDone()));
+	timer_ = new QTimer(this);
+	connect(timer_, SIGNAL(timeout()), this, SLOT(showResults()));
+
+	pattern_ = new QLineEdit(this);
+	pattern_->setPlaceholderText(tr("File name"));
+	connect(pattern_, SIGNAL(returnPressed()), this, SLOT(handleSearch()));
+
+	mode_ = new QComboBox(this);
+	mode_->addItem(tr("Name"), FileSearch::MODE_NAME);
+	mode_->addItem(tr("Wildcard"), FileSearch::MODE_GLOB);
+	mode_->addItem(tr("Regex"), FileSearch::MODE_REGEX);
+
+	button_ = new QPushButton(tr("Search"), this);
+	connect(button_, SIGNAL(clicked()), this, SLOT(handleSearch()));
+
+	results_ = new QListWidget(this);
+	results_->setUniformItemSizes(true);
+	connect(results_, SIGNAL(itemActivated(QListWidgetItem *)), this, SLOT(itemActivated(QListWidgetItem *)));
+
+	status_ = new QLabel(this);
+
+	QGridLayout *layout = new QGridLayout;
+	layout->addWidget(pattern_, 0, 0);
+	layout->addWidget(mode_, 0, 1);
+	layout->addWidget(button_, 0, 2);
+	layout->addWidget(results_, 1, 0, 1, 3);
+	layout->addWidget(status_, 2, 0, 1, 3);
+	layout->setColumnStretch(0, 10);
+	setLayout(layout);
+}
+
+SearchPanel::~SearchPanel() {
+	stop();
+}
+
+void SearchPanel::setDirectory(QString dir) {
+	dir_ = dir;
+}
+
+// the search threads read the sandbox filesystem, stop them before closing the sandbox
+void SearchPanel::stop() {
+	search_->cancel();
+}
+
+// start a new search, or stop the one running
+void SearchPanel::handleSearch() {
+	if (search_->running()) {
+		search_->cancel();
+		return;
+	}
+
+	results_->clear();
+	int mode = mode_->itemData(mode_->currentIndex()).toInt();
+	if (!search_->start(dir_, pattern_->text(), mode, config_read_threads())) {
+		status_->setText(pattern_->text().isEmpty() ? QString() : tr("Invalid pattern"));
+		return;
+	}
+	status_->setText(tr("Searching %1").arg(dir_));
+	button_->setText(tr("Stop"));
+	timer_->start(SEARCH_UPDATE);
+}
+
+// move the results found so far in the list
+void SearchPanel::showResults() {
+	QList<SearchResult> found = search_->take();
+	for (int i = 0; i < found.size(); i++) {
+		const SearchResult &result = found.at(i);
+		QString text = result.path;
+		if (result.dir)
+			text += "/";
+		QListWidgetItem *item = new QListWidgetItem(text, results_);
+		item->setData(Qt::UserRole, result.dir);
+		item->setData(Qt::UserRole + 1, result.path);
+		if (result.blacklisted) {
+			item->setText(text + " " + tr("(blacklisted, not searched)"));
+			item->setForeground(Qt::gray);
+		}
+	}
+}
+
+void SearchPanel::searchDone() {
+	timer_->stop();
+	showResults();
+	button_->setText(tr("Search"));
+	if (search_->truncated())
+		status_->setText(tr("%n file(s) found, the search stopped at the limit", "", results_->count()));
+	else
+		status_->setText(tr("%n file(s) found", "", results_->count()));
+}
+
+// directories are opened, for files the parent directory is opened
+void SearchPanel::itemActivated(QListWidgetItem *item) {
+	QString path = item->data(Qt::UserRole + 1).toString();
+	bool dir = item->data(Qt::UserRole).toBool();
+	if (!dir) {
+		int index = path.lastIndexOf('/');
+		path = (index <= 0) ? QString("/") : path.left(index);
+	}
+	emit openDirectory(path);
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef SEARCHPANEL_H
+#define SEARCHPANEL_H
+#include <QWidget>
+#include <QString>
+#include "sandbox.h"
+
+class QLineEdit;
+class QComboBox;
+class QPushButton;
+class QListWidget;
+class QListWidgetItem;
+class QLabel;
+class QTimer;
+class QThreadPool;
+class FS;
+class FileSearch;
+
+// Search panel: the files matching a name, a wildcard or a regular expression are looked up
+// below the current directory and listed while the search is running.
+class SearchPanel: public QWidget {
+Q_OBJECT
+
+public:
+	SearchPanel(const Sandbox *sb, const FS *fs, QThreadPool *pool, QWidget *parent = 0);
+	~SearchPanel();
+	void setDirectory(QString dir);
+	void stop();
+
+signals:
+	// the directory containing the activated result
+	void openDirectory(QString dir);
+
+private slots:
+	void handleSearch();
+	void showResults();
+	void searchDone();
+	void itemActivated(QListWidgetItem *item);
+
+private:
+	QString dir_;
+	FileSearch *search_;
+	QLineEdit *pattern_;
+	QComboBox *mode_;
+	QPushButton *button_;
+	QListWidget *results_;
+	QLabel *status_;
+	QTimer *timer_;
+};
+
+#endif
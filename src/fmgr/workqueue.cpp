@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#include "fmgr.h"
+#include "workqueue.h"
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define SCAN_NICE 5		// the scans run behind the GUI and the directory listings
+
+class WorkTask: public QRunnable {
+public:
+	WorkTask(WorkQueueBase *queue, WorkQueueBase::WorkCb cb, void *arg): queue_(queue), cb_(cb), arg_(arg) {
+		// owned by the queue, it is deleted only after all the tasks returned
+		setAutoDelete(false);
+	}
+	void run() {
+		// the threads of the scan pool are not used for anything else
+		setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), SCAN_NICE);
+		cb_(arg_);
+		queue_->taskDone();
+	}
+
+private:
+	WorkQueueBase *queue_;
+	WorkQueueBase::WorkCb cb_;
+	void *arg_;
+};
+
+WorkQueueBase::WorkQueueBase(volatile int *cancel): cancel_(cancel), pending_(0), running_(0), pool_(NULL) {}
+
+WorkQueueBase::~WorkQueueBase() {
+	stop();
+}
+
+void WorkQueueBase::start(QThreadPool *pool, int threads, WorkCb cb, void *arg) {
+	assert(pool);
+	stop();
+	int max = pool->maxThreadCount();
+	if (threads <= 0)
+		threads = max / 2;
+	if (threads > max)
+		threads = max;
+	if (threads <= 0)
+		threads = 1;
+
+	pool_ = pool;
+	running_ = threads;
+	for (int i = 0; i < threads; i++)
+		tasks_.append(new WorkTask(this, cb, arg));
+	for (int i = 0; i < tasks_.size(); i++)
+		pool_->start(tasks_[i]);
+}
+
+void WorkQueueBase::stop() {
+	if (tasks_.isEmpty())
+		return;
+
+	// the tasks still waiting for a thread are not run at all
+	for (int i = 0; i < tasks_.size(); i++) {
+		if (pool_->tryTake(tasks_[i])) {
+			QMutexLocker locker(&mutex_);
+			running_--;
+		}
+	}
+
+	QMutexLocker locker(&mutex_);
+	work_.wakeAll();
+	while (running_ > 0)
+		idle_.wait(&mutex_);
+	locker.unlock();
+
+	for (int i = 0; i < tasks_.size(); i++)
+		delete tasks_[i];
+	tasks_.clear();
+	pool_ = NULL;
+}
+
+// called with the mutex locked
+bool WorkQueueBase::wait() {
+	if (*cancel_ || pending_ == 0) {
+		// the other tasks return too
+		work_.wakeAll();
+		return false;
+	}
+	work_.wait(&mutex_);
+	return true;
+}
+
+void WorkQueueBase::done() {
+	QMutexLocker locker(&mutex_);
+	if (--pending_ == 0 || *cancel_)
+		work_.wakeAll();
+}
+
+void WorkQueueBase::wakeAll() {
+	QMutexLocker locker(&mutex_);
+	work_.wakeAll();
+}
+
+TaskGroup::TaskGroup(): cancel_(0), count_(0) {}
+
+TaskGroup::~TaskGroup() {
+	stop();
+}
+
+void TaskGroup::start(QThreadPool *pool, QRunnable *task) {
+	QMutexLocker locker(&mutex_);
+	Queued q;
+	q.pool = pool;
+	q.task = task;
+	queued_.append(q);
+	count_++;
+	pool->start(task);
+}
+
+void TaskGroup::started(QRunnable *task) {
+	QMutexLocker locker(&mutex_);
+	for (int i = 0; i < queued_.size(); i++) {
+		if (queued_[i].task == task) {
+			queued_.removeAt(i);
+			break;
+		}
+	}
+}
+
+void TaskGroup::finished() {
+	QMutexLocker locker(&mutex_);
+	if (--count_ == 0)
+		idle_.wakeAll();
+}
+
+void TaskGroup::stop() {
+	cancel_ = 1;
+	QMutexLocker locker(&mutex_);
+	// a task still in the list did not start, it is not deleted by the pool once taken out
+	for (int i = 0; i < queued_.size(); i++) {
+		if (queued_[i].pool->tryTake(queued_[i].task)) {
+			delete queued_[i].task;
+			count_--;
+		}
+	}
+	queued_.clear();
+	while (count_ > 0)
+		idle_.wait(&mutex_);
+}
+
+void WorkQueueBase::taskDone() {
+	QMutexLocker locker(&mutex_);
+	if (--running_ == 0) {
+		idle_.wakeAll();
+		// queued to the thread of the queue; emitted under the mutex, stop() cannot
+		// return and the queue cannot be deleted before the event is posted
+		emit finished();
+	}
+}
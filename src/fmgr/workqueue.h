@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015-2018 Firetools Authors
+ *
+ * This file is part of firetools project
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QObject>
+#include <QWaitCondition>
+
+class QRunnable;
+class QThreadPool;
+class WorkTask;
+
+// The tasks one view starts in the shared listing and prefetch pools. The view waits only
+// for its own tasks: stop() sets the cancel flag passed to the tasks, takes the tasks not
+// started yet out of the pools and waits for the running ones.
+class TaskGroup {
+public:
+	TaskGroup();
+	~TaskGroup();
+
+	volatile int *cancel() {
+		return &cancel_;
+	}
+	void start(QThreadPool *pool, QRunnable *task);
+	// called by the task when it starts and when it is done
+	void started(QRunnable *task);
+	void finished();
+	void stop();
+
+private:
+	struct Queued {
+		QThreadPool *pool;
+		QRunnable *task;
+	};
+
+	volatile int cancel_;
+	QMutex mutex_;
+	QWaitCondition idle_;
+	int count_;			// tasks started and not finished
+	QList<Queued> queued_;		// tasks waiting for a thread
+};
+
+// Job queue of one scanner (disk usage, search, copy, diff), worked on by a few tasks in the
+// scan thread pool shared by all the tabs. The tasks block on a wait condition while the
+// queue is empty and other jobs are still running, they return when all the jobs are done
+// or when the scanner's cancel flag is set. finished() is emitted, in the scanner's thread,
+// when the last task returns.
+class WorkQueueBase: public QObject {
+Q_OBJECT
+
+public:
+	typedef void (*WorkCb)(void *arg);
+
+	WorkQueueBase(volatile int *cancel);
+	~WorkQueueBase();
+
+	// run cb(arg) in up to threads tasks; threads <= 0 selects half of the pool, the
+	// scans of the other tabs get the rest
+	void start(QThreadPool *pool, int threads, WorkCb cb, void *arg);
+	// wake up the tasks and wait for them; the tasks not started yet are taken out of the pool
+	void stop();
+	// tasks started and not stopped yet
+	bool active() const {
+		return !tasks_.isEmpty();
+	}
+	// some tasks did not return yet
+	bool busy() {
+		QMutexLocker locker(&mutex_);
+		return running_ > 0;
+	}
+	// a job taken with pop() is done
+	void done();
+	// wake up the waiting tasks after the cancel flag was set from a task
+	void wakeAll();
+
+signals:
+	void finished();
+
+protected:
+	friend class WorkTask;
+	void taskDone();
+	// wait for a job; returns false if there is nothing more to do
+	bool wait();
+
+	volatile int *cancel_;
+	QMutex mutex_;
+	QWaitCondition work_;		// a job was queued, or the work is over
+	QWaitCondition idle_;		// a task returned
+	int pending_;			// jobs queued or running
+	int running_;			// tasks not returned yet
+
+private:
+	QThreadPool *pool_;
+	QList<WorkTask *> tasks_;
+};
+
+template <class Job>
+class WorkQueue: public WorkQueueBase {
+public:
+	WorkQueue(volatile int *cancel): WorkQueueBase(cancel) {}
+
+	void push(const Job &job, bool front = false) {
+		QMutexLocker locker(&mutex_);
+		if (front)
+			jobs_.prepend(job);
+		else
+			jobs_.append(job);
+		pending_++;
+		work_.wakeOne();
+	}
+
+	// take a job from the back, or from the front; blocks while the queue is empty and
+	// other jobs are running; returns false when the tasks should return
+	bool pop(Job *job, bool front = false) {
+		QMutexLocker locker(&mutex_);
+		while (jobs_.isEmpty()) {
+			if (!wait())
+				return false;
+		}
+		if (*cancel_) {
+			work_.wakeAll();
+			return false;
+		}
+		*job = (front)? jobs_.takeFirst(): jobs_.takeLast();
+		return true;
+	}
+
+	// drop the jobs left by a cancelled run
+	void clear() {
+		QMutexLocker locker(&mutex_);
+		jobs_.clear();
+		pending_ = 0;
+	}
+
+private:
+	QList<Job> jobs_;
+};
+
+#endif
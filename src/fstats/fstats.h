@@ -29,6 +29,7 @@ typedef enum {
 	
 
 extern int arg_debug;
+extern int arg_pid;
 extern int svg_not_found;
 
 // config.cpp
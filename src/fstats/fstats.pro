@@ -2,7 +2,7 @@ QMAKE_CXXFLAGS += $$(CXXFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -
 QMAKE_CFLAGS += $$(CFLAGS) -fstack-protector-all -D_FORTIFY_SOURCE=2 -fPIE -pie -Wformat -Wformat-security
 QMAKE_LFLAGS += $$(LDFLAGS) -Wl,-z,relro -Wl,-z,now
 QT += widgets
- HEADERS       = ../common/utils.h ../common/pid.h ../common/common.h \
+ HEADERS       = ../common/utils.h ../common/pathdb.h ../common/pid.h ../common/netinfo.h ../common/common.h \
  		  pid_thread.h db.h dbstorage.h dbpid.h stats_dialog.h graph.h fstats.h
  SOURCES       = main.cpp \
                  stats_dialog.cpp \
@@ -11,7 +11,9 @@ QT += widgets
                 dbpid.cpp \
                  graph.cpp \
                   ../common/utils.cpp \
+                  ../common/pathdb.cpp \
                   ../common/pid.cpp \
+                  ../common/netinfo.cpp \
                   config.cpp
 RESOURCES = fstats.qrc
 TARGET=../../build/fstats
@@ -27,6 +27,7 @@
 #include "stats_dialog.h"
 
 int arg_debug = 0;
+int arg_pid = 0;
 int svg_not_found = 0;
 
 
@@ -36,6 +37,7 @@ static void usage() {
 	printf("Options:\n");
 	printf("\t--debug - debug mode\n\n");
 	printf("\t--help - this help screen\n\n");
+	printf("\t--pid=PID - open the sandbox with the specified PID as soon as it is detected\n\n");
 	printf("\t--version - print software version and exit\n\n");
 }
 
@@ -48,6 +50,13 @@ int main(int argc, char *argv[]) {
 			usage();
 			return 0;
 		}
+		else if (strncmp(argv[i], "--pid=", 6) == 0) {
+			arg_pid = atoi(argv[i] + 6);
+			if (arg_pid <= 0) {
+				fprintf(stderr, "Error: invalid PID %s\n", argv[i] + 6);
+				return 1;
+			}
+		}
 		else if (strcmp(argv[i], "--version") == 0) {
 			printf("fstats version " PACKAGE_VERSION "\n");
 			return 0;
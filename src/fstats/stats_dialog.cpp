@@ -33,12 +33,16 @@
 #include "graph.h"
 #include "../common/utils.h"
 #include "../common/pid.h"
+#include "../common/netinfo.h"
 #include "../../firetools_config.h"
 #include "../../firetools_config_extras.h"
 #include "pid_thread.h"
 #include "fstats.h"
 extern bool data_ready;
 
+#define START_PID_CYCLES 10	// data cycles to wait for the sandbox in --pid option
+#define NETINFO_AGE 2000	// ms, host network snapshot shared by the interface lists
+
 static QString getName(pid_t pid);
 static QString getProfile(pid_t pid);
 static bool userNamespace(pid_t pid);
@@ -57,7 +61,8 @@ static int find_child(int id) {
 	return -1;
 }
 
-StatsDialog::StatsDialog(): QDialog(), mode_(MODE_TOP), pid_(0), uid_(0), lts_(false),
+StatsDialog::StatsDialog(): QDialog(), mode_(MODE_TOP), pid_(0), start_pid_(arg_pid), start_cycles_(0),
+	uid_(0), lts_(false),
 	pid_initialized_(false), pid_seccomp_(false), pid_caps_(QString("")), pid_noroot_(false),
 	pid_cpu_cores_(QString("")), pid_protocol_(QString("")), pid_name_(QString("")),
 	profile_(QString("")), pid_x11_(0),
@@ -434,9 +439,23 @@ static QString get_dns(int pid) {
 	return rv;
 }
 
+// description of the host device behind a sandbox interface
+static QString parent_type(const NetInfo *ni, const char *dev) {
+	const NetIf *nif = netinfo_find(ni, dev);
+	if (!nif)
+		return QString();
+	if (nif->bridge)
+		return QString("bridge");
+	if (nif->wireless)
+		return QString("wireless");
+	return QString();
+}
+
 // build the network interface list for firejail versions 0.9.56 or older, including 0.9.56-LTS
 static QString get_interfaces_old(int pid) {
 	QString rv;
+	NetInfo ni;
+	netinfo_get(&ni, NETINFO_AGE);
 
 	char *fname;
 	if (asprintf(&fname, "/run/firejail/network/%d-netmap", pid) == -1)
@@ -463,23 +482,17 @@ static QString get_interfaces_old(int pid) {
 
 			QString str;
 			str.sprintf("%s (parent device %s", child_dev, parent_dev);
-
-			// detect bridge device
-			char *sysfile;
-			if (asprintf(&sysfile, "/sys/class/net/%s/bridge", parent_dev) == -1)
-				errExit("asprintf");
-			struct stat s;
-			if (stat(sysfile, &s) == 0)
-				str += ", bridge)";
-			else
-				str += ")";
-			free(sysfile);
+			QString type = parent_type(&ni, parent_dev);
+			if (!type.isEmpty())
+				str += ", " + type;
+			str += ")";
 
 			rv += str + "<br/>";
 		}
 		fclose(fp);
 	}
 	free(fname);
+	netinfo_free(&ni);
 
 	return rv;
 }
@@ -488,6 +501,8 @@ static QString get_interfaces_old(int pid) {
 // returns an empty string if --net.print is not available in the currently installed firejail version
 static QString get_interfaces_new(int pid) {
 	QString rv;
+	NetInfo ni;
+	netinfo_get(&ni, NETINFO_AGE);
 	char *str = 0;
 	char *cmd;
 	if (asprintf(&cmd, "firejail --net.print=%d 2>&1", pid) != -1) {
@@ -551,13 +566,25 @@ static QString get_interfaces_new(int pid) {
 				goto errexit;
 			int bits = mask2bits(mask_uint32);
 			rv += QString(ifname) + "&nbsp;&nbsp;&nbsp;" + QString(ip) + "/" +
-				QString::number(bits) + "<br/>";
+				QString::number(bits);
+
+			// interfaces named after the host device, example eth0-12202
+			char *dash = strrchr(ifname, '-');
+			if (dash && dash != ifname && dash[1] != '\0' && strspn(dash + 1, "0123456789") == strlen(dash + 1)) {
+				*dash = '\0';
+				QString type = parent_type(&ni, ifname);
+				if (!type.isEmpty())
+					rv += " (" + type + ")";
+			}
+			rv += "<br/>";
 		}
 	}
 
+	netinfo_free(&ni);
 	return rv;
 
 errexit:
+	netinfo_free(&ni);
 	return QString(); // empty string
 }
 
@@ -895,6 +922,21 @@ void StatsDialog::updatePid() {
 }
 
 void StatsDialog::cycleReady() {
+	// a sandbox just started could take a few cycles to show up in the database
+	if (start_pid_) {
+		if (Db::instance().findPid(start_pid_)) {
+			pid_ = start_pid_;
+			pid_initialized_ = false;
+			mode_ = MODE_PID;
+			start_pid_ = 0;
+		}
+		else if (++start_cycles_ >= START_PID_CYCLES) {
+			if (arg_debug)
+				printf("sandbox %d not found\n", start_pid_);
+			start_pid_ = 0;
+		}
+	}
+
 	if (mode_ == MODE_TOP)
 		updateTop();
 	else if (mode_ == MODE_PID)
@@ -913,6 +955,7 @@ void StatsDialog::cycleReady() {
 
 void StatsDialog::anchorClicked(const QUrl & link) {
 	cleanStorage(); // full storage cleanup on any click
+	start_pid_ = 0;
 	QString linkstr = link.toString();
 
 	if (linkstr == "top") {
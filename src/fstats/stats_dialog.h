@@ -72,6 +72,8 @@ private:
 #define MODE_FIREWALL 6
 	int mode_;
 	int pid_;	// pid value for mode 1
+	int start_pid_;	// --pid command line option, waiting for the sandbox to show up
+	int start_cycles_;
 	uid_t uid_;
 	bool lts_;	// flag to detect LTS version of firejail
 